@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo filter, approximate membership
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) support add, del, contains API
+ * (4) the alternate bucket is derived from the fingerprint (partial-key cuckoo)
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "dc_cuckoo_filter.h"
+#include "dc_hash_priv.h"
+
+#define CF_FOLLOW_DEPTH_DEFAULT	1	/* a bucket has 32 or 64 candidates per level */
+#define CF_SLOTS_MAX		DCHT_CACHELINE_SIZE
+
+/*
+ * handler for each CPU Arch
+ */
+struct cf_handler_s {
+        uint32_t (*hash32)(uint32_t,uint32_t);			/* 32 bit hash generator */
+        uint64_t (*match16_bk)(const struct dcht_cf_bucket_s *,
+                               uint32_t);			/* 16 bit fingerprint match bitmap */
+        uint64_t (*match8_bk)(const struct dcht_cf_bucket_s *,
+                              uint32_t);			/* 8 bit fingerprint match bitmap */
+};
+
+/*****************************************************************************
+ * start Generic Arch code--->
+ *****************************************************************************/
+always_inline uint64_t
+cf_match16_in_bucket_GEN (const struct dcht_cf_bucket_s * bk,
+                          uint32_t fp)
+{
+        uint64_t mask = 0;
+
+        for (int pos = 0; pos < (int) ARRAYOF(bk->fp16); pos++) {
+                if (atomic_load_explicit(&bk->fp16[pos], memory_order_acquire) == fp)
+                        mask |= UINT64_C(1) << pos;
+        }
+
+        TRACER("fp:%04x mask:%08"PRIx64"\n", fp, mask);
+        return mask;
+}
+
+always_inline uint64_t
+cf_match8_in_bucket_GEN (const struct dcht_cf_bucket_s * bk,
+                         uint32_t fp)
+{
+        uint64_t mask = 0;
+
+        for (int pos = 0; pos < (int) ARRAYOF(bk->fp8); pos++) {
+                if (atomic_load_explicit(&bk->fp8[pos], memory_order_acquire) == fp)
+                        mask |= UINT64_C(1) << pos;
+        }
+
+        TRACER("fp:%02x mask:%016"PRIx64"\n", fp, mask);
+        return mask;
+}
+
+static const struct cf_handler_s cf_generic_handlers = {
+        .hash32 = fnv1a,
+        .match16_bk = cf_match16_in_bucket_GEN,
+        .match8_bk = cf_match8_in_bucket_GEN,
+};
+
+/*****************************************************************************
+ * <---end Generic Arch code
+ *****************************************************************************/
+
+static const struct cf_handler_s * cf_handler = &cf_generic_handlers;
+
+#define BSWAP(_v)			__builtin_bswap32((_v))
+#define HASH(_i,_v)			cf_handler->hash32((_i),(_v))
+#define MATCH16_IN_BUCKET(_bk,_fp)	cf_handler->match16_bk((_bk),(_fp))
+#define MATCH8_IN_BUCKET(_bk,_fp)	cf_handler->match8_bk((_bk),(_fp))
+
+#if defined(__x86_64__)
+/*****************************************************************************
+ * x86_64 depened code start--->
+ *****************************************************************************/
+#include <immintrin.h>
+
+/******************************************************************************
+ * AVX2 code
+ * the rest of the library is built for the baseline ISA
+ ******************************************************************************/
+#pragma GCC push_options
+#pragma GCC target("avx2,sse4.2")
+
+/*
+ * 32 x 16 bit compares, packed to a byte per fingerprint
+ */
+always_inline uint64_t
+cf_match16_in_bucket_AVX2 (const struct dcht_cf_bucket_s * bk,
+                           uint32_t fp)
+{
+        __m256i search_fp = _mm256_set1_epi16(fp);
+        __m256i lo = _mm256_load_si256((__m256i *) (volatile void *) &bk->fp16[0]);
+        __m256i hi = _mm256_load_si256((__m256i *) (volatile void *) &bk->fp16[16]);
+        __m256i cmp;
+
+        /* packs works per 128 bit lane, restore the order of the quad words */
+        cmp = _mm256_packs_epi16(_mm256_cmpeq_epi16(search_fp, lo),
+                                 _mm256_cmpeq_epi16(search_fp, hi));
+        cmp = _mm256_permute4x64_epi64(cmp, 0xd8);
+
+        uint64_t mask = (uint32_t) _mm256_movemask_epi8(cmp);
+
+        TRACER("fp:%04x mask:%08"PRIx64"\n", fp, mask);
+        return mask;
+}
+
+/*
+ * 64 x 8 bit compares
+ */
+always_inline uint64_t
+cf_match8_in_bucket_AVX2 (const struct dcht_cf_bucket_s * bk,
+                          uint32_t fp)
+{
+        __m256i search_fp = _mm256_set1_epi8(fp);
+        __m256i lo = _mm256_load_si256((__m256i *) (volatile void *) &bk->fp8[0]);
+        __m256i hi = _mm256_load_si256((__m256i *) (volatile void *) &bk->fp8[32]);
+        uint64_t mask;
+
+        mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(search_fp, lo));
+        mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(search_fp, hi)) << 32;
+
+        TRACER("fp:%02x mask:%016"PRIx64"\n", fp, mask);
+        return mask;
+}
+
+/**
+ * @brief crc32c calc
+ *
+ * @param initial value
+ * @param target value
+ * @return crc32c
+ */
+always_inline uint32_t
+cf_crc32c32 (uint32_t init,
+             uint32_t val)
+{
+        return _mm_crc32_u32(init, val);
+}
+
+static const struct cf_handler_s cf_avx2_handlers = {
+        .hash32     = cf_crc32c32,
+        .match16_bk = cf_match16_in_bucket_AVX2,
+        .match8_bk  = cf_match8_in_bucket_AVX2,
+};
+
+#pragma GCC pop_options
+
+/*
+ * AVX2 and SSE4_2(crc32c), with the YMM state saved by the OS
+ */
+static const struct cf_handler_s *
+cf_x86_handler_get (void)
+{
+        const struct cf_handler_s * handler = cf_handler;
+
+#ifndef	DISABLE_AVX2_DRIVER
+        if (x86_isa_probe() == X86_ISA_AVX2) {
+                TRACER("use X86_64 AVX2 cuckoo filter driver\n");
+                handler = &cf_avx2_handlers;
+        } else {
+                TRACER("use generic cuckoo filter driver\n");
+        }
+#else	/* !DISABLE_AVX2_DRIVER */
+        (void) &cf_avx2_handlers;
+#endif	/* DISABLE_AVX2_DRIVER */
+        return handler;
+}
+
+/*****************************************************************************
+ * <---end x86 depened code
+ *****************************************************************************/
+#endif	/* __x86_64__ */
+
+/*
+ * select the driver of this process once, ahead of the constructors that may use it
+ */
+static void __attribute__((constructor(101)))
+cf_handler_init (void)
+{
+#if defined(__x86_64__)
+        cf_handler = cf_x86_handler_get();
+#endif	/* __x86_64__ */
+}
+
+/******************************************************************
+ * Filter Reader|writer
+ ******************************************************************/
+always_inline uint32_t
+cf_load_fp (const struct dcht_cuckoo_filter_s * cf,
+            const struct dcht_cf_bucket_s * bk,
+            int pos)
+{
+        if (cf->fp_bits == 16)
+                return atomic_load_explicit(&bk->fp16[pos], memory_order_acquire);
+        return atomic_load_explicit(&bk->fp8[pos], memory_order_acquire);
+}
+
+always_inline void
+cf_store_fp (const struct dcht_cuckoo_filter_s * cf,
+             struct dcht_cf_bucket_s * bk,
+             int pos,
+             uint32_t fp)
+{
+        if (cf->fp_bits == 16)
+                atomic_store_explicit(&bk->fp16[pos], fp, memory_order_release);
+        else
+                atomic_store_explicit(&bk->fp8[pos], fp, memory_order_release);
+}
+
+always_inline uint64_t
+cf_match (const struct dcht_cuckoo_filter_s * cf,
+          const struct dcht_cf_bucket_s * bk,
+          uint32_t fp)
+{
+        if (cf->fp_bits == 16)
+                return MATCH16_IN_BUCKET(bk, fp);
+        return MATCH8_IN_BUCKET(bk, fp);
+}
+
+always_inline int
+cf_find_vacancy (const struct dcht_cuckoo_filter_s * cf,
+                 const struct dcht_cf_bucket_s * bk)
+{
+        uint64_t mask = cf_match(cf, bk, 0);
+
+        return mask ? __builtin_ctzll(mask) : -ENOSPC;
+}
+
+/*
+ * the other bucket of fingerprint, needs no key
+ */
+always_inline uint32_t
+cf_alt_idx (const struct dcht_cuckoo_filter_s * cf,
+            uint32_t idx,
+            uint32_t fp)
+{
+        return (idx ^ HASH(0x5bd1e995, fp)) & cf->mask;
+}
+
+/**
+ * @brief Fetch the buckets and fingerprint of key
+ *
+ * @param cf: cuckoo filter pointer
+ * @param bk_p: bucket pointer array[2]
+ * @param key: key
+ * @return fingerprint, never zero
+ */
+always_inline uint32_t
+cf_buckets_fetch (struct dcht_cuckoo_filter_s * cf,
+                  struct dcht_cf_bucket_s ** bk_p,
+                  uint32_t key)
+{
+        uint32_t h, idx, fp;
+
+        h = HASH(0xdeadbeef, key);
+        h = HASH(h, BSWAP(key));
+        idx = h & cf->mask;
+
+        /* independent of the index bits */
+        fp = HASH(h, key) >> (32 - cf->fp_bits);
+        if (!fp)
+                fp = 1;
+
+        bk_p[0] = &cf->buckets[idx];
+        bk_p[1] = &cf->buckets[cf_alt_idx(cf, idx, fp)];
+
+        prefetch(bk_p[0]);
+        prefetch(bk_p[1]);
+        return fp;
+}
+
+/**
+ * @brief make free space, a fingerprint is copied before it is removed
+ *
+ * @param cf: cuckoo filter pointer
+ * @param idx: full bucket
+ * @param depth: Number of layers to go back by recursion
+ * @return an empty position, if failed then negative
+ */
+static int
+cf_make_room (struct dcht_cuckoo_filter_s * cf,
+              uint32_t idx,
+              int depth)
+{
+        struct dcht_cf_bucket_s * bk = &cf->buckets[idx];
+        uint32_t alt[CF_SLOTS_MAX];
+
+        /* setup & prefetch */
+        for (unsigned s = 0; s < cf->nb_slots; s++) {
+                alt[s] = cf_alt_idx(cf, idx, cf_load_fp(cf, bk, s));
+                prefetch(&cf->buckets[alt[s]]);
+        }
+
+        /* check vacancy */
+        for (unsigned s = 0; s < cf->nb_slots; s++) {
+                int pos;
+
+                if (alt[s] == idx)
+                        continue;
+                pos = cf_find_vacancy(cf, &cf->buckets[alt[s]]);
+                if (pos >= 0) {
+                        cf_store_fp(cf, &cf->buckets[alt[s]], pos, cf_load_fp(cf, bk, s));
+                        cf_store_fp(cf, bk, s, 0);
+                        return s;
+                }
+        }
+
+        /* make vacancy under bucket */
+        for (unsigned s = 0; depth > 0 && s < cf->nb_slots; s++) {
+                uint32_t fp;
+                int pos;
+
+                if (alt[s] == idx)
+                        continue;
+                pos = cf_make_room(cf, alt[s], depth - 1);
+                if (pos < 0)
+                        continue;
+
+                /* the deeper moves may have taken the fingerprint out of bk */
+                fp = cf_load_fp(cf, bk, s);
+                if (!fp)
+                        return s;
+                if (cf_alt_idx(cf, idx, fp) == alt[s]) {
+                        cf_store_fp(cf, &cf->buckets[alt[s]], pos, fp);
+                        cf_store_fp(cf, bk, s, 0);
+                        return s;
+                }
+        }
+
+        return -ENOSPC;
+}
+
+/*
+ * max buckets
+ */
+always_inline unsigned
+cf_nb_buckets (unsigned nb_entries,
+               unsigned nb_slots)
+{
+        if (nb_entries < DCHT_NB_ENTRIES_MIN)
+                nb_entries = DCHT_NB_ENTRIES_MIN;
+
+        /* power of 2 for the xor alternate, full rate 80% */
+        unsigned nb_buckets = align64pow2(nb_entries * 1.27) / nb_slots;
+
+        return nb_buckets < 2 ? 2 : nb_buckets;
+}
+
+/************************************************************************
+ * supported cuckoo filter API
+ ************************************************************************/
+size_t
+dcht_cuckoo_filter_size (unsigned max_entries,
+                         unsigned fp_bits)
+{
+        size_t size = 0;
+
+        if (fp_bits == 8 || fp_bits == 16)
+                size = sizeof(struct dcht_cuckoo_filter_s) +
+                       sizeof(struct dcht_cf_bucket_s) * cf_nb_buckets(max_entries,
+                                                                       DCHT_CACHELINE_SIZE * 8 / fp_bits);
+
+        TRACER("max:%u fp_bits:%u size:%zu\n", max_entries, fp_bits, size);
+        return size;
+}
+
+void
+dcht_cuckoo_filter_clean (struct dcht_cuckoo_filter_s * cf)
+{
+        memset(cf->buckets, 0, sizeof(struct dcht_cf_bucket_s) * cf->nb_buckets);
+        cf->current_entries = 0;
+        TRACER("cleaned cf:%p\n", cf);
+}
+
+int
+dcht_cuckoo_filter_init (struct dcht_cuckoo_filter_s * cf,
+                         size_t size,
+                         unsigned max_entries,
+                         unsigned fp_bits)
+{
+        size_t need = dcht_cuckoo_filter_size(max_entries, fp_bits);
+
+        if (!cf || (uintptr_t) cf % DCHT_CACHELINE_SIZE != 0 || !need || size < need) {
+                TRACER("invalid cf:%p size:%zu fp_bits:%u\n", cf, size, fp_bits);
+                return -EINVAL;
+        }
+
+        memset(cf, 0, sizeof(*cf));
+        cf->fp_bits      = fp_bits;
+        cf->nb_slots     = DCHT_CACHELINE_SIZE * 8 / fp_bits;
+        cf->nb_buckets   = cf_nb_buckets(max_entries, cf->nb_slots);
+        cf->mask         = cf->nb_buckets - 1;
+        cf->size         = size;
+        cf->max_entries  = max_entries;
+        cf->nb_entries   = cf->nb_buckets * cf->nb_slots;
+        cf->follow_depth = CF_FOLLOW_DEPTH_DEFAULT;
+
+        dcht_cuckoo_filter_clean(cf);
+        TRACER("cf:%p size:%zu max_entries:%u nb_buckets:%u fp_bits:%u\n",
+               cf, size, max_entries, cf->nb_buckets, fp_bits);
+        return 0;
+}
+
+struct dcht_cuckoo_filter_s *
+dcht_cuckoo_filter_create (unsigned max_entries,
+                           unsigned fp_bits)
+{
+        size_t size = dcht_cuckoo_filter_size(max_entries, fp_bits);
+        struct dcht_cuckoo_filter_s * cf;
+
+        if (!size)
+                return NULL;
+
+        cf = aligned_alloc(DCHT_CACHELINE_SIZE, size);
+        if (dcht_cuckoo_filter_init(cf, size, max_entries, fp_bits)) {
+                free(cf);
+                cf = NULL;
+        }
+        return cf;
+}
+
+int
+dcht_cuckoo_filter_add (struct dcht_cuckoo_filter_s * cf,
+                        uint32_t key)
+{
+        struct dcht_cf_bucket_s * bk_p[2];
+        uint64_t vacant[2];
+        uint32_t fp;
+        int i, pos, ret;
+
+        fp = cf_buckets_fetch(cf, bk_p, key);
+
+        /* the one with more vacancies */
+        vacant[0] = cf_match(cf, bk_p[0], 0);
+        vacant[1] = cf_match(cf, bk_p[1], 0);
+        i = __builtin_popcountll(vacant[0]) >= __builtin_popcountll(vacant[1]) ? 0 : 1;
+        if (vacant[i]) {
+                pos = __builtin_ctzll(vacant[i]);
+        } else {
+                for (i = 0; i < 2; i++) {
+                        pos = cf_make_room(cf, bk_p[i] - cf->buckets, cf->follow_depth);
+                        if (pos >= 0)
+                                break;
+                }
+                if (i == 2) {
+                        ret = -ENOSPC;
+                        goto end;
+                }
+        }
+
+        cf_store_fp(cf, bk_p[i], pos, fp);
+        cf->current_entries += 1;
+        ret = 0;
+ end:
+        TRACER("ret:%d key:%u fp:%x\n", ret, key, fp);
+        return ret;
+}
+
+int
+dcht_cuckoo_filter_del (struct dcht_cuckoo_filter_s * cf,
+                        uint32_t key)
+{
+        struct dcht_cf_bucket_s * bk_p[2];
+        uint32_t fp = cf_buckets_fetch(cf, bk_p, key);
+
+        for (int i = 0; i < 2; i++) {
+                uint64_t mask = cf_match(cf, bk_p[i], fp);
+
+                if (mask) {
+                        cf_store_fp(cf, bk_p[i], __builtin_ctzll(mask), 0);
+                        assert(cf->current_entries > 0);
+                        cf->current_entries -= 1;
+                        TRACER("deleted key:%u fp:%x bk:%d\n", key, fp, i);
+                        return 0;
+                }
+        }
+        return -ENOENT;
+}
+
+bool
+dcht_cuckoo_filter_contains (struct dcht_cuckoo_filter_s * cf,
+                             uint32_t key)
+{
+        struct dcht_cf_bucket_s * bk_p[2];
+        uint32_t fp = cf_buckets_fetch(cf, bk_p, key);
+
+        return cf_match(cf, bk_p[0], fp) || cf_match(cf, bk_p[1], fp);
+}
+
+unsigned
+dcht_cuckoo_filter_contains_bulk (struct dcht_cuckoo_filter_s * cf,
+                                  const uint32_t * keys,
+                                  unsigned nb,
+                                  bool * hits)
+{
+        struct dcht_cf_bucket_s * ring[DCHT_BULK_AHEAD][2];
+        uint32_t fps[DCHT_BULK_AHEAD];
+        unsigned found = 0;
+
+        for (unsigned i = 0; i < nb && i < DCHT_BULK_AHEAD; i++)
+                fps[i] = cf_buckets_fetch(cf, ring[i], keys[i]);
+
+        for (unsigned i = 0; i < nb; i++) {
+                unsigned r = i % DCHT_BULK_AHEAD;
+                bool hit = cf_match(cf, ring[r][0], fps[r]) || cf_match(cf, ring[r][1], fps[r]);
+
+                /* the slot is free, fetch the one DCHT_BULK_AHEAD ahead */
+                if (i + DCHT_BULK_AHEAD < nb)
+                        fps[r] = cf_buckets_fetch(cf, ring[r], keys[i + DCHT_BULK_AHEAD]);
+
+                if (hits)
+                        hits[i] = hit;
+                found += hit;
+        }
+        return found;
+}
+
+double
+dcht_cuckoo_filter_fpr (const struct dcht_cuckoo_filter_s * cf)
+{
+        /* 2 buckets of fingerprints, each one matches by chance */
+        double load = (double) cf->current_entries / cf->nb_entries;
+        double fpr = 2.0 * cf->nb_slots * load / ((1u << cf->fp_bits) - 1);
+
+        return fpr < 1.0 ? fpr : 1.0;
+}
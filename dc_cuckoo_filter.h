@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo filter, approximate membership
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) 64 byte bucket of 32 x 16 bit or 64 x 8 bit fingerprints
+ * (4) no false negative, false positive rate by fingerprint bits
+ */
+
+#ifndef _DC_CUCKOO_FILTER_H_
+#define _DC_CUCKOO_FILTER_H_
+
+#include "dc_hash_tbl.h"
+
+/*
+ * fingerprint bucket : must be cacheline size alignment
+ * zero fingerprint is vacancy
+ */
+struct dcht_cf_bucket_s {
+        union {
+                uint16_t fp16[DCHT_CACHELINE_SIZE / sizeof(uint16_t)];
+                uint8_t fp8[DCHT_CACHELINE_SIZE];
+        };
+} __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+
+/*
+ * cuckoo filter
+ */
+struct dcht_cuckoo_filter_s {
+        size_t size;
+
+        unsigned nb_buckets;
+        unsigned nb_entries;
+
+        uint32_t mask;
+        unsigned max_entries;
+
+        unsigned current_entries;
+        int follow_depth;
+
+        unsigned fp_bits;		/* 8 or 16 */
+        unsigned nb_slots;		/* fingerprints per bucket */
+
+        struct dcht_cf_bucket_s buckets[] __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+};
+
+/**
+ * @brief Calculate cuckoo filter size
+ *
+ * @param max_entries: Maximum registration number
+ * @param fp_bits: fingerprint bits, 8 or 16
+ * @return Return used memory size, 0 on invalid fp_bits
+ */
+extern size_t dcht_cuckoo_filter_size(unsigned max_entries,
+                                      unsigned fp_bits);
+
+/**
+ * @brief Initialize the cuckoo filter
+ *
+ * @param cf: cuckoo filter pointer(Must be cacheline size algined)
+ * @param size: size of cuckoo filter
+ * @param max_entries: Maximum registration number
+ * @param fp_bits: fingerprint bits, 8 or 16
+ * @return success then zero, failuer thern negative
+ */
+extern int dcht_cuckoo_filter_init(struct dcht_cuckoo_filter_s * cf,
+                                   size_t size,
+                                   unsigned max_entries,
+                                   unsigned fp_bits);
+
+/**
+ * @brief create cuckoo filter
+ *
+ * @param max_entries: Maximum number that can be registered
+ * @param fp_bits: fingerprint bits, 8 or 16
+ * @return created cuckoo filter pointer
+ */
+extern struct dcht_cuckoo_filter_s * dcht_cuckoo_filter_create(unsigned max_entries,
+                                                               unsigned fp_bits);
+
+/**
+ * @brief release all fingerprints
+ *
+ * @param cf: cuckoo filter pointer
+ * @return void
+ */
+extern void dcht_cuckoo_filter_clean(struct dcht_cuckoo_filter_s * cf);
+
+/**
+ * @brief add key, a key added twice must be deleted twice
+ *
+ * @param cf: cuckoo filter
+ * @param key: key
+ * @return success:0 no space:-ENOSPC
+ */
+extern int dcht_cuckoo_filter_add(struct dcht_cuckoo_filter_s * cf,
+                                  uint32_t key);
+
+/**
+ * @brief delete key, it must have been added
+ *
+ * @param cf: cuckoo filter
+ * @param key: deleting key
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_cuckoo_filter_del(struct dcht_cuckoo_filter_s * cf,
+                                  uint32_t key);
+
+/**
+ * @brief search key
+ *
+ * @param cf: cuckoo filter
+ * @param key: search key
+ * @return false if key was not added, true if it may be
+ */
+extern bool dcht_cuckoo_filter_contains(struct dcht_cuckoo_filter_s * cf,
+                                        uint32_t key);
+
+/**
+ * @brief search keys, with bucket prefetch running ahead
+ *
+ * @param cf: cuckoo filter
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param hits: array to set the results (may be NULL)
+ * @return number of keys which may be added
+ */
+extern unsigned dcht_cuckoo_filter_contains_bulk(struct dcht_cuckoo_filter_s * cf,
+                                                 const uint32_t * keys,
+                                                 unsigned nb,
+                                                 bool * hits);
+
+/**
+ * @brief expected false positive rate at the current load
+ *
+ * @param cf: cuckoo filter
+ * @return false positive rate
+ */
+extern double dcht_cuckoo_filter_fpr(const struct dcht_cuckoo_filter_s * cf);
+
+#endif	/* !_DC_CUCKOO_FILTER_H_ */
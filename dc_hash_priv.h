@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * helpers shared by the hash table modules, not a public API
+ */
+
+#ifndef _DC_HASH_PRIV_H_
+#define _DC_HASH_PRIV_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__)
+# include <cpuid.h>
+#endif	/* __x86_64__ */
+
+#ifndef always_inline
+# define always_inline	static inline __attribute__ ((__always_inline__))
+#endif	/* !always_inline */
+
+#define ARRAYOF(_a)	(sizeof(_a)/sizeof(_a[0]))
+
+#if defined(ENABLE_HASH_TRACER)
+# define TRACER(fmt,...)	fprintf(stderr, "%s():%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
+#else
+# define TRACER(fmt,...)
+#endif
+
+/**
+ * @brief prefetch memory (non temporal)
+ *
+ * @param memory pointer
+ * @return void
+ */
+always_inline void
+prefetch (const void *p)
+{
+        //        asm volatile ("prefetchnta %[p]" : : [p] "m" (*(const volatile char *)p));
+        __builtin_prefetch(p, 0, 3);	/* non temporal */
+}
+
+/*
+ * @brief FNV-1a hash
+ */
+always_inline uint32_t
+fnv1a (uint32_t init,
+       uint32_t val)
+{
+        uint32_t value[2];
+        value[0] = init;
+        value[1] = val;
+
+        uint32_t hash = 0x811c9dc5;  // FNV offset basis
+        uint8_t * ptr = (uint8_t *) value;
+        uint32_t prime = 0x01000193; // FNV prime
+
+        for (unsigned i = 0; i < sizeof(value); i++) {
+                hash ^= (uint32_t) ptr[i];
+                hash *= prime;
+        }
+
+        return hash;
+}
+
+/**
+ * @brief Set all bits below MSB
+ *
+ * @param v: input integer
+ * @return integer
+ */
+always_inline uint64_t
+combine64ms1b (uint64_t v)
+{
+        v |= v >> 1;
+        v |= v >> 2;
+        v |= v >> 4;
+        v |= v >> 8;
+        v |= v >> 16;
+        v |= v >> 32;
+        return v;
+}
+
+/**
+ * @brief Returns the nearest power of 2 times greater than
+ *
+ * @param input integer
+ * @return integer
+ */
+always_inline uint64_t
+align64pow2 (uint64_t v)
+{
+        v--;
+        v = combine64ms1b(v);
+        return v + 1;
+}
+
+#if defined(__x86_64__)
+/*
+ * x86 ISA levels of the drivers, each includes the lower ones
+ */
+enum x86_isa_e {
+        X86_ISA_SSE2 = 0,	/* the x86_64 baseline */
+        X86_ISA_SSE42,		/* POPCNT,SSE4_2 */
+        X86_ISA_AVX2,		/* AVX2,BMI,POPCNT,SSE4_2 and the YMM state */
+};
+
+/*
+ * the OS saves the YMM state (XCR0 SSE and AVX bits), hypervisors may mask it
+ */
+always_inline bool
+x86_ymm_enabled (uint32_t ecx)
+{
+        uint32_t lo, hi;
+
+        if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+                return false;
+        __asm__ volatile("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        (void) hi;
+        return (lo & 0x6) == 0x6;
+}
+
+/*
+ * the widest ISA level of this CPU and OS
+ * called by the ifunc resolvers before relocation, no library call here
+ */
+always_inline enum x86_isa_e
+x86_isa_probe (void)
+{
+        uint32_t max = 0, eax, ebx, ecx, edx;
+
+        // Get the highest function parameter.
+        __get_cpuid(0, &max, &ebx, &ecx, &edx);
+        if (max < 1)
+                return X86_ISA_SSE2;
+
+        __cpuid_count(1, 0, eax, ebx, ecx, edx);
+        if (!(ecx & bit_SSE4_2) || !(ecx & bit_POPCNT))
+                return X86_ISA_SSE2;
+
+        // Check if the function parameter for extended features is available.
+        if (max < 7 || !x86_ymm_enabled(ecx))
+                return X86_ISA_SSE42;
+
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        (void) eax;
+        if (!(ebx & bit_AVX2) || !(ebx & bit_BMI))
+                return X86_ISA_SSE42;
+        return X86_ISA_AVX2;
+}
+#endif	/* __x86_64__ */
+
+#endif	/* !_DC_HASH_PRIV_H_ */
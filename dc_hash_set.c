@@ -0,0 +1,526 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo hash set, keys only
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) support add, del, contains API
+ * (4) Zero cannot be used for Key
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "dc_hash_set.h"
+#include "dc_hash_priv.h"
+
+/******************************************************************
+ * Set Reader|writer
+ ******************************************************************/
+always_inline void
+set_store_key (struct dcht_set_bucket_s * bk,
+               int pos,
+               uint32_t key)
+{
+        atomic_store_explicit(&bk->key[pos], key, memory_order_release);
+}
+
+always_inline uint32_t
+set_load_key (const struct dcht_set_bucket_s * bk,
+              int pos)
+{
+        return atomic_load_explicit(&bk->key[pos], memory_order_acquire);
+}
+
+/*
+ * handler for each CPU Arch
+ */
+struct set_handler_s {
+        uint32_t (*hash32)(uint32_t,uint32_t);			/* 32 bit hash generator */
+        unsigned (*match_bk)(const struct dcht_set_bucket_s *,
+                             uint32_t);				/* key match bitmap in a bucket */
+        bool (*contains_bk_pair)(struct dcht_set_bucket_s **,
+                                 uint32_t);			/* key in buckets pair */
+};
+
+/*****************************************************************************
+ * start Generic Arch code--->
+ *****************************************************************************/
+/*
+ * key match bitmap in a bucket (async)
+ */
+always_inline unsigned
+set_match_in_bucket_GEN (const struct dcht_set_bucket_s * bk,
+                         uint32_t key)
+{
+        unsigned mask = 0;
+
+        for (int pos = 0; pos < (int) DCHT_SET_BUCKET_ENTRY_SZ; pos++) {
+                if (set_load_key(bk, pos) == key)
+                        mask |= 1u << pos;
+        }
+
+        TRACER("key:%u mask:%04x\n", key, mask);
+        return mask;
+}
+
+/*
+ * key in 2 buckets (async)
+ */
+always_inline bool
+set_contains_in_bucket_pair_GEN (struct dcht_set_bucket_s ** bk_p,
+                                 uint32_t key)
+{
+        return set_match_in_bucket_GEN(bk_p[0], key) || set_match_in_bucket_GEN(bk_p[1], key);
+}
+
+static const struct set_handler_s set_generic_handlers = {
+        .hash32 = fnv1a,
+        .match_bk = set_match_in_bucket_GEN,
+        .contains_bk_pair = set_contains_in_bucket_pair_GEN,
+};
+
+/*****************************************************************************
+ * <---end Generic Arch code
+ *****************************************************************************/
+
+static const struct set_handler_s * set_handler = &set_generic_handlers;
+
+#define BSWAP(_v)				__builtin_bswap32((_v))
+#define HASH(_i,_v)				set_handler->hash32((_i),(_v))
+#define MATCH_IN_BUCKET(_bk,_key)		set_handler->match_bk((_bk),(_key))
+#define CONTAINS_IN_BUCKET_PAIR(_bk_p,_key)	set_handler->contains_bk_pair((_bk_p),(_key))
+
+#if defined(__x86_64__)
+/*****************************************************************************
+ * x86_64 depened code start--->
+ *****************************************************************************/
+#include <immintrin.h>
+
+/******************************************************************************
+ * AVX2 code
+ * the rest of the library is built for the baseline ISA
+ ******************************************************************************/
+#pragma GCC push_options
+#pragma GCC target("avx2,sse4.2")
+
+/*
+ * key match bitmap of 16 keys, two compares (async)
+ */
+always_inline unsigned
+set_match_in_bucket_AVX2 (const struct dcht_set_bucket_s * bk,
+                          uint32_t key)
+{
+        __m256i search_key = _mm256_set1_epi32(key);
+        __m256i lo = _mm256_load_si256((__m256i *) (volatile void *) &bk->key[0]);
+        __m256i hi = _mm256_load_si256((__m256i *) (volatile void *) &bk->key[8]);
+        unsigned mask;
+
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(search_key, lo)));
+        mask |= _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(search_key, hi))) << 8;
+
+        TRACER("key:%u mask:%04x\n", key, mask);
+        return mask;
+}
+
+/*
+ * key in 2 buckets, four compares folded into one test (async)
+ */
+always_inline bool
+set_contains_in_bucket_pair_AVX2 (struct dcht_set_bucket_s ** bk_p,
+                                  uint32_t key)
+{
+        __m256i search_key = _mm256_set1_epi32(key);
+        __m256i cmp;
+
+        cmp = _mm256_cmpeq_epi32(search_key,
+                                 _mm256_load_si256((__m256i *) (volatile void *) &bk_p[0]->key[0]));
+        cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(search_key,
+                                                      _mm256_load_si256((__m256i *) (volatile void *) &bk_p[0]->key[8])));
+        cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(search_key,
+                                                      _mm256_load_si256((__m256i *) (volatile void *) &bk_p[1]->key[0])));
+        cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(search_key,
+                                                      _mm256_load_si256((__m256i *) (volatile void *) &bk_p[1]->key[8])));
+
+        return !_mm256_testz_si256(cmp, cmp);
+}
+
+/**
+ * @brief crc32c calc
+ *
+ * @param initial value
+ * @param target value
+ * @return crc32c
+ */
+always_inline uint32_t
+set_crc32c32 (uint32_t init,
+              uint32_t val)
+{
+        return _mm_crc32_u32(init, val);
+}
+
+static const struct set_handler_s set_avx2_handlers = {
+        .hash32           = set_crc32c32,
+        .match_bk         = set_match_in_bucket_AVX2,
+        .contains_bk_pair = set_contains_in_bucket_pair_AVX2,
+};
+
+#pragma GCC pop_options
+
+/*
+ * AVX2 and SSE4_2(crc32c), with the YMM state saved by the OS
+ */
+static const struct set_handler_s *
+set_x86_handler_get (void)
+{
+        const struct set_handler_s * handler = set_handler;
+
+#ifndef	DISABLE_AVX2_DRIVER
+        if (x86_isa_probe() == X86_ISA_AVX2) {
+                TRACER("use X86_64 AVX2 hash set driver\n");
+                handler = &set_avx2_handlers;
+        } else {
+                TRACER("use generic hash set driver\n");
+        }
+#else	/* !DISABLE_AVX2_DRIVER */
+        (void) &set_avx2_handlers;
+#endif	/* DISABLE_AVX2_DRIVER */
+        return handler;
+}
+
+/*****************************************************************************
+ * <---end x86 depened code
+ *****************************************************************************/
+#endif	/* __x86_64__ */
+
+/*
+ * select the driver of this process once, ahead of the constructors that may use it
+ */
+static void __attribute__((constructor(101)))
+set_handler_init (void)
+{
+#if defined(__x86_64__)
+        set_handler = set_x86_handler_get();
+#endif	/* __x86_64__ */
+}
+
+/**
+ * @brief find vacancy position
+ *
+ * @param bk: bucket
+ * @return Returns the position where a vacancy was found.
+ *         Returns negative if not found.
+ */
+always_inline int
+set_find_vacancy (const struct dcht_set_bucket_s * bk)
+{
+        unsigned mask = MATCH_IN_BUCKET(bk, DCHT_SENTINEL_KEY);
+
+        return mask ? __builtin_ctz(mask) : -ENOSPC;
+}
+
+/**
+ * @brief Fetch the buckets where key is entried
+ *
+ * @param set: hash set pointer
+ * @param bk_p: bucket pointer array[2]
+ * @param key: entry key
+ * @return void
+ */
+always_inline void
+set_buckets_fetch (const struct dcht_hash_set_s * set,
+                   struct dcht_set_bucket_s ** bk_p,
+                   uint32_t key)
+{
+        unsigned x, y, msk = set->mask;
+        unsigned pos[2];
+
+        x = HASH(0xdeadbeef, key);
+        x = HASH(x, BSWAP(key));
+        pos[0] = x & msk;
+        while (!pos[0]) {
+                x = HASH(x, key);
+                pos[0] = x & msk;
+        }
+
+        y = BSWAP(key ^ x);
+        pos[1] = y & msk;
+        while (pos[0] == pos[1] || !pos[1]) {
+                y = HASH(y, ~BSWAP(key));
+                pos[1] = y & msk;
+        }
+
+        bk_p[0] = (struct dcht_set_bucket_s *) &set->buckets[pos[0] - 1];
+        bk_p[1] = (struct dcht_set_bucket_s *) &set->buckets[pos[1] - 1];
+
+        prefetch(bk_p[0]);
+        prefetch(bk_p[1]);
+}
+
+/**
+ * @brief make free space
+ *
+ * @param set: hash set pointer
+ * @param bk: full bucket
+ * @param depth: Number of layers to go back by recursion
+ * @return an empty position, if failed then negative
+ */
+static int
+set_cuckoo_replace (struct dcht_hash_set_s * set,
+                    struct dcht_set_bucket_s * bk,
+                    int depth)
+{
+        struct dcht_set_bucket_s * another[DCHT_SET_BUCKET_ENTRY_SZ];
+
+        /* setup & prefetch */
+        for (int i = 0; i < (int) DCHT_SET_BUCKET_ENTRY_SZ; i++) {
+                struct dcht_set_bucket_s * bk_p[2];
+
+                set_buckets_fetch(set, bk_p, bk->key[i]);
+                another[i] = bk_p[0] == bk ? bk_p[1] : bk_p[0];
+        }
+
+        /* check vacancy */
+        for (int i = 0; i < (int) DCHT_SET_BUCKET_ENTRY_SZ; i++) {
+                int pos = set_find_vacancy(another[i]);
+
+                if (pos >= 0) {
+                        /* the key is in both buckets for a while, never in none */
+                        set_store_key(another[i], pos, bk->key[i]);
+                        set_store_key(bk, i, DCHT_SENTINEL_KEY);
+                        return i;
+                }
+        }
+
+        /* make vacancy under bucket */
+        if (depth > 0) {
+                for (int i = 0; i < (int) DCHT_SET_BUCKET_ENTRY_SZ; i++) {
+                        int pos = set_cuckoo_replace(set, another[i], depth - 1);
+
+                        if (pos >= 0) {
+                                set_store_key(another[i], pos, bk->key[i]);
+                                set_store_key(bk, i, DCHT_SENTINEL_KEY);
+                                return i;
+                        }
+                }
+        }
+
+        return -ENOSPC;
+}
+
+/*
+ * max buckets + 1
+ */
+always_inline unsigned
+set_nb_buckets (unsigned nb_entries)
+{
+        if (nb_entries < DCHT_NB_ENTRIES_MIN)
+                nb_entries = DCHT_NB_ENTRIES_MIN;
+        unsigned nb_buckets = align64pow2(nb_entries * 1.27) / DCHT_SET_BUCKET_ENTRY_SZ;	/* full rate 80% */
+
+        return nb_buckets;
+}
+
+/************************************************************************
+ * supported hash set API
+ ************************************************************************/
+size_t
+dcht_hash_set_size (unsigned max_entries)
+{
+        /* hash position zero is not used, see set_buckets_fetch() */
+        size_t size = sizeof(struct dcht_hash_set_s) +
+                      sizeof(struct dcht_set_bucket_s) * (set_nb_buckets(max_entries) - 1);
+
+        TRACER("max:%u size:%zu\n", max_entries, size);
+        return size;
+}
+
+void
+dcht_hash_set_clean (struct dcht_hash_set_s * set)
+{
+        memset(set->buckets, 0, sizeof(struct dcht_set_bucket_s) * set->nb_buckets);
+        set->current_entries = 0;
+        TRACER("cleaned set:%p\n", set);
+}
+
+int
+dcht_hash_set_init (struct dcht_hash_set_s * set,
+                    size_t size,
+                    unsigned max_entries)
+{
+        unsigned nb_buckets;
+
+        if (!set || (uintptr_t) set % DCHT_CACHELINE_SIZE != 0 ||
+            size < dcht_hash_set_size(max_entries)) {
+                TRACER("invalid set:%p size:%zu\n", set, size);
+                return -EINVAL;
+        }
+        nb_buckets = set_nb_buckets(max_entries);
+
+        memset(set, 0, sizeof(*set));
+        set->nb_buckets   = nb_buckets - 1;	/* hash position zero is not used */
+        set->mask         = nb_buckets - 1;
+        set->size         = size;
+        set->max_entries  = max_entries;
+        set->nb_entries   = set->nb_buckets * DCHT_SET_BUCKET_ENTRY_SZ;
+        set->follow_depth = DCHT_FOLLOW_DEPTH_DEFAULT;
+
+        dcht_hash_set_clean(set);
+        TRACER("set:%p size:%zu max_entries:%u nb_buckets:%u\n",
+               set, size, max_entries, set->nb_buckets);
+        return 0;
+}
+
+struct dcht_hash_set_s *
+dcht_hash_set_create (unsigned max_entries)
+{
+        size_t size = dcht_hash_set_size(max_entries);
+        struct dcht_hash_set_s * set = aligned_alloc(DCHT_CACHELINE_SIZE, size);
+
+        if (dcht_hash_set_init(set, size, max_entries)) {
+                free(set);
+                set = NULL;
+        }
+        return set;
+}
+
+int
+dcht_hash_set_add (struct dcht_hash_set_s * set,
+                   uint32_t key)
+{
+        struct dcht_set_bucket_s * bk_p[2];
+        unsigned vacant[2];
+        int i, pos, ret;
+
+        if (key == DCHT_SENTINEL_KEY)
+                return -EINVAL;
+
+        set_buckets_fetch(set, bk_p, key);
+
+        if (CONTAINS_IN_BUCKET_PAIR(bk_p, key)) {
+                ret = -EEXIST;
+                goto end;
+        }
+
+        /* the one with more vacancies */
+        vacant[0] = MATCH_IN_BUCKET(bk_p[0], DCHT_SENTINEL_KEY);
+        vacant[1] = MATCH_IN_BUCKET(bk_p[1], DCHT_SENTINEL_KEY);
+        i = __builtin_popcount(vacant[0]) >= __builtin_popcount(vacant[1]) ? 0 : 1;
+        if (vacant[i]) {
+                pos = __builtin_ctz(vacant[i]);
+        } else {
+                for (i = 0; i < 2; i++) {
+                        pos = set_cuckoo_replace(set, bk_p[i], set->follow_depth);
+                        if (pos >= 0)
+                                break;
+                }
+                if (i == 2) {
+                        ret = -ENOSPC;
+                        goto end;
+                }
+        }
+
+        set_store_key(bk_p[i], pos, key);
+        set->current_entries += 1;
+        ret = 0;
+ end:
+        TRACER("ret:%d key:%u\n", ret, key);
+        return ret;
+}
+
+int
+dcht_hash_set_del (struct dcht_hash_set_s * set,
+                   uint32_t key)
+{
+        struct dcht_set_bucket_s * bk_p[2];
+
+        set_buckets_fetch(set, bk_p, key);
+
+        for (int i = 0; i < 2; i++) {
+                unsigned mask = MATCH_IN_BUCKET(bk_p[i], key);
+
+                if (mask) {
+                        set_store_key(bk_p[i], __builtin_ctz(mask), DCHT_SENTINEL_KEY);
+                        assert(set->current_entries > 0);
+                        set->current_entries -= 1;
+                        TRACER("deleted key:%u bk:%d\n", key, i);
+                        return 0;
+                }
+        }
+        return -ENOENT;
+}
+
+bool
+dcht_hash_set_contains (struct dcht_hash_set_s * set,
+                        uint32_t key)
+{
+        struct dcht_set_bucket_s * bk_p[2];
+
+        set_buckets_fetch(set, bk_p, key);
+        return CONTAINS_IN_BUCKET_PAIR(bk_p, key);
+}
+
+unsigned
+dcht_hash_set_contains_bulk (struct dcht_hash_set_s * set,
+                             const uint32_t * keys,
+                             unsigned nb,
+                             bool * hits)
+{
+        struct dcht_set_bucket_s * ring[DCHT_BULK_AHEAD][2];
+        unsigned found = 0;
+
+        for (unsigned i = 0; i < nb && i < DCHT_BULK_AHEAD; i++)
+                set_buckets_fetch(set, ring[i], keys[i]);
+
+        for (unsigned i = 0; i < nb; i++) {
+                struct dcht_set_bucket_s ** bk_p = ring[i % DCHT_BULK_AHEAD];
+                bool hit = CONTAINS_IN_BUCKET_PAIR(bk_p, keys[i]);
+
+                /* the slot is free, fetch the one DCHT_BULK_AHEAD ahead */
+                if (i + DCHT_BULK_AHEAD < nb)
+                        set_buckets_fetch(set, bk_p, keys[i + DCHT_BULK_AHEAD]);
+
+                if (hits)
+                        hits[i] = hit;
+                found += hit;
+        }
+        return found;
+}
+
+int
+dcht_hash_set_verify (struct dcht_hash_set_s * set)
+{
+        unsigned nb = 0;
+
+        for (unsigned b = 0; b < set->nb_buckets; b++) {
+                struct dcht_set_bucket_s * bk = &set->buckets[b];
+
+                for (int i = 0; i < (int) DCHT_SET_BUCKET_ENTRY_SZ; i++) {
+                        struct dcht_set_bucket_s * bk_p[2];
+                        uint32_t key = bk->key[i];
+
+                        if (key == DCHT_SENTINEL_KEY)
+                                continue;
+
+                        /* once, in one of its buckets */
+                        set_buckets_fetch(set, bk_p, key);
+                        if ((bk != bk_p[0] && bk != bk_p[1]) ||
+                            __builtin_popcount(MATCH_IN_BUCKET(bk_p[0], key)) +
+                            __builtin_popcount(MATCH_IN_BUCKET(bk_p[1], key)) != 1) {
+                                TRACER("invalid bk:%u key:%u\n", b, key);
+                                return -EINVAL;
+                        }
+                        nb += 1;
+                }
+        }
+        if (nb != set->current_entries) {
+                TRACER("mismatched number of entries:%u %u\n", set->current_entries, nb);
+                return -1;
+        }
+        return 0;
+}
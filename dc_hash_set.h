@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo hash set, keys only
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) 16 keys per cacheline bucket
+ * (4) Zero cannot be used for Key (range 1~0xffffffff)
+ */
+
+#ifndef _DC_HASH_SET_H_
+#define _DC_HASH_SET_H_
+
+#include "dc_hash_tbl.h"
+
+/*
+ * fixed params
+ */
+#define DCHT_SET_BUCKET_ENTRY_SZ	(DCHT_CACHELINE_SIZE / sizeof(uint32_t))
+
+/*
+ * set bucket : must be cacheline size alignment
+ */
+struct dcht_set_bucket_s {
+        uint32_t key[DCHT_SET_BUCKET_ENTRY_SZ];
+} __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+
+/*
+ * cuckoo hash set
+ */
+struct dcht_hash_set_s {
+        size_t size;
+
+        unsigned nb_buckets;
+        unsigned nb_entries;
+
+        uint32_t mask;
+        unsigned max_entries;
+
+        unsigned current_entries;
+        int follow_depth;
+
+        struct dcht_set_bucket_s buckets[] __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+};
+
+/**
+ * @brief Calculate hash set size
+ *
+ * @param max_entries: Maximum registration number
+ * @return Return used memory size
+ */
+extern size_t dcht_hash_set_size(unsigned max_entries);
+
+/**
+ * @brief Initialize the hash set
+ *
+ * @param set: hash set pointer(Must be cacheline size algined)
+ * @param size: size of hash set
+ * @param max_entries: Maximum registration number
+ * @return success then zero, failuer thern negative
+ */
+extern int dcht_hash_set_init(struct dcht_hash_set_s * set,
+                              size_t size,
+                              unsigned max_entries);
+
+/**
+ * @brief create hash set
+ *
+ * @param max_entries: Maximum number that can be registered
+ * @return created hash set pointer
+ */
+extern struct dcht_hash_set_s * dcht_hash_set_create(unsigned max_entries);
+
+/**
+ * @brief release all keys
+ *
+ * @param set: hash set pointer
+ * @return void
+ */
+extern void dcht_hash_set_clean(struct dcht_hash_set_s * set);
+
+/**
+ * @brief add key in hash set
+ *
+ * @param set: hash set
+ * @param key: key
+ * @return success:0 exists:-EEXIST no space:-ENOSPC
+ */
+extern int dcht_hash_set_add(struct dcht_hash_set_s * set,
+                             uint32_t key);
+
+/**
+ * @brief delete key in hash set
+ *
+ * @param set: hash set
+ * @param key: deleting key
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_set_del(struct dcht_hash_set_s * set,
+                             uint32_t key);
+
+/**
+ * @brief search key in hash set
+ *
+ * @param set: hash set
+ * @param key: search key
+ * @return true if found
+ */
+extern bool dcht_hash_set_contains(struct dcht_hash_set_s * set,
+                                   uint32_t key);
+
+/**
+ * @brief search keys in hash set, with bucket prefetch running ahead
+ *
+ * @param set: hash set
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param hits: array to set the results (may be NULL)
+ * @return number of keys found
+ */
+extern unsigned dcht_hash_set_contains_bulk(struct dcht_hash_set_s * set,
+                                            const uint32_t * keys,
+                                            unsigned nb,
+                                            bool * hits);
+
+/**
+ * @brief verify hash set
+ *
+ * @param set: hash set
+ * @return success:0 failed:negative
+ */
+extern int dcht_hash_set_verify(struct dcht_hash_set_s * set);
+
+#endif	/* !_DC_HASH_SET_H_ */
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo hash table of byte string keys
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) support add, del, find API
+ * (4) a multimap of signature to arena references, the key bytes decide
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "dc_hash_str.h"
+#include "dc_hash_priv.h"
+
+#define STR_REC_UNIT	32	/* reference unit and smallest record */
+#define STR_CAND_MAX	8	/* signature matches compared by a reader */
+#define STR_RETRY_MAX	5
+
+/******************************************************************
+ * key arena (writer thread)
+ ******************************************************************/
+always_inline struct dcht_str_rec_s *
+str_rec (const struct dcht_hash_str_s * st,
+         uint32_t ref)
+{
+        return (struct dcht_str_rec_s *) &st->arena[(size_t) ref * STR_REC_UNIT];
+}
+
+always_inline unsigned
+str_class (size_t len)
+{
+        size_t size = sizeof(struct dcht_str_rec_s) + len;
+        unsigned c = 0;
+
+        while ((size_t) (STR_REC_UNIT << c) < size)
+                c += 1;
+        return c;
+}
+
+/**
+ * @brief take a record of the size class, a recycled one first
+ *
+ * @param st: string key table
+ * @param c: size class
+ * @return reference of the record, zero if the arena is full
+ */
+always_inline uint32_t
+str_rec_alloc (struct dcht_hash_str_s * st,
+               unsigned c)
+{
+        size_t size = STR_REC_UNIT << c;
+        size_t align = size < DCHT_CACHELINE_SIZE ? size : DCHT_CACHELINE_SIZE;
+        size_t off;
+        uint32_t ref = st->free[c];
+
+        if (ref) {
+                st->free[c] = str_rec(st, ref)->next;
+                return ref;
+        }
+
+        /* records up to a cacheline never cross one */
+        off = (st->arena_used + align - 1) & ~(align - 1);
+        if (off + size > st->arena_size)
+                return 0;
+        st->arena_used = off + size;
+
+        ref = off / STR_REC_UNIT;
+        /* a new record is free until published */
+        str_rec(st, ref)->seq = 1;
+        return ref;
+}
+
+/*
+ * the seq stays odd on the free list, readers holding the reference fail
+ */
+always_inline void
+str_rec_free (struct dcht_hash_str_s * st,
+              uint32_t ref)
+{
+        struct dcht_str_rec_s * rec = str_rec(st, ref);
+        unsigned c = str_class(rec->len);
+
+        atomic_store_explicit(&rec->seq, rec->seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        rec->next = st->free[c];
+        st->free[c] = ref;
+}
+
+/******************************************************************
+ * signature
+ ******************************************************************/
+always_inline uint64_t
+str_mix (uint64_t h,
+         uint64_t v)
+{
+        h ^= v * 0x9e3779b97f4a7c15ull;
+        h = (h << 31) | (h >> 33);
+        return h * 0xff51afd7ed558ccdull;
+}
+
+/*
+ * multiply based, the same on every CPU
+ */
+always_inline uint32_t
+str_sig (const void * key,
+         size_t len)
+{
+        const uint8_t * p = key;
+        uint64_t h = len;
+        uint64_t v;
+
+        for (; len >= sizeof(v); len -= sizeof(v), p += sizeof(v)) {
+                memcpy(&v, p, sizeof(v));
+                h = str_mix(h, v);
+        }
+        if (len) {
+                v = 0;
+                memcpy(&v, p, len);
+                h = str_mix(h, v);
+        }
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+
+        /* zero is the sentinel */
+        return (uint32_t) h ? (uint32_t) h : 1;
+}
+
+/******************************************************************
+ * string key table API
+ ******************************************************************/
+struct dcht_hash_str_s *
+dcht_hash_str_create (unsigned max_entries,
+                      size_t arena_size)
+{
+        struct dcht_hash_str_s * st = calloc(1, sizeof(*st));
+
+        if (!st)
+                return NULL;
+
+        /* reference zero is the end of a free list */
+        if (arena_size / STR_REC_UNIT > UINT32_MAX || arena_size <= DCHT_CACHELINE_SIZE)
+                goto err;
+
+        st->tbl = dcht_hash_table_create_flags(max_entries, DCHT_FLAG_MULTI);
+        st->arena = aligned_alloc(DCHT_CACHELINE_SIZE,
+                                  (arena_size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1));
+        if (!st->tbl || !st->arena)
+                goto err;
+
+        st->arena_size = arena_size;
+        st->arena_used = DCHT_CACHELINE_SIZE;
+
+        TRACER("st:%p max:%u arena:%zu\n", st, max_entries, arena_size);
+        return st;
+ err:
+        dcht_hash_str_destroy(st);
+        return NULL;
+}
+
+void
+dcht_hash_str_destroy (struct dcht_hash_str_s * st)
+{
+        if (st) {
+                free(st->tbl);
+                free(st->arena);
+                free(st);
+        }
+}
+
+/**
+ * @brief find the record of key (writer thread)
+ *
+ * @param st: string key table
+ * @param sig: signature of key
+ * @param key: key bytes
+ * @param len: key length
+ * @return reference of the record, zero if not found
+ */
+always_inline uint32_t
+str_lookup (struct dcht_hash_str_s * st,
+            uint32_t sig,
+            const void * key,
+            size_t len)
+{
+        uint32_t refs[STR_CAND_MAX];
+        unsigned nb = dcht_hash_multi_find(st->tbl, sig, refs, STR_CAND_MAX);
+
+        if (nb > STR_CAND_MAX)
+                nb = STR_CAND_MAX;
+        for (unsigned i = 0; i < nb; i++) {
+                const struct dcht_str_rec_s * rec = str_rec(st, refs[i]);
+
+                if (rec->len == len && !memcmp(rec->bytes, key, len))
+                        return refs[i];
+        }
+        return 0;
+}
+
+int
+dcht_hash_str_add (struct dcht_hash_str_s * st,
+                   const void * key,
+                   size_t len,
+                   uint32_t val,
+                   bool skip_update)
+{
+        struct dcht_str_rec_s * rec;
+        uint32_t sig, ref;
+        int ret;
+
+        if (!len || len > DCHT_STR_KEY_MAX)
+                return -EINVAL;
+
+        sig = str_sig(key, len);
+        ref = str_lookup(st, sig, key, len);
+        if (ref) {
+                if (!skip_update)
+                        return -EEXIST;
+
+                atomic_store_explicit(&str_rec(st, ref)->val, val, memory_order_relaxed);
+                return 0;
+        }
+
+        ref = str_rec_alloc(st, str_class(len));
+        if (!ref)
+                return -ENOSPC;
+
+        rec = str_rec(st, ref);
+        rec->val = val;
+        rec->len = len;
+        memcpy(rec->bytes, key, len);
+        /* published before the reference */
+        atomic_store_explicit(&rec->seq, rec->seq + 1, memory_order_release);
+
+        ret = dcht_hash_multi_add(st->tbl, sig, ref);
+        if (ret) {
+                str_rec_free(st, ref);
+                return ret;
+        }
+        st->current_entries += 1;
+
+        TRACER("add sig:%08x ref:%u len:%zu val:%u\n", sig, ref, len, val);
+        return 0;
+}
+
+int
+dcht_hash_str_find (struct dcht_hash_str_s * st,
+                    const void * key,
+                    size_t len,
+                    uint32_t * val_p)
+{
+        uint32_t sig = str_sig(key, len);
+        uint32_t refs[STR_CAND_MAX];
+
+        for (int loop = 0; loop < STR_RETRY_MAX; loop++) {
+                unsigned nb = dcht_hash_multi_find(st->tbl, sig, refs, STR_CAND_MAX);
+                bool stale = false;
+
+                if (nb > STR_CAND_MAX)
+                        nb = STR_CAND_MAX;
+                /* the records are fetched while the first one is compared */
+                for (unsigned i = 0; i < nb; i++)
+                        prefetch(str_rec(st, refs[i]));
+
+                for (unsigned i = 0; i < nb; i++) {
+                        const struct dcht_str_rec_s * rec = str_rec(st, refs[i]);
+                        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+                        uint32_t val;
+                        bool hit;
+
+                        if (seq & 1) {
+                                stale = true;
+                                continue;
+                        }
+
+                        hit = rec->len == len && !memcmp(rec->bytes, key, len);
+                        val = atomic_load_explicit(&rec->val, memory_order_relaxed);
+
+                        /* the record was recycled while comparing */
+                        atomic_thread_fence(memory_order_acquire);
+                        if (atomic_load_explicit(&rec->seq, memory_order_relaxed) != seq) {
+                                stale = true;
+                                continue;
+                        }
+                        if (hit) {
+                                *val_p = val;
+                                return 0;
+                        }
+                }
+                if (!stale)
+                        break;
+        }
+        return -ENOENT;
+}
+
+int
+dcht_hash_str_del (struct dcht_hash_str_s * st,
+                   const void * key,
+                   size_t len)
+{
+        uint32_t sig, ref;
+
+        if (!len || len > DCHT_STR_KEY_MAX)
+                return -ENOENT;
+
+        sig = str_sig(key, len);
+        ref = str_lookup(st, sig, key, len);
+        if (!ref)
+                return -ENOENT;
+
+        /* readers do not find the reference anymore, then it is recycled */
+        dcht_hash_multi_del(st->tbl, sig, ref);
+        str_rec_free(st, ref);
+
+        assert(st->current_entries > 0);
+        st->current_entries -= 1;
+
+        TRACER("del sig:%08x ref:%u len:%zu\n", sig, ref, len);
+        return 0;
+}
+
+static int
+str_verify_cb (struct dcht_hash_table_s * tbl,
+               uint32_t sig,
+               uint32_t ref,
+               void * arg)
+{
+        struct dcht_hash_str_s * st = arg;
+        const struct dcht_str_rec_s * rec;
+
+        (void) tbl;
+        if (!ref || ref >= st->arena_used / STR_REC_UNIT) {
+                TRACER("invalid ref:%u sig:%08x\n", ref, sig);
+                return -EINVAL;
+        }
+        rec = str_rec(st, ref);
+        if ((rec->seq & 1) || str_sig(rec->bytes, rec->len) != sig) {
+                TRACER("invalid record ref:%u seq:%u sig:%08x\n", ref, rec->seq, sig);
+                return -EINVAL;
+        }
+        return 0;
+}
+
+int
+dcht_hash_str_verify (struct dcht_hash_str_s * st)
+{
+        int ret = dcht_hash_verify(st->tbl);
+
+        if (!ret)
+                ret = dcht_hash_walk(st->tbl, str_verify_cb, st);
+        if (!ret && st->tbl->current_entries != st->current_entries) {
+                TRACER("mismatched number of entries:%u %u\n",
+                       st->tbl->current_entries, st->current_entries);
+                ret = -1;
+        }
+        return ret;
+}
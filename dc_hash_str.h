@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo hash table of byte string keys
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) buckets hold 32 bit signatures of the keys and references to the key arena
+ * (4) keys of 1 ~ DCHT_STR_KEY_MAX bytes
+ */
+
+#ifndef _DC_HASH_STR_H_
+#define _DC_HASH_STR_H_
+
+#include "dc_hash_tbl.h"
+
+/*
+ * fixed params
+ */
+#define DCHT_STR_KEY_MAX	1024
+#define DCHT_STR_CLASS_NB	7	/* record sizes 32 ~ 2048 bytes */
+
+/*
+ * key record in the arena, 32 byte aligned
+ * the seq is odd while the record is free or being rewritten
+ */
+struct dcht_str_rec_s {
+        uint32_t seq;
+        uint32_t val;
+        uint32_t len;
+        uint32_t next;			/* free list, reference of next record */
+        uint8_t bytes[];
+};
+
+/*
+ * string key table
+ */
+struct dcht_hash_str_s {
+        struct dcht_hash_table_s * tbl;	/* DCHT_FLAG_MULTI, signature to references */
+
+        uint8_t * arena;
+        size_t arena_size;
+        size_t arena_used;		/* bump pointer */
+        uint32_t free[DCHT_STR_CLASS_NB];	/* recycled records per size class */
+
+        unsigned current_entries;
+};
+
+/**
+ * @brief create string key table
+ *
+ * @param max_entries: Maximum number that can be registered
+ * @param arena_size: bytes of the key arena
+ * @return created table pointer
+ */
+extern struct dcht_hash_str_s * dcht_hash_str_create(unsigned max_entries,
+                                                     size_t arena_size);
+
+/**
+ * @brief destroy string key table, no reader may use it anymore
+ *
+ * @param st: string key table
+ * @return void
+ */
+extern void dcht_hash_str_destroy(struct dcht_hash_str_s * st);
+
+/**
+ * @brief add key and value
+ *
+ * @param st: string key table
+ * @param key: key bytes
+ * @param len: key length
+ * @param val: value
+ * @param skip_update: update the value if key exists
+ * @return success:0 exists:-EEXIST no space:-ENOSPC bad length:-EINVAL
+ */
+extern int dcht_hash_str_add(struct dcht_hash_str_s * st,
+                             const void * key,
+                             size_t len,
+                             uint32_t val,
+                             bool skip_update);
+
+/**
+ * @brief search key
+ *
+ * @param st: string key table
+ * @param key: key bytes
+ * @param len: key length
+ * @param val_p: Pointer to set the read value
+ * @return found key:0 not found:negative
+ */
+extern int dcht_hash_str_find(struct dcht_hash_str_s * st,
+                              const void * key,
+                              size_t len,
+                              uint32_t * val_p);
+
+/**
+ * @brief delete key, its record is recycled
+ *
+ * @param st: string key table
+ * @param key: key bytes
+ * @param len: key length
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_str_del(struct dcht_hash_str_s * st,
+                             const void * key,
+                             size_t len);
+
+/**
+ * @brief verify string key table
+ *
+ * @param st: string key table
+ * @return success:0 failed:negative
+ */
+extern int dcht_hash_str_verify(struct dcht_hash_str_s * st);
+
+#endif	/* !_DC_HASH_STR_H_ */
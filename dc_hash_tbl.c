@@ -15,20 +15,15 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dc_hash_tbl.h"
-
-#ifndef always_inline
-# define always_inline	static inline __attribute__ ((__always_inline__))
-#endif	/* !always_inline */
-
-#define ARRAYOF(_a)	(sizeof(_a)/sizeof(_a[0]))
-
-#if defined(ENABLE_HASH_TRACER)
-# define TRACER(fmt,...)	fprintf(stderr, "%s():%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
-#else
-# define TRACER(fmt,...)
-#endif
+#include "dc_hash_priv.h"
 
 #if 1
 #define NOTIFY_CB(_tbl, _bk, _pos, _ev, _exp)                           \
@@ -100,23 +95,31 @@ load_val (const struct dcht_bucket_s * bk,
         return ret;
 }
 
-/**
- * @brief prefetch memory (non temporal)
- *
- * @param memory pointer
- * @return void
+/*
+ * key match and vacancy bitmaps of buckets pair
  */
-always_inline void
-prefetch (const void *p)
-{
-        //        asm volatile ("prefetchnta %[p]" : : [p] "m" (*(const volatile char *)p));
-        __builtin_prefetch(p, 0, 3);	/* non temporal */
-}
+struct bucket_scan_s {
+        unsigned hit[2];	/* slots holding the key */
+        unsigned vacant[2];	/* empty slots */
+};
+
+/*
+ * driver ids
+ */
+enum driver_id_e {
+        DRIVER_ID_GENERIC = 1,
+        DRIVER_ID_AVX2,
+        DRIVER_ID_SSE42,
+        DRIVER_ID_SSE2,
+};
 
 /*
  * handler for each CPU Arch
  */
 struct arch_handler_s {
+        enum driver_id_e id;
+        enum driver_id_e hash_id;			/* recorded in the table header, the drivers of the same hash share it */
+        const char * name;
         uint32_t (*hash32)(uint32_t,uint32_t);		/* 32 bit hash generator */
         void (*bk_init)(struct dcht_bucket_s *);	/* bucket initializer */
         int (*find_key_bk)(const struct dcht_bucket_s *,
@@ -130,35 +133,19 @@ struct arch_handler_s {
         int (*find_val_bk_pair_sync)(struct dcht_bucket_s **,
                                      uint32_t,
                                      uint32_t *);	/* find val in buckets pair sync */
-
+        unsigned (*expired_bk)(const struct dcht_bucket_s *,
+                               const uint32_t *,
+                               uint32_t);		/* expired entries bitmap in a bucket */
+        void (*scan_bk_pair)(struct dcht_bucket_s **,
+                             uint32_t,
+                             struct bucket_scan_s *);	/* key and vacancy bitmaps in buckets pair */
+        unsigned (*match_bk)(const struct dcht_bucket_s *,
+                             uint32_t);			/* key match bitmap in a bucket */
 };
 
 /*****************************************************************************
  * start Generic Arch code--->
  *****************************************************************************/
-/*
- * @brief FNV-1a hash
- */
-always_inline uint32_t
-fnv1a (uint32_t init,
-       uint32_t val)
-{
-        uint32_t value[2];
-        value[0] = init;
-        value[1] = val;
-
-        uint32_t hash = 0x811c9dc5;  // FNV offset basis
-        uint8_t * ptr = (uint8_t *) value;
-        uint32_t prime = 0x01000193; // FNV prime
-
-        for (unsigned i = 0; i < sizeof(value); i++) {
-                hash ^= (uint32_t) ptr[i];
-                hash *= prime;
-        }
-
-        return hash;
-}
-
 /*
  * @brief 32bit byte swap
  */
@@ -319,6 +306,70 @@ find_key_val_in_bucket_pair_sync_GEN (struct dcht_bucket_s ** bk_p,
         return -ENOENT;
 }
 
+/*
+ * bitmap of the entries having a timestamp before deadline
+ */
+always_inline unsigned
+expired_in_bucket_GEN (const struct dcht_bucket_s * bk,
+                       const uint32_t * ts,
+                       uint32_t deadline)
+{
+        unsigned mask = 0;
+
+        for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++) {
+                if (load_key(bk, pos) != DCHT_SENTINEL_KEY &&
+                    (int32_t) (ts[pos] - deadline) < 0)
+                        mask |= 1u << pos;
+        }
+
+        TRACER("deadline:%u mask:%02x\n", deadline, mask);
+        return mask;
+}
+
+/*
+ * key match and vacancy bitmaps in 2 buckets, one pass (async)
+ */
+always_inline void
+scan_bucket_pair_GEN (struct dcht_bucket_s ** bk_p,
+                      uint32_t key,
+                      struct bucket_scan_s * sc)
+{
+        for (int i = 0; i < 2; i++) {
+                sc->hit[i] = 0;
+                sc->vacant[i] = 0;
+
+                for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++) {
+                        uint32_t k = load_key(bk_p[i], pos);
+
+                        if (k == key)
+                                sc->hit[i] |= 1u << pos;
+                        else if (k == DCHT_SENTINEL_KEY)
+                                sc->vacant[i] |= 1u << pos;
+                }
+        }
+
+        TRACER("key:%u hit:%02x %02x vacant:%02x %02x\n",
+               key, sc->hit[0], sc->hit[1], sc->vacant[0], sc->vacant[1]);
+}
+
+/*
+ * key match bitmap in a bucket (async)
+ */
+always_inline unsigned
+match_in_bucket_GEN (const struct dcht_bucket_s * bk,
+                     uint32_t key)
+{
+        unsigned mask = 0;
+
+        for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++) {
+                if (load_key(bk, pos) == key)
+                        mask |= 1u << pos;
+        }
+
+        TRACER("key:%u mask:%02x\n", key, mask);
+        return mask;
+}
+
 /**
  * @brief initialize bucket (unused)
  *
@@ -333,6 +384,9 @@ bucket_init_GEN (struct dcht_bucket_s * bk)
 }
 
 static const struct arch_handler_s generic_handlers = {
+        .id = DRIVER_ID_GENERIC,
+        .hash_id = DRIVER_ID_GENERIC,
+        .name = "generic",
         .hash32 = fnv1a,
         .bk_init = bucket_init_GEN,
         .find_key_bk = find_key_in_bucket_GEN,
@@ -340,22 +394,42 @@ static const struct arch_handler_s generic_handlers = {
         .nb_keys_bk = number_of_keys_in_bucket_GEN,
         .which_one_most_bk = which_one_most_GEN,
         .find_val_bk_pair_sync = find_key_val_in_bucket_pair_sync_GEN,
+        .expired_bk = expired_in_bucket_GEN,
+        .scan_bk_pair = scan_bucket_pair_GEN,
+        .match_bk = match_in_bucket_GEN,
 };
 
 /*****************************************************************************
  * <---end Generic Arch code
  *****************************************************************************/
 
+/*
+ * driver of this process, selected once at load time (see arch_handler_init())
+ */
 static const struct arch_handler_s * arch_handler = &generic_handlers;
 
+/*
+ * the _D forms take the driver, a constant in the per driver entry points
+ */
 #define BSWAP(_v)					__builtin_bswap32((_v))
-#define HASH(_i,_v)					arch_handler->hash32((_i),(_v))
-#define FIND_KEY_IN_BUCKET(_bk,_key)			arch_handler->find_key_bk((_bk),(_key))
-#define FIND_KEY_IN_BUCKET_PAIR(_bk_p,_key,_pos_p)	arch_handler->find_key_bk_pair((_bk_p),(_key),(_pos_p))
+#define HASH_D(_d,_i,_v)				(_d)->hash32((_i),(_v))
+#define FIND_KEY_IN_BUCKET_D(_d,_bk,_key)		(_d)->find_key_bk((_bk),(_key))
+#define FIND_KEY_IN_BUCKET_PAIR_D(_d,_bk_p,_key,_pos_p)	(_d)->find_key_bk_pair((_bk_p),(_key),(_pos_p))
+#define	FIND_VAL_IN_BUCKET_PAIR_SYNC_D(_d,_bk_p,_key,_val_p)	(_d)->find_val_bk_pair_sync((_bk_p),(_key),(_val_p))
+#define	SCAN_BUCKET_PAIR_D(_d,_bk_p,_key,_sc)		(_d)->scan_bk_pair((_bk_p),(_key),(_sc))
+#define	MATCH_IN_BUCKET_D(_d,_bk,_key)			(_d)->match_bk((_bk),(_key))
+#define	EXPIRED_IN_BUCKET_D(_d,_bk,_ts,_dl)		(_d)->expired_bk((_bk),(_ts),(_dl))
+
+#define HASH(_i,_v)					HASH_D(arch_handler,(_i),(_v))
+#define FIND_KEY_IN_BUCKET(_bk,_key)			FIND_KEY_IN_BUCKET_D(arch_handler,(_bk),(_key))
+#define FIND_KEY_IN_BUCKET_PAIR(_bk_p,_key,_pos_p)	FIND_KEY_IN_BUCKET_PAIR_D(arch_handler,(_bk_p),(_key),(_pos_p))
 #define	NB_KEYS_IN_BUCKET(_bk,_key)			arch_handler->nb_keys_bk((_bk),(_key))
 #define WHICH_ONE_MOST(_bk_p,_key,_nb_p)		arch_handler->which_one_most_bk((_bk_p),(_key),(_nb_p))
-#define	FIND_VAL_IN_BUCKET_PAIR_SYNC(_bk_p,_key,_val_p)	arch_handler->find_val_bk_pair_sync((_bk_p),(_key),(_val_p))
+#define	FIND_VAL_IN_BUCKET_PAIR_SYNC(_bk_p,_key,_val_p)	FIND_VAL_IN_BUCKET_PAIR_SYNC_D(arch_handler,(_bk_p),(_key),(_val_p))
 #define	BUCKET_INIT(_bk)				arch_handler->bk_init((_bk))
+#define	EXPIRED_IN_BUCKET(_bk,_ts,_dl)			EXPIRED_IN_BUCKET_D(arch_handler,(_bk),(_ts),(_dl))
+#define	SCAN_BUCKET_PAIR(_bk_p,_key,_sc)		SCAN_BUCKET_PAIR_D(arch_handler,(_bk_p),(_key),(_sc))
+#define	MATCH_IN_BUCKET(_bk,_key)			MATCH_IN_BUCKET_D(arch_handler,(_bk),(_key))
 
 
 #if defined(__x86_64__)
@@ -363,11 +437,310 @@ static const struct arch_handler_s * arch_handler = &generic_handlers;
  * x86_64 depened code start--->
  *****************************************************************************/
 #include <immintrin.h>
-#include <cpuid.h>
+
+/******************************************************************************
+ * SSE2 code, two 128 bit compares per bucket
+ * for the CPUs without AVX2 (SSE2 is in every x86_64)
+ ******************************************************************************/
+/*
+ * bitmap of the keys matching in a bucket
+ */
+always_inline unsigned
+keys_cmp_SSE (const struct dcht_bucket_s * bk,
+              __m128i search_key)
+{
+        __m128i lo = _mm_load_si128((__m128i *) (volatile void *) &bk->key[0]);
+        __m128i hi = _mm_load_si128((__m128i *) (volatile void *) &bk->key[4]);
+        unsigned mask;
+
+        mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(search_key, lo)));
+        mask |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(search_key, hi))) << 4;
+        return mask;
+}
+
+/*
+ *  key find in 1 bucket (async)
+ */
+always_inline int
+find_key_in_bucket_SSE (const struct dcht_bucket_s * bk,
+                        uint32_t key)
+{
+        unsigned mask = keys_cmp_SSE(bk, _mm_set1_epi32(key));
+        int pos = -ENOENT;
+
+        if (mask)
+                pos = __builtin_ctz(mask);
+
+        TRACER("key:%u pos:%d mask:%02x\n", key, pos, mask);
+        return pos;
+}
+
+/*
+ * key find in 2 buckets (async)
+ */
+always_inline int
+find_key_in_bucket_pair_SSE (struct dcht_bucket_s ** bk_p,
+                             uint32_t key,
+                             int * pos_p)
+{
+        __m128i search_key = _mm_set1_epi32(key);
+        unsigned mask[2];
+
+        mask[0] = keys_cmp_SSE(bk_p[0], search_key);
+        mask[1] = keys_cmp_SSE(bk_p[1], search_key);
+
+        for (int i = 0; i < 2; i++) {
+                if (mask[i]) {
+                        *pos_p = __builtin_ctz(mask[i]);
+
+                        TRACER("key:%u bk_p:%d pos:%d mask:%02x\n", key, i, *pos_p, mask[i]);
+                        return i;
+                }
+        }
+        TRACER("key:%u not found\n", key);
+        return -ENOENT;
+}
+
+/*
+ *  number of key in a bucket
+ */
+always_inline unsigned
+number_of_keys_in_bucket_SSE (const struct dcht_bucket_s * bk,
+                              uint32_t key)
+{
+        unsigned nb = __builtin_popcount(keys_cmp_SSE(bk, _mm_set1_epi32(key)));
+
+        TRACER("key:%u nb:%u\n", key, nb);
+        return nb;
+}
+
+/*
+ * Return the one with more key matches (async)
+ */
+always_inline int
+which_one_most_SSE (struct dcht_bucket_s ** bk_p,
+                    uint32_t key,
+                    unsigned * nb_p)
+{
+        __m128i search_key = _mm_set1_epi32(key);
+        int ret;
+
+        nb_p[0] = __builtin_popcount(keys_cmp_SSE(bk_p[0], search_key));
+        nb_p[1] = __builtin_popcount(keys_cmp_SSE(bk_p[1], search_key));
+
+        if (nb_p[0] >= nb_p[1])
+                ret = 0;
+        else
+                ret = 1;
+
+        if (!nb_p[ret])
+                ret = -ENOENT;
+
+        TRACER("key:%u ret:%d n0:%u n1:%u\n", key, ret, nb_p[0], nb_p[1]);
+        return ret;
+}
+
+/*
+ * find, for reader (sync)
+ */
+always_inline int
+find_key_val_in_bucket_pair_sync_SSE (struct dcht_bucket_s ** bk_p,
+                                      uint32_t key,
+                                      uint32_t * val_p)
+{
+        __m128i search_key = _mm_set1_epi32(key);
+        int loop = 5;
+
+ retry:
+        assert(--loop > 0);
+
+        for (int i = 0; i < 2; i++) {
+                unsigned mask = keys_cmp_SSE(bk_p[i], search_key);
+
+                if (mask) {
+                        int pos = __builtin_ctz(mask);
+
+                        if (load_val(bk_p[i], pos, key, val_p))
+                                goto retry;
+
+                        TRACER("key:%u bk_p:%d pos:%d val:%u mask:%02x\n",
+                               key, i, pos, *val_p, mask);
+                        return i;
+                }
+        }
+        TRACER("not found key:%u\n", key);
+        return -ENOENT;
+}
+
+/*
+ * bitmap of the entries having a timestamp before deadline
+ */
+always_inline unsigned
+expired_in_bucket_SSE (const struct dcht_bucket_s * bk,
+                       const uint32_t * ts,
+                       uint32_t deadline)
+{
+        __m128i sentinel = _mm_set1_epi32(DCHT_SENTINEL_KEY);
+        __m128i dl = _mm_set1_epi32(deadline);
+        unsigned mask = 0;
+
+        for (int half = 0; half < 2; half++) {
+                __m128i keys = _mm_load_si128((__m128i *) (volatile void *) &bk->key[half * 4]);
+                __m128i stamps = _mm_load_si128((const __m128i *) &ts[half * 4]);
+                __m128i empty = _mm_cmpeq_epi32(keys, sentinel);
+
+                /* sign bit of (ts - deadline) is set if ts is before deadline */
+                __m128i diff = _mm_sub_epi32(stamps, dl);
+
+                mask |= _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(empty, diff))) << (half * 4);
+        }
+
+        TRACER("deadline:%u mask:%02x\n", deadline, mask);
+        return mask;
+}
+
+/*
+ * key match and vacancy bitmaps in 2 buckets, one pass (async)
+ */
+always_inline void
+scan_bucket_pair_SSE (struct dcht_bucket_s ** bk_p,
+                      uint32_t key,
+                      struct bucket_scan_s * sc)
+{
+        __m128i search_key = _mm_set1_epi32(key);
+        __m128i sentinel = _mm_set1_epi32(DCHT_SENTINEL_KEY);
+
+        for (int i = 0; i < 2; i++) {
+                __m128i lo = _mm_load_si128((__m128i *) (volatile void *) &bk_p[i]->key[0]);
+                __m128i hi = _mm_load_si128((__m128i *) (volatile void *) &bk_p[i]->key[4]);
+
+                sc->hit[i] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(search_key, lo))) |
+                             _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(search_key, hi))) << 4;
+                sc->vacant[i] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(sentinel, lo))) |
+                                _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(sentinel, hi))) << 4;
+        }
+
+        TRACER("key:%u hit:%02x %02x vacant:%02x %02x\n",
+               key, sc->hit[0], sc->hit[1], sc->vacant[0], sc->vacant[1]);
+}
+
+/*
+ * key match bitmap in a bucket (async)
+ */
+always_inline unsigned
+match_in_bucket_SSE (const struct dcht_bucket_s * bk,
+                     uint32_t key)
+{
+        unsigned mask = keys_cmp_SSE(bk, _mm_set1_epi32(key));
+
+        TRACER("key:%u mask:%02x\n", key, mask);
+        return mask;
+}
+
+/**
+ * @brief initialize bucket (unused)
+ *
+ * @param bk: bucket
+ * @return void
+ */
+always_inline void
+bucket_init_SSE (struct dcht_bucket_s * bk)
+{
+        __m128i sentinel = _mm_set1_epi32(DCHT_SENTINEL_KEY);
+
+        _mm_store_si128((__m128i *) (volatile void *) &bk->key[0], sentinel);
+        _mm_store_si128((__m128i *) (volatile void *) &bk->key[4], sentinel);
+        __sync_synchronize();
+}
+
+/**
+ * @brief multiply based hash, for the CPUs without crc32c
+ *
+ * @param initial value
+ * @param target value
+ * @return 32 bit hash, every bit depends on both inputs
+ */
+always_inline uint32_t
+mul32 (uint32_t init,
+       uint32_t val)
+{
+        uint64_t h = ((uint64_t) init << 32) | val;
+
+        /* murmur3 finalizer */
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return (uint32_t) h;
+}
+
+static const struct arch_handler_s x86_sse2_handlers = {
+        .id                    = DRIVER_ID_SSE2,
+        .hash_id               = DRIVER_ID_SSE2,
+        .name                  = "X86_64 SSE2",
+        .hash32                = mul32,
+        .bk_init               = bucket_init_SSE,
+        .find_key_bk           = find_key_in_bucket_SSE,
+        .find_key_bk_pair      = find_key_in_bucket_pair_SSE,
+        .nb_keys_bk            = number_of_keys_in_bucket_SSE,
+        .which_one_most_bk     = which_one_most_SSE,
+        .find_val_bk_pair_sync = find_key_val_in_bucket_pair_sync_SSE,
+        .expired_bk            = expired_in_bucket_SSE,
+        .scan_bk_pair          = scan_bucket_pair_SSE,
+        .match_bk              = match_in_bucket_SSE,
+};
+
+/******************************************************************************
+ * SSE4.2 code, the SSE2 compares with crc32c
+ * the same key to bucket mapping as the AVX2 driver
+ ******************************************************************************/
+#define	SSE42_TARGET	"popcnt,sse4.2"
+
+#pragma GCC push_options
+#pragma GCC target("popcnt,sse4.2")	/* SSE42_TARGET */
+
+/**
+ * @brief crc32c calc
+ *
+ * @param initial value
+ * @param target value
+ * @return crc32c
+ */
+always_inline uint32_t
+crc32c32 (uint32_t init,
+          uint32_t val)
+{
+        return _mm_crc32_u32(init, val);
+}
+
+static const struct arch_handler_s x86_sse42_handlers = {
+        .id                    = DRIVER_ID_SSE42,
+        .hash_id               = DRIVER_ID_AVX2,
+        .name                  = "X86_64 SSE4.2",
+        .hash32                = crc32c32,
+        .bk_init               = bucket_init_SSE,
+        .find_key_bk           = find_key_in_bucket_SSE,
+        .find_key_bk_pair      = find_key_in_bucket_pair_SSE,
+        .nb_keys_bk            = number_of_keys_in_bucket_SSE,
+        .which_one_most_bk     = which_one_most_SSE,
+        .find_val_bk_pair_sync = find_key_val_in_bucket_pair_sync_SSE,
+        .expired_bk            = expired_in_bucket_SSE,
+        .scan_bk_pair          = scan_bucket_pair_SSE,
+        .match_bk              = match_in_bucket_SSE,
+};
+
+#pragma GCC pop_options
 
 /******************************************************************************
  * AVX2 code
+ * the rest of the library is built for the baseline ISA
  ******************************************************************************/
+#define	AVX2_TARGET	"avx2,bmi,popcnt,sse4.2"
+
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,popcnt,sse4.2")	/* AVX2_TARGET */
+
 #define	KEY32_MASK	0x81818181
 
 /*
@@ -563,35 +936,80 @@ find_key_val_in_bucket_pair_sync_AVX2 (struct dcht_bucket_s ** bk_p,
         return -ENOENT;
 }
 
-/**
- * @brief initialize bucket (unused)
- *
- * @param bk: bucket
- * @return void
+/*
+ * bitmap of the entries having a timestamp before deadline
  */
-always_inline void
-bucket_init_AVX2 (struct dcht_bucket_s * bk)
+always_inline unsigned
+expired_in_bucket_AVX2 (const struct dcht_bucket_s * bk,
+                        const uint32_t * ts,
+                        uint32_t deadline)
 {
-        __m256i search_key = _mm256_set1_epi32(DCHT_SENTINEL_KEY);
-        _mm256_store_si256((__m256i *) (volatile void *) bk->key, search_key);
-        __sync_synchronize();
+        __m256i keys = _mm256_load_si256((__m256i *) (volatile void *) bk->key);
+        __m256i stamps = _mm256_load_si256((const __m256i *) ts);
+        __m256i empty = _mm256_cmpeq_epi32(keys, _mm256_set1_epi32(DCHT_SENTINEL_KEY));
+
+        /* sign bit of (ts - deadline) is set if ts is before deadline */
+        __m256i diff = _mm256_sub_epi32(stamps, _mm256_set1_epi32(deadline));
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(empty, diff)));
+
+        TRACER("deadline:%u mask:%02x\n", deadline, mask);
+        return mask;
 }
 
-/**
- * @brief crc32c calc
+/*
+ * key match and vacancy bitmaps in 2 buckets, one pass (async)
+ */
+always_inline void
+scan_bucket_pair_AVX2 (struct dcht_bucket_s ** bk_p,
+                       uint32_t key,
+                       struct bucket_scan_s * sc)
+{
+        __m256i search_key = _mm256_set1_epi32(key);
+        __m256i sentinel = _mm256_set1_epi32(DCHT_SENTINEL_KEY);
+
+        for (int i = 0; i < 2; i++) {
+                __m256i keys = _mm256_load_si256((__m256i *) (volatile void *) bk_p[i]->key);
+
+                sc->hit[i] = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(search_key, keys)));
+                sc->vacant[i] = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(sentinel, keys)));
+        }
+
+        TRACER("key:%u hit:%02x %02x vacant:%02x %02x\n",
+               key, sc->hit[0], sc->hit[1], sc->vacant[0], sc->vacant[1]);
+}
+
+/*
+ * key match bitmap in a bucket (async)
+ */
+always_inline unsigned
+match_in_bucket_AVX2 (const struct dcht_bucket_s * bk,
+                      uint32_t key)
+{
+        __m256i keys = _mm256_load_si256((__m256i *) (volatile void *) bk->key);
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_set1_epi32(key), keys)));
+
+        TRACER("key:%u mask:%02x\n", key, mask);
+        return mask;
+}
+
+/**
+ * @brief initialize bucket (unused)
  *
- * @param initial value
- * @param target value
- * @return crc32c
+ * @param bk: bucket
+ * @return void
  */
-always_inline uint32_t
-crc32c32 (uint32_t init,
-          uint32_t val)
+always_inline void
+bucket_init_AVX2 (struct dcht_bucket_s * bk)
 {
-        return _mm_crc32_u32(init, val);
+        __m256i search_key = _mm256_set1_epi32(DCHT_SENTINEL_KEY);
+        _mm256_store_si256((__m256i *) (volatile void *) bk->key, search_key);
+        __sync_synchronize();
 }
 
 static const struct arch_handler_s x86_avx2_handlers = {
+        .id                    = DRIVER_ID_AVX2,
+        .hash_id               = DRIVER_ID_AVX2,
+        .name                  = "X86_64 AVX2",
         .hash32                = crc32c32,
         .bk_init               = bucket_init_AVX2,
         .find_key_bk           = find_key_in_bucket_AVX2,
@@ -599,44 +1017,35 @@ static const struct arch_handler_s x86_avx2_handlers = {
         .nb_keys_bk            = number_of_keys_in_bucket_AVX2,
         .which_one_most_bk     = which_one_most_AVX2,
         .find_val_bk_pair_sync = find_key_val_in_bucket_pair_sync_AVX2,
+        .expired_bk            = expired_in_bucket_AVX2,
+        .scan_bk_pair          = scan_bucket_pair_AVX2,
+        .match_bk              = match_in_bucket_AVX2,
 };
 
+#pragma GCC pop_options
+
 /*
- * check cpuid AVX2,BMI,SSE4_2(crc32c)
+ * the widest driver of the ISA level: AVX2, SSE4.2, then SSE2, the x86_64 baseline
+ * called by the ifunc resolvers before relocation, no library call here
  */
-const struct arch_handler_s *
- __attribute__((weak)) x86_handler_get (void)
+static const struct arch_handler_s *
+x86_handler_get (void)
 {
-        const struct arch_handler_s * handler = arch_handler;
-
+        const struct arch_handler_s * handler = &generic_handlers;
+        enum x86_isa_e isa = x86_isa_probe();
+
+#ifndef	DISABLE_SSE2_DRIVER
+        handler = &x86_sse2_handlers;
+#endif	/* !DISABLE_SSE2_DRIVER */
+#ifndef	DISABLE_SSE42_DRIVER
+        if (isa >= X86_ISA_SSE42)
+                handler = &x86_sse42_handlers;
+#endif	/* !DISABLE_SSE42_DRIVER */
 #ifndef	DISABLE_AVX2_DRIVER
-        uint32_t eax = 0, ebx, ecx, edx;
-
-        // Get the highest function parameter.
-        __get_cpuid(0, &eax, &ebx, &ecx, &edx);
-
-        // Check if the function parameter for extended features is available.
-        if (eax >= 7) {
-                __cpuid_count(1, 0, eax, ebx, ecx, edx);
-                if (!(ecx & bit_SSE4_2))
-                        goto end;
-
-                __cpuid_count(7, 0, eax, ebx, ecx, edx);
-                if (!(ebx & bit_AVX2))
-                        goto end;
-                if (!(ebx & bit_BMI))
-                        goto end;
-
-                /* All Ok */
-                TRACER("use X86_64 AVX2 cuckoo hash driver\n");
+        if (isa >= X86_ISA_AVX2)
                 handler = &x86_avx2_handlers;
-        } else {
- end:
-                TRACER("use generic cuckoo hash driver\n");
-        }
-#else	/* !DISABLE_AVX2_DRIVER */
-        (void) &x86_avx2_handlers;
-#endif	/* DISABLE_AVX2_DRIVER */
+#endif	/* !DISABLE_AVX2_DRIVER */
+        (void) isa;
         return handler;
 }
 
@@ -646,6 +1055,384 @@ const struct arch_handler_s *
 #endif	/* __x86_64__ */
 
 
+/*
+ * per bucket timestamps (DCHT_FLAG_TTL)
+ */
+struct bucket_ts_s {
+        uint32_t ts[DCHT_BUCKET_ENTRY_SZ];
+} __attribute__ ((aligned(DCHT_BUCKET_ENTRY_SZ * sizeof(uint32_t))));
+
+#define DCHT_FLAG_ALL	(DCHT_FLAG_TTL | DCHT_FLAG_TTL_REFRESH |		\
+                         DCHT_FLAG_CACHE | DCHT_FLAG_CACHE_EVICT_ALWAYS |	\
+                         DCHT_FLAG_ATOMIC_VAL | DCHT_FLAG_OVERFLOW_HINT |	\
+                         DCHT_FLAG_HOTNESS | DCHT_FLAG_FRONT_GEN | DCHT_FLAG_MULTI |	\
+                         DCHT_FLAG_KEY64 | DCHT_FLAG_KEY128 | DCHT_FLAG_VALS_MASK)
+
+/*
+ * the per bucket areas do not cover overflow buckets,
+ * and a front cache holds one value per key
+ */
+#define DCHT_FLAG_NOT_MULTI	(DCHT_FLAG_TTL | DCHT_FLAG_CACHE | DCHT_FLAG_ATOMIC_VAL |	\
+                                 DCHT_FLAG_OVERFLOW_HINT | DCHT_FLAG_HOTNESS | DCHT_FLAG_FRONT_GEN)
+
+/*
+ * the 32 bit key API of these would work on the tags of wide keys
+ */
+#define DCHT_FLAG_WIDE		(DCHT_FLAG_KEY64 | DCHT_FLAG_KEY128)
+#define DCHT_FLAG_NOT_WIDE	(DCHT_FLAG_CACHE | DCHT_FLAG_ATOMIC_VAL | DCHT_FLAG_FRONT_GEN |	\
+                                 DCHT_FLAG_MULTI)
+
+/*
+ * these take the value out of a slot without releasing its record,
+ * or keep a value beyond the life of its record
+ */
+#define DCHT_FLAG_NOT_VALS	(DCHT_FLAG_TTL | DCHT_FLAG_CACHE | DCHT_FLAG_ATOMIC_VAL |	\
+                                 DCHT_FLAG_FRONT_GEN | DCHT_FLAG_MULTI | DCHT_FLAG_WIDE)
+
+/*
+ * the 32 bit value API would store raw values where these keep references,
+ * or bare tags without their full keys
+ */
+#define DCHT_FLAG_NOT_VAL32	(DCHT_FLAG_VALS_MASK | DCHT_FLAG_WIDE)
+
+/* a single value add would replace or hide the other values of a multimap key */
+#define DCHT_FLAG_NOT_ADD32	(DCHT_FLAG_NOT_VAL32 | DCHT_FLAG_MULTI)
+
+/* flags the readers update entries on hit */
+#define DCHT_FLAG_TOUCH	(DCHT_FLAG_TTL_REFRESH | DCHT_FLAG_CACHE | DCHT_FLAG_HOTNESS)
+
+always_inline uint32_t *
+bucket_ts (const struct dcht_hash_table_s * tbl,
+           const struct dcht_bucket_s * bk)
+{
+        struct bucket_ts_s * ts = (struct bucket_ts_s *) ((uintptr_t) tbl + tbl->ts_offset);
+
+        return ts[bk - tbl->buckets].ts;
+}
+
+/*
+ * per bucket reference bits, bit#n is entry#n (DCHT_FLAG_CACHE)
+ */
+always_inline uint8_t *
+bucket_ref (const struct dcht_hash_table_s * tbl,
+            const struct dcht_bucket_s * bk)
+{
+        uint8_t * ref = (uint8_t *) ((uintptr_t) tbl + tbl->ref_offset);
+
+        return &ref[bk - tbl->buckets];
+}
+
+always_inline void
+ref_set (uint8_t * ref,
+         int pos)
+{
+        atomic_fetch_or_explicit(ref, (uint8_t) (1u << pos), memory_order_relaxed);
+}
+
+always_inline void
+ref_clear (uint8_t * ref,
+           int pos)
+{
+        atomic_fetch_and_explicit(ref, (uint8_t) ~(1u << pos), memory_order_relaxed);
+}
+
+/*
+ * per entry sampled access counters (DCHT_FLAG_HOTNESS)
+ */
+#define HEAT_SAMPLE	16	/* one in HEAT_SAMPLE hits is counted, power of 2 */
+
+struct bucket_heat_s {
+        uint8_t heat[DCHT_BUCKET_ENTRY_SZ];
+};
+
+static __thread uint32_t heat_rand = 0x9e3779b9;
+
+/*
+ * xorshift, a plain counter would sample the same keys of a periodic access pattern
+ */
+always_inline bool
+heat_sampled (void)
+{
+        uint32_t x = heat_rand;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        heat_rand = x;
+        return !(x & (HEAT_SAMPLE - 1));
+}
+
+always_inline uint8_t *
+bucket_heat (const struct dcht_hash_table_s * tbl,
+             const struct dcht_bucket_s * bk)
+{
+        struct bucket_heat_s * heat = (struct bucket_heat_s *) ((uintptr_t) tbl + tbl->heat_offset);
+
+        return heat[bk - tbl->buckets].heat;
+}
+
+/*
+ * striped generation numbers for front caches (DCHT_FLAG_FRONT_GEN)
+ * bumped after the value of a key of the stripe changed or the key was deleted
+ */
+#define GEN_STRIPES	4096	/* power of 2 */
+
+always_inline uint32_t
+front_hash (uint32_t key)
+{
+        return key * 0x9e3779b1u;	/* golden ratio */
+}
+
+always_inline uint32_t *
+key_gen (const struct dcht_hash_table_s * tbl,
+         uint32_t key)
+{
+        uint32_t * gen = (uint32_t *) ((uintptr_t) tbl + tbl->gen_offset);
+
+        return &gen[(front_hash(key) >> 20) & (GEN_STRIPES - 1)];
+}
+
+always_inline void
+gen_bump (struct dcht_hash_table_s * tbl,
+          uint32_t key)
+{
+        if (tbl->flags & DCHT_FLAG_FRONT_GEN)
+                atomic_fetch_add_explicit(key_gen(tbl, key), 1, memory_order_release);
+}
+
+/*
+ * overflow chains (DCHT_FLAG_MULTI)
+ * overflow buckets are linked behind the primary bucket of their keys.
+ * they stay linked until dcht_hash_clean(), a reader never sees one reused.
+ */
+#define OVF_RATIO	8	/* one overflow bucket per OVF_RATIO buckets */
+
+always_inline struct dcht_bucket_s *
+ovf_buckets (const struct dcht_hash_table_s * tbl)
+{
+        return (struct dcht_bucket_s *) ((uintptr_t) tbl + tbl->ovf_offset);
+}
+
+always_inline uint32_t *
+bucket_link (const struct dcht_hash_table_s * tbl,
+             const struct dcht_bucket_s * bk)
+{
+        uint32_t * link = (uint32_t *) ((uintptr_t) tbl + tbl->link_offset);
+        const struct dcht_bucket_s * ovf = ovf_buckets(tbl);
+
+        /* the overflow buckets are behind the buckets */
+        if (bk >= ovf)
+                return &link[tbl->nb_buckets + (bk - ovf)];
+        return &link[bk - tbl->buckets];
+}
+
+always_inline struct dcht_bucket_s *
+ovf_next (const struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * bk)
+{
+        uint32_t next = atomic_load_explicit(bucket_link(tbl, bk), memory_order_acquire);
+
+        return next ? &ovf_buckets(tbl)[next - 1] : NULL;
+}
+
+/*
+ * full keys of the wide key tables (DCHT_FLAG_KEY64, DCHT_FLAG_KEY128)
+ * entry#n of bucket#m at [(m * DCHT_BUCKET_ENTRY_SZ + n) * words], a 128 bit
+ * key never crosses a cacheline
+ */
+always_inline unsigned
+wkey_words (const struct dcht_hash_table_s * tbl)
+{
+        return (tbl->flags & DCHT_FLAG_KEY128) ? 2 : 1;
+}
+
+always_inline uint64_t *
+bucket_wkey (const struct dcht_hash_table_s * tbl,
+             const struct dcht_bucket_s * bk,
+             int pos)
+{
+        uint64_t * wkey = (uint64_t *) ((uintptr_t) tbl + tbl->wkey_offset);
+        unsigned words = wkey_words(tbl);
+
+        return &wkey[((bk - tbl->buckets) * DCHT_BUCKET_ENTRY_SZ + pos) * words];
+}
+
+/*
+ * value store (DCHT_FLAG_VALS)
+ * a record is a header and the value, in the same cacheline up to 64 bytes.
+ * free records are in a ring, oldest retired first. REC_SLACK_RATIO more
+ * records than slots, a retired record waits for that many at least.
+ */
+#define REC_SLACK_RATIO	8
+#define REC_RETRY_MAX	5
+
+struct rec_meta_s {
+        uint32_t seq;		/* odd while free or being written */
+        uint32_t key;
+};
+
+/*
+ * header and value, power of 2
+ */
+always_inline unsigned
+rec_stride_flags (unsigned flags)
+{
+        unsigned n = (flags & DCHT_FLAG_VALS_MASK) >> DCHT_FLAG_VALS_SHIFT;
+
+        return n ? 8u << n : 0;
+}
+
+always_inline struct rec_meta_s *
+rec_meta (const struct dcht_hash_table_s * tbl,
+          uint32_t idx)
+{
+        size_t stride = sizeof(struct rec_meta_s) + tbl->rec_size;
+
+        return (struct rec_meta_s *) ((uintptr_t) tbl + tbl->rec_offset + idx * stride);
+}
+
+always_inline void *
+rec_ptr (const struct dcht_hash_table_s * tbl,
+         uint32_t idx)
+{
+        return rec_meta(tbl, idx) + 1;
+}
+
+always_inline uint32_t *
+rec_ring (const struct dcht_hash_table_s * tbl)
+{
+        return (uint32_t *) ((uintptr_t) tbl + tbl->rec_ring_offset);
+}
+
+/*
+ * writer thread
+ * head and tail wrap at nb_recs, which is not a power of 2
+ */
+always_inline unsigned
+rec_ring_next (const struct dcht_hash_table_s * tbl,
+               unsigned i)
+{
+        return ++i == tbl->nb_recs ? 0 : i;
+}
+
+always_inline uint32_t
+rec_alloc (struct dcht_hash_table_s * tbl)
+{
+        uint32_t idx;
+
+        assert(tbl->rec_free > 0);
+        idx = rec_ring(tbl)[tbl->rec_head];
+        tbl->rec_head = rec_ring_next(tbl, tbl->rec_head);
+        tbl->rec_free -= 1;
+        return idx;
+}
+
+always_inline void
+rec_publish (struct dcht_hash_table_s * tbl,
+             uint32_t idx,
+             uint32_t key,
+             const void * rec,
+             size_t len)
+{
+        struct rec_meta_s * meta = rec_meta(tbl, idx);
+
+        memcpy(rec_ptr(tbl, idx), rec, len);
+        atomic_store_explicit(&meta->key, key, memory_order_relaxed);
+        atomic_store_explicit(&meta->seq, meta->seq + 1, memory_order_release);
+}
+
+always_inline void
+rec_retire (struct dcht_hash_table_s * tbl,
+            uint32_t idx)
+{
+        struct rec_meta_s * meta = rec_meta(tbl, idx);
+
+        /* readers holding the record see the change before it is rewritten */
+        atomic_store_explicit(&meta->seq, meta->seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        rec_ring(tbl)[tbl->rec_tail] = idx;
+        tbl->rec_tail = rec_ring_next(tbl, tbl->rec_tail);
+        tbl->rec_free += 1;
+}
+
+/*
+ * overflow hint (DCHT_FLAG_OVERFLOW_HINT)
+ * number of keys having this bucket as primary and placed in their secondary,
+ * sticky once saturated. the writer counts up before placing a key in its
+ * secondary and down after taking it out, so a reader missing in the primary
+ * with a zero hint may skip the secondary.
+ */
+#define HINT_SATURATED	UINT8_MAX
+
+always_inline uint8_t *
+bucket_hint (const struct dcht_hash_table_s * tbl,
+             const struct dcht_bucket_s * bk)
+{
+        uint8_t * hint = (uint8_t *) ((uintptr_t) tbl + tbl->hint_offset);
+
+        return &hint[bk - tbl->buckets];
+}
+
+always_inline void
+hint_inc (struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * primary)
+{
+        uint8_t * hint = bucket_hint(tbl, primary);
+
+        if (*hint != HINT_SATURATED)
+                atomic_store_explicit(hint, *hint + 1, memory_order_release);
+}
+
+always_inline void
+hint_dec (struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * primary)
+{
+        uint8_t * hint = bucket_hint(tbl, primary);
+
+        assert(*hint);
+        if (*hint != HINT_SATURATED)
+                atomic_store_explicit(hint, *hint - 1, memory_order_release);
+}
+
+/*
+ * per bucket lock (DCHT_FLAG_ATOMIC_VAL)
+ * value operation threads hold it while working on an entry of the bucket,
+ * the writer holds it while taking an entry out of the bucket.
+ */
+always_inline void
+cpu_relax (void)
+{
+#if defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif	/* __x86_64__ */
+}
+
+always_inline void
+bucket_lock (const struct dcht_hash_table_s * tbl,
+             const struct dcht_bucket_s * bk)
+{
+        if (tbl->flags & DCHT_FLAG_ATOMIC_VAL) {
+                uint8_t * lock = (uint8_t *) ((uintptr_t) tbl + tbl->lock_offset);
+
+                lock += bk - tbl->buckets;
+                while (atomic_exchange_explicit(lock, 1, memory_order_acquire)) {
+                        while (atomic_load_explicit(lock, memory_order_relaxed))
+                                cpu_relax();
+                }
+        }
+}
+
+always_inline void
+bucket_unlock (const struct dcht_hash_table_s * tbl,
+               const struct dcht_bucket_s * bk)
+{
+        if (tbl->flags & DCHT_FLAG_ATOMIC_VAL) {
+                uint8_t * lock = (uint8_t *) ((uintptr_t) tbl + tbl->lock_offset);
+
+                atomic_store_explicit(&lock[bk - tbl->buckets], 0, memory_order_release);
+        }
+}
+
 /**
  * @brief find vacancy position
  *
@@ -708,101 +1495,204 @@ del_key (struct dcht_bucket_s * bk,
  * @param dpos: destination entry position in dbk
  * @param sbk: source bucket
  * @param spos: source entry position in sbk
+ * @param primary: primary bucket of the moved key
  * @return void
  */
 always_inline void
-move_entry (struct dcht_bucket_s * dbk,
+move_entry (struct dcht_hash_table_s * tbl,
+            struct dcht_bucket_s * dbk,
             int dpos,
             struct dcht_bucket_s * sbk,
-            int spos)
+            int spos,
+            const struct dcht_bucket_s * primary)
 {
+        bool hint = tbl->flags & DCHT_FLAG_OVERFLOW_HINT;
+
+        if (hint && dbk != primary)
+                hint_inc(tbl, primary);
+
+        bucket_lock(tbl, sbk);
+
         uint32_t key = sbk->key[spos];
         uint32_t val = sbk->val[spos];
 
+        if (tbl->flags & DCHT_FLAG_TTL)
+                bucket_ts(tbl, dbk)[dpos] = bucket_ts(tbl, sbk)[spos];
+        if (tbl->flags & DCHT_FLAG_CACHE) {
+                if (*bucket_ref(tbl, sbk) & (1u << spos))
+                        ref_set(bucket_ref(tbl, dbk), dpos);
+                else
+                        ref_clear(bucket_ref(tbl, dbk), dpos);
+        }
+        if (tbl->flags & DCHT_FLAG_HOTNESS)
+                bucket_heat(tbl, dbk)[dpos] = bucket_heat(tbl, sbk)[spos];
+        if (tbl->flags & DCHT_FLAG_WIDE) {
+                uint64_t * dst = bucket_wkey(tbl, dbk, dpos);
+                const uint64_t * src = bucket_wkey(tbl, sbk, spos);
+
+                /* published by the tag */
+                for (unsigned w = 0; w < wkey_words(tbl); w++)
+                        atomic_store_explicit(&dst[w], src[w], memory_order_relaxed);
+        }
+
         store_key_val(dbk, dpos, key, val);
         del_key(sbk, spos);
+
+        bucket_unlock(tbl, sbk);
+
+        if (hint && sbk != primary)
+                hint_dec(tbl, primary);
 }
 
 /**
- * @brief　Returns the value associated with the key registered in the bucket
+ * @brief store new or updated entry
  *
+ * @param tbl: hash table pointer
  * @param bk: bucket
- * @param key: search key
- * @param val_p: Pointer to set the read value
- * @return Returns the position on success, negative on failure
+ * @param pos: entry position in bk
+ * @param key: key
+ * @param val: value
+ * @return void
  */
-always_inline int
-find_key_val (struct dcht_bucket_s * bk,
-              uint32_t key,
-              uint32_t * val_p)
+always_inline void
+store_entry (struct dcht_hash_table_s * tbl,
+             struct dcht_bucket_s * bk,
+             int pos,
+             uint32_t key,
+             uint32_t val)
 {
-        int pos = -ENOENT;
-
-        do {
-                pos = FIND_KEY_IN_BUCKET(bk, key);
-                if (pos >= 0)
-                        *val_p = *(volatile uint32_t *) &bk->val[pos];
+        if (tbl->flags & DCHT_FLAG_TTL)
+                bucket_ts(tbl, bk)[pos] = tbl->now;
+        if (tbl->flags & DCHT_FLAG_CACHE) {
+                /* new entries start unreferenced, one-hit keys are evicted first */
+                if (bk->key[pos] != key)
+                        ref_clear(bucket_ref(tbl, bk), pos);
+        }
+        if ((tbl->flags & DCHT_FLAG_HOTNESS) && bk->key[pos] != key)
+                bucket_heat(tbl, bk)[pos] = 0;
 
-                /* Reread if state is updated during search */
-        } while (pos >= 0 && *((volatile uint32_t *) &bk->key[pos]) != key);
+        if (bk->key[pos] == key) {
+                store_key_val(bk, pos, key, val);
+                gen_bump(tbl, key);
+        } else {
+                store_key_val(bk, pos, key, val);
+        }
+}
 
-        return pos;
+/**
+ * @brief refresh the timestamp and reference bit of found entry (reader thread)
+ *
+ * @param tbl: hash table pointer
+ * @param bk: bucket having key
+ * @param pos: found entry position
+ * @param heat: count up the access counter
+ * @return void
+ */
+always_inline void
+touch_entry_pos (struct dcht_hash_table_s * tbl,
+                 struct dcht_bucket_s * bk,
+                 int pos,
+                 bool heat)
+{
+        /* do not dirty the cachelines without change */
+        if (tbl->flags & DCHT_FLAG_TTL_REFRESH) {
+                uint32_t * ts = bucket_ts(tbl, bk);
+                uint32_t now = atomic_load_explicit(&tbl->now, memory_order_relaxed);
+
+                if (ts[pos] != now)
+                        atomic_store_explicit(&ts[pos], now, memory_order_relaxed);
+        }
+        if (tbl->flags & DCHT_FLAG_CACHE) {
+                uint8_t * ref = bucket_ref(tbl, bk);
+
+                if (!(*ref & (1u << pos)))
+                        ref_set(ref, pos);
+        }
+        if (heat) {
+                /* lost increments between readers do not matter */
+                uint8_t * h = &bucket_heat(tbl, bk)[pos];
+
+                if (*h != UINT8_MAX)
+                        atomic_store_explicit(h, *h + 1, memory_order_relaxed);
+        }
 }
 
 /**
- * @brief Set all bits below MSB
+ * @brief refresh the timestamp and reference bit of found key (reader thread)
  *
- * @param v: input integer
- * @return integer
+ * @param drv: driver
+ * @param tbl: hash table pointer
+ * @param bk: bucket having key
+ * @param key: found key
+ * @return void
  */
-always_inline uint64_t
-combine64ms1b (uint64_t v)
+always_inline void
+touch_entry (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             struct dcht_bucket_s * bk,
+             uint32_t key)
 {
-        v |= v >> 1;
-        v |= v >> 2;
-        v |= v >> 4;
-        v |= v >> 8;
-        v |= v >> 16;
-        v |= v >> 32;
-        return v;
+        bool heat = (tbl->flags & DCHT_FLAG_HOTNESS) && heat_sampled();
+        int pos;
+
+        if (!heat && !(tbl->flags & (DCHT_FLAG_TTL_REFRESH | DCHT_FLAG_CACHE)))
+                return;
+
+        pos = FIND_KEY_IN_BUCKET_D(drv, bk, key);
+        if (pos >= 0)
+                touch_entry_pos(tbl, bk, pos, heat);
 }
 
 /**
- * @brief Returns the nearest power of 2 times greater than
+ * @brief　Returns the value associated with the key registered in the bucket
  *
- * @param input integer
- * @return integer
+ * @param bk: bucket
+ * @param key: search key
+ * @param val_p: Pointer to set the read value
+ * @return Returns the position on success, negative on failure
  */
-always_inline uint64_t
-align64pow2 (uint64_t v)
+always_inline int
+find_key_val (struct dcht_bucket_s * bk,
+              uint32_t key,
+              uint32_t * val_p)
 {
-        v--;
-        v = combine64ms1b(v);
-        return v + 1;
+        int pos = -ENOENT;
+
+        do {
+                pos = FIND_KEY_IN_BUCKET(bk, key);
+                if (pos >= 0)
+                        *val_p = *(volatile uint32_t *) &bk->val[pos];
+
+                /* Reread if state is updated during search */
+        } while (pos >= 0 && *((volatile uint32_t *) &bk->key[pos]) != key);
+
+        return pos;
 }
 
 /**
  * @brief Fetch the bucket where key is entried
  *
+ * @param drv: driver
  * @param tbl: hash table pointer
  * @param bk_pp: bucket pointer array[2]
  * @param key: entry key
  * @return void
  */
 always_inline void
-buckets_fetch (struct dcht_hash_table_s *tbl,
-               struct dcht_bucket_s ** bk_pp,
-               uint32_t key)
+buckets_fetch_d (const struct arch_handler_s * drv,
+                 struct dcht_hash_table_s *tbl,
+                 struct dcht_bucket_s ** bk_pp,
+                 uint32_t key)
 {
         unsigned x, y, msk = tbl->mask;
         unsigned pos[2];
         int retry = 10;
 
-        x = HASH(0xdeadbeef, key);
-        x = HASH(x, BSWAP(key));
+        x = HASH_D(drv, 0xdeadbeef, key);
+        x = HASH_D(drv, x, BSWAP(key));
         pos[0] = x & msk;
         while (!pos[0]) {
-                x = HASH(x, key);
+                x = HASH_D(drv, x, key);
                 pos[0] = x & msk;
 
                 assert(--retry > 0);
@@ -815,7 +1705,7 @@ buckets_fetch (struct dcht_hash_table_s *tbl,
         y = BSWAP(key ^ x);
         pos[1] = y & msk;
         while (pos[0] == pos[1] || !pos[1]) {
-                y = HASH(y, ~BSWAP(key));
+                y = HASH_D(drv, y, ~BSWAP(key));
                 pos[1] = y & msk;
 
                 assert(--retry > 0);
@@ -830,7 +1720,36 @@ buckets_fetch (struct dcht_hash_table_s *tbl,
         bk_pp[1] = &tbl->buckets[pos[1]];
 
         prefetch(bk_pp[0]);
-        prefetch(bk_pp[1]);
+        /* the secondary is read only if the hint says so */
+        if (tbl->flags & DCHT_FLAG_OVERFLOW_HINT)
+                prefetch(bucket_hint(tbl, bk_pp[0]));
+        else
+                prefetch(bk_pp[1]);
+}
+
+always_inline void
+buckets_fetch (struct dcht_hash_table_s *tbl,
+               struct dcht_bucket_s ** bk_pp,
+               uint32_t key)
+{
+        buckets_fetch_d(arch_handler, tbl, bk_pp, key);
+}
+
+/*
+ * count down the hint after key was taken out of bk, if bk is its secondary
+ */
+always_inline void
+hint_removed (struct dcht_hash_table_s * tbl,
+              const struct dcht_bucket_s * bk,
+              uint32_t key)
+{
+        if (tbl->flags & DCHT_FLAG_OVERFLOW_HINT) {
+                struct dcht_bucket_s * bk_p[2];
+
+                buckets_fetch(tbl, bk_p, key);
+                if (bk_p[1] == bk)
+                        hint_dec(tbl, bk_p[0]);
+        }
 }
 
 /**
@@ -847,6 +1766,7 @@ cuckoo_replace (struct dcht_hash_table_s * tbl,
                 int depth)
 {
         struct dcht_bucket_s * another[DCHT_BUCKET_ENTRY_SZ];
+        struct dcht_bucket_s * primary[DCHT_BUCKET_ENTRY_SZ];
 
         /* setup & prefetch */
         for (int i = 0; i < (int) DCHT_BUCKET_ENTRY_SZ; i += 1) {
@@ -854,6 +1774,7 @@ cuckoo_replace (struct dcht_hash_table_s * tbl,
 
                 buckets_fetch(tbl, bk_p, bk->key[i]);
 
+                primary[i] = bk_p[0];
                 if (bk_p[0] == bk)
                         another[i] = bk_p[1];
                 else
@@ -866,7 +1787,7 @@ cuckoo_replace (struct dcht_hash_table_s * tbl,
 
                 if (pos >= 0) {
                         /* move bk(i) -> another(pos) */
-                        move_entry(another[i], pos, bk, i);
+                        move_entry(tbl, another[i], pos, bk, i, primary[i]);
                         NOTIFY_CB(tbl, bk, i, DCHT_EVENT_MOVED_ENTRY, 1);
                         return i;
                 }
@@ -878,7 +1799,7 @@ cuckoo_replace (struct dcht_hash_table_s * tbl,
                         int pos = cuckoo_replace(tbl, another[i], depth - 1);
 
                         if (pos >= 0) {
-                                move_entry(another[i], pos, bk, i);
+                                move_entry(tbl, another[i], pos, bk, i, primary[i]);
                                 NOTIFY_CB(tbl, bk, i, DCHT_EVENT_MOVED_ENTRY, 1);
                                 return i;
                         }
@@ -902,51 +1823,370 @@ nb_bcuckets (unsigned nb_entries)
         return nb_buckets;
 }
 
+/************************************************************************
+ * operation capture
+ ************************************************************************/
+#define CAPTURE_BUFFER_NB	4096
+
+struct dcht_capture_s {
+        pthread_mutex_t mutex;		/* reader threads record concurrently */
+        FILE * fp;
+        uint64_t last_ns;
+        long nb;
+        int err;
+        unsigned buff_nb;
+        struct dcht_capture_rec_s buff[CAPTURE_BUFFER_NB];
+};
+
+always_inline uint64_t
+capture_time (void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+always_inline uint32_t
+capture_saturate (uint64_t v,
+                  uint32_t max)
+{
+        return v > max ? max : (uint32_t) v;
+}
+
+/*
+ * must be called with mutex held
+ */
+static void
+capture_flush (struct dcht_capture_s * cap)
+{
+        if (cap->buff_nb && !cap->err) {
+                if (fwrite(cap->buff, sizeof(cap->buff[0]), cap->buff_nb, cap->fp) != cap->buff_nb)
+                        cap->err = -EIO;
+        }
+        cap->buff_nb = 0;
+}
+
+static void
+capture_record (struct dcht_capture_s * cap,
+                uint64_t start,
+                enum dcht_capture_op_e op,
+                uint32_t key,
+                uint32_t val,
+                int ret)
+{
+        uint64_t end = capture_time();
+
+        pthread_mutex_lock(&cap->mutex);
+
+        struct dcht_capture_rec_s * rec = &cap->buff[cap->buff_nb];
+
+        rec->key      = key;
+        rec->val      = val;
+        /* records are in lock order, a later call may have started earlier */
+        rec->delta_ns = start > cap->last_ns ? capture_saturate(start - cap->last_ns, UINT32_MAX) : 0;
+        rec->lat_ns   = capture_saturate(end - start, UINT32_MAX);
+        rec->op       = op;
+        rec->ret      = ret < 0 ? (ret < INT8_MIN ? INT8_MIN : ret) : 0;
+
+        if (start > cap->last_ns)
+                cap->last_ns = start;
+        cap->nb += 1;
+        if (++cap->buff_nb == CAPTURE_BUFFER_NB)
+                capture_flush(cap);
+
+        pthread_mutex_unlock(&cap->mutex);
+}
+
+/*
+ * the capture of a reader call, NULL when not capturing.
+ * a capture is held until capture_put(), dcht_hash_capture_stop() frees it
+ * once no reader holds it. the count is only touched while capturing.
+ */
+always_inline struct dcht_capture_s *
+capture_get (struct dcht_hash_table_s * tbl)
+{
+        struct dcht_capture_s * cap;
+
+        if (!atomic_load_explicit(&tbl->capture, memory_order_relaxed))
+                return NULL;
+
+        /* pairs with the NULL store then count load of dcht_hash_capture_stop() */
+        atomic_fetch_add_explicit(&tbl->capture_users, 1, memory_order_seq_cst);
+        cap = atomic_load_explicit(&tbl->capture, memory_order_seq_cst);
+        if (!cap)
+                atomic_fetch_sub_explicit(&tbl->capture_users, 1, memory_order_release);
+        return cap;
+}
+
+always_inline void
+capture_put (struct dcht_hash_table_s * tbl,
+             struct dcht_capture_s * cap)
+{
+        if (cap)
+                atomic_fetch_sub_explicit(&tbl->capture_users, 1, memory_order_release);
+}
+
+/*
+ * select the driver of this process,
+ * the same one for the ifunc resolvers and arch_handler
+ */
+static const struct arch_handler_s *
+arch_handler_select (void)
+{
+#if defined(__x86_64__)
+        return x86_handler_get();
+#else	/* !__x86_64__ */
+        return &generic_handlers;
+#endif	/* !__x86_64__ */
+}
+
+/*
+ * ahead of the constructors that may make tables
+ */
+static void __attribute__((constructor(101)))
+arch_handler_init (void)
+{
+        arch_handler = arch_handler_select();
+        TRACER("use %s cuckoo hash driver\n", arch_handler->name);
+}
+
+/*
+ * hot entry points, specialized per driver and bound once at load time by GNU ifunc.
+ * the driver is a constant in each variant, so its hash and bucket compare are
+ * inlined into one body. _stem##_d(drv, ...) is the common body.
+ */
+#if defined(__x86_64__)
+#define DRIVER_VARIANTS(_ret,_stem,_params,...)				\
+static _ret								\
+_stem##_GEN _params							\
+{									\
+        return _stem##_d(&generic_handlers, __VA_ARGS__);		\
+}									\
+static _ret								\
+_stem##_SSE2 _params							\
+{									\
+        return _stem##_d(&x86_sse2_handlers, __VA_ARGS__);		\
+}									\
+static __attribute__((target(SSE42_TARGET))) _ret			\
+_stem##_SSE42 _params							\
+{									\
+        return _stem##_d(&x86_sse42_handlers, __VA_ARGS__);		\
+}									\
+static __attribute__((target(AVX2_TARGET))) _ret			\
+_stem##_AVX2 _params							\
+{									\
+        return _stem##_d(&x86_avx2_handlers, __VA_ARGS__);		\
+}									\
+static _ret								\
+(*_stem##_resolve (void)) _params					\
+{									\
+        const struct arch_handler_s * drv = arch_handler_select();	\
+									\
+        if (drv == &x86_avx2_handlers)					\
+                return _stem##_AVX2;					\
+        if (drv == &x86_sse42_handlers)					\
+                return _stem##_SSE42;					\
+        if (drv == &x86_sse2_handlers)					\
+                return _stem##_SSE2;					\
+        return _stem##_GEN;						\
+}
+
+#define DRIVER_ENTRY(_ret,_name,_stem,_params,...)			\
+DRIVER_VARIANTS(_ret, _stem, _params, __VA_ARGS__)			\
+_ret _name _params __attribute__((ifunc(#_stem "_resolve")));
+
+#else	/* !__x86_64__ */
+#define DRIVER_ENTRY(_ret,_name,_stem,_params,...)			\
+_ret									\
+_name _params								\
+{									\
+        return _stem##_d(&generic_handlers, __VA_ARGS__);		\
+}
+#endif	/* !__x86_64__ */
+
+/*
+ * table header, buckets, then optional areas.
+ * set the offsets of optional areas if tbl is not NULL
+ */
+static size_t
+table_layout (struct dcht_hash_table_s * tbl,
+              unsigned nb_buckets,
+              unsigned flags)
+{
+        size_t size = sizeof(struct dcht_hash_table_s) + sizeof(struct dcht_bucket_s) * nb_buckets;
+
+        if (flags & DCHT_FLAG_TTL) {
+                if (tbl)
+                        tbl->ts_offset = size;
+                size += sizeof(struct bucket_ts_s) * nb_buckets;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_CACHE) {
+                if (tbl)
+                        tbl->ref_offset = size;
+                size += sizeof(uint8_t) * nb_buckets;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_ATOMIC_VAL) {
+                if (tbl)
+                        tbl->lock_offset = size;
+                size += sizeof(uint8_t) * nb_buckets;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_OVERFLOW_HINT) {
+                if (tbl)
+                        tbl->hint_offset = size;
+                size += sizeof(uint8_t) * nb_buckets;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_HOTNESS) {
+                if (tbl)
+                        tbl->heat_offset = size;
+                size += sizeof(struct bucket_heat_s) * nb_buckets;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_MULTI) {
+                unsigned nb_ovf = nb_buckets / OVF_RATIO + 1;
+
+                if (tbl) {
+                        tbl->ovf_offset = size;
+                        tbl->nb_ovf = nb_ovf;
+                }
+                size += sizeof(struct dcht_bucket_s) * nb_ovf;
+                if (tbl)
+                        tbl->link_offset = size;
+                size += sizeof(uint32_t) * (nb_buckets + nb_ovf);
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_WIDE) {
+                unsigned words = (flags & DCHT_FLAG_KEY128) ? 2 : 1;
+
+                if (tbl)
+                        tbl->wkey_offset = size;
+                size += sizeof(uint64_t) * DCHT_BUCKET_ENTRY_SZ * words * nb_buckets;
+        }
+        if (flags & DCHT_FLAG_VALS_MASK) {
+                unsigned nb_recs = nb_buckets * DCHT_BUCKET_ENTRY_SZ;
+
+                nb_recs += nb_recs / REC_SLACK_RATIO;
+                if (tbl) {
+                        tbl->rec_offset = size;
+                        tbl->rec_size = rec_stride_flags(flags) - sizeof(struct rec_meta_s);
+                        tbl->nb_recs = nb_recs;
+                }
+                size += (size_t) rec_stride_flags(flags) * nb_recs;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+                if (tbl)
+                        tbl->rec_ring_offset = size;
+                size += sizeof(uint32_t) * nb_recs;
+                size = (size + DCHT_CACHELINE_SIZE - 1) & ~(size_t) (DCHT_CACHELINE_SIZE - 1);
+        }
+        if (flags & DCHT_FLAG_FRONT_GEN) {
+                if (tbl)
+                        tbl->gen_offset = size;
+                size += sizeof(uint32_t) * GEN_STRIPES;
+        }
+        return size;
+}
+
 /************************************************************************
  * supported hash table API
  ************************************************************************/
 size_t
-dcht_hash_table_size (unsigned max_entries)
+dcht_hash_table_size_flags (unsigned max_entries,
+                            unsigned flags)
 {
-        unsigned nb_buckets = nb_bcuckets(max_entries);
-        size_t size = sizeof(struct dcht_bucket_s) * nb_buckets;
-
-        assert(sizeof(struct dcht_hash_table_s) ==  sizeof(struct dcht_bucket_s));
+        /* hash position zero is not used, see buckets_fetch() */
+        size_t size = table_layout(NULL, nb_bcuckets(max_entries) - 1, flags);
 
-        TRACER("max:%u size:%zu\n", max_entries, size);
+        TRACER("max:%u flags:%x size:%zu\n", max_entries, flags, size);
         return size;
 }
 
+size_t
+dcht_hash_table_size (unsigned max_entries)
+{
+        return dcht_hash_table_size_flags(max_entries, 0);
+}
+
 void
 dcht_hash_clean (struct dcht_hash_table_s * tbl)
 {
+        struct dcht_capture_s * cap = tbl->capture;
+        uint64_t start = 0;
+
+        if (cap)
+                start = capture_time();
+
         for (unsigned i = 0; i < tbl->nb_buckets - 1; i++) {
                 prefetch(&tbl->buckets[i + 1]);
                 BUCKET_INIT(&tbl->buckets[i]);
         }
         BUCKET_INIT(&tbl->buckets[tbl->nb_buckets - 1]);
+        if (tbl->flags & DCHT_FLAG_FRONT_GEN) {
+                uint32_t * gen = (uint32_t *) ((uintptr_t) tbl + tbl->gen_offset);
+
+                for (unsigned i = 0; i < GEN_STRIPES; i++)
+                        atomic_fetch_add_explicit(&gen[i], 1, memory_order_release);
+        }
+        if (tbl->flags & DCHT_FLAG_MULTI) {
+                memset(bucket_link(tbl, tbl->buckets), 0,
+                       sizeof(uint32_t) * (tbl->nb_buckets + tbl->nb_ovf));
+                tbl->ovf_used = 0;
+        }
+        if (tbl->flags & DCHT_FLAG_VALS_MASK) {
+                /* all records free, readers holding one see an odd seq */
+                for (unsigned i = 0; i < tbl->nb_recs; i++) {
+                        struct rec_meta_s * meta = rec_meta(tbl, i);
+
+                        atomic_store_explicit(&meta->seq, meta->seq | 1, memory_order_release);
+                        rec_ring(tbl)[i] = i;
+                }
+                tbl->rec_head = 0;
+                tbl->rec_tail = 0;
+                tbl->rec_free = tbl->nb_recs;
+        }
         tbl->current_entries = 0;
+        tbl->sweep_pos = 0;
+        tbl->heat_pos = 0;
+        if (tbl->flags & DCHT_FLAG_OVERFLOW_HINT)
+                memset(bucket_hint(tbl, tbl->buckets), 0, tbl->nb_buckets);
+
+        /* the replay runs the later operations on an empty table too */
+        if (cap)
+                capture_record(cap, start, DCHT_CAPTURE_OP_CLEAN, 0, 0, 0);
         TRACER("cleaned tbl:%p\n", tbl);
 }
 
 int
-dcht_hash_table_init (struct dcht_hash_table_s * tbl,
-                      size_t size,
-                      unsigned max_entries)
+dcht_hash_table_init_flags (struct dcht_hash_table_s * tbl,
+                            size_t size,
+                            unsigned max_entries,
+                            unsigned flags)
 {
         unsigned nb_buckets = 0;
         int ret = -EINVAL;
 
-        if (arch_handler == &generic_handlers && x86_handler_get)
-                arch_handler = x86_handler_get();
-
         if (tbl) {
                 if ((uintptr_t) tbl % DCHT_CACHELINE_SIZE != 0) {
                         /* invalid pointer alignment */
                         TRACER("Bad pointer alignment\n");
                         goto end;
                 }
-                if (size < dcht_hash_table_size(max_entries)) {
+                if ((flags & ~DCHT_FLAG_ALL) ||
+                    ((flags & DCHT_FLAG_TTL_REFRESH) && !(flags & DCHT_FLAG_TTL)) ||
+                    ((flags & DCHT_FLAG_CACHE_EVICT_ALWAYS) && !(flags & DCHT_FLAG_CACHE)) ||
+                    ((flags & DCHT_FLAG_MULTI) && (flags & DCHT_FLAG_NOT_MULTI)) ||
+                    ((flags & DCHT_FLAG_FRONT_GEN) && (flags & DCHT_FLAG_TOUCH)) ||
+                    ((flags & DCHT_FLAG_WIDE) == DCHT_FLAG_WIDE) ||
+                    ((flags & DCHT_FLAG_WIDE) && (flags & DCHT_FLAG_NOT_WIDE)) ||
+                    ((flags & DCHT_FLAG_VALS_MASK) == DCHT_FLAG_VALS_MASK) ||
+                    ((flags & DCHT_FLAG_VALS_MASK) && (flags & DCHT_FLAG_NOT_VALS))) {
+                        TRACER("invalid flags:%x\n", flags);
+                        goto end;
+                }
+                if (size < dcht_hash_table_size_flags(max_entries, flags)) {
                         /* too small */
                         TRACER("Too small table size:%zu\n", size);
                         goto end;
@@ -955,12 +2195,18 @@ dcht_hash_table_init (struct dcht_hash_table_s * tbl,
 
                 memset(tbl, 0, sizeof(*tbl));
 
-                tbl->nb_buckets   = nb_buckets - 1;	/* subtract header */
+                tbl->nb_buckets   = nb_buckets - 1;	/* hash position zero is not used */
                 tbl->mask         = nb_buckets - 1;
                 tbl->size         = size;
                 tbl->max_entries  = max_entries;
                 tbl->nb_entries   = tbl->nb_buckets * DCHT_BUCKET_ENTRY_SZ;
                 tbl->follow_depth = DCHT_FOLLOW_DEPTH_DEFAULT;
+                tbl->flags        = flags;
+                tbl->magic        = DCHT_TABLE_MAGIC;
+                tbl->driver       = arch_handler->hash_id;
+                table_layout(tbl, tbl->nb_buckets, flags);
+                if (flags & DCHT_FLAG_ATOMIC_VAL)
+                        memset((char *) tbl + tbl->lock_offset, 0, tbl->nb_buckets);
 
                 dcht_hash_clean(tbl);
                 ret = 0;
@@ -971,164 +2217,2072 @@ dcht_hash_table_init (struct dcht_hash_table_s * tbl,
         return ret;
 }
 
+int
+dcht_hash_table_init (struct dcht_hash_table_s * tbl,
+                      size_t size,
+                      unsigned max_entries)
+{
+        return dcht_hash_table_init_flags(tbl, size, max_entries, 0);
+}
+
 struct dcht_hash_table_s *
-dcht_hash_table_create (unsigned max_entries)
+dcht_hash_table_create_flags (unsigned max_entries,
+                              unsigned flags)
 {
-        size_t size = dcht_hash_table_size(max_entries);
+        size_t size = dcht_hash_table_size_flags(max_entries, flags);
         struct dcht_hash_table_s * tbl = aligned_alloc(DCHT_CACHELINE_SIZE, size);
 
-        if (dcht_hash_table_init(tbl, size, max_entries)) {
+        if (dcht_hash_table_init_flags(tbl, size, max_entries, flags)) {
                 free(tbl);
                 tbl = NULL;
         }
         return tbl;
 }
 
-void
-dcht_hash_buckets_prefetch (struct dcht_hash_table_s * tbl,
-                            uint32_t key,
-                            struct dcht_bucket_s ** bk_p)
+struct dcht_hash_table_s *
+dcht_hash_table_create (unsigned max_entries)
 {
-        buckets_fetch(tbl, bk_p, key);
-        TRACER("prefetched key:%u %p %p\n", key, bk_p[0], bk_p[1]);
+        return dcht_hash_table_create_flags(max_entries, 0);
 }
 
-int
-dcht_hash_find_in_buckets (uint32_t key,
-                           struct dcht_bucket_s ** bk_p,
-                           uint32_t * val_p)
+/*
+ * shared memory
+ */
+static int
+shm_open_path (const char * path,
+               int oflag)
 {
-        int ret = FIND_VAL_IN_BUCKET_PAIR_SYNC(bk_p, key, val_p);
-
-        TRACER("ret:%d key:%u bk:%p %p val:%u\n",
-               ret, key, bk_p[0], bk_p[1], *val_p);
-        return ret;
+        /* "/name" without other slash is a POSIX shared memory object */
+        if (path[0] == '/' && !strchr(path + 1, '/'))
+                return shm_open(path, oflag, 0600);
+        return open(path, oflag, 0600);
 }
 
-int
-dcht_hash_find (struct dcht_hash_table_s * tbl,
-                uint32_t key,
-                uint32_t * val_p)
+static void
+shm_unlink_path (const char * path)
 {
-        struct dcht_bucket_s * bk_p[2];
-
-        buckets_fetch(tbl, bk_p, key);
-
-        return (dcht_hash_find_in_buckets(key, bk_p, val_p) < 0 ? -ENOENT : 0);
+        if (path[0] == '/' && !strchr(path + 1, '/'))
+                shm_unlink(path);
+        else
+                unlink(path);
 }
 
-int
-dcht_hash_add_in_buckets (struct dcht_hash_table_s * tbl,
-                          struct dcht_bucket_s ** bk_p,
-                          uint32_t key,
-                          uint32_t val,
-                          bool skip_update)
+struct dcht_hash_table_s *
+dcht_hash_shm_create (const char * path,
+                      unsigned max_entries,
+                      unsigned flags,
+                      int * fd_p)
 {
-        if (key == DCHT_SENTINEL_KEY) {
-                TRACER("invalid key:%u\n", key);
-                return -EINVAL;
+        size_t size = dcht_hash_table_size_flags(max_entries, flags);
+        struct dcht_hash_table_s * tbl = NULL;
+        int fd, err;
+
+        if (!path && !fd_p) {
+                errno = EINVAL;
+                return NULL;
         }
 
-        /* check update */
-        if (skip_update) {
-                int pos;
-                int i = FIND_KEY_IN_BUCKET_PAIR(bk_p, key, &pos);
-                if (i >= 0) {
-                        /* find key, update */
-                        store_key_val(bk_p[i], pos, key, val);
+        if (path)
+                fd = shm_open_path(path, O_RDWR | O_CREAT | O_EXCL);
+        else
+                fd = memfd_create("dcht", MFD_CLOEXEC);
+        if (fd < 0)
+                return NULL;
 
-                        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_UPDATE_VALUE, 1);
-                        TRACER("update ret:%d key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
-                               i, key, val, bk_p[0], bk_p[1]);
+        if (ftruncate(fd, size)) {
+                err = errno;
+                goto end;
+        }
 
-                        return i;
-                }
+        tbl = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (tbl == MAP_FAILED) {
+                tbl = NULL;
+                err = errno;
+                goto end;
         }
 
-        /* check add */
-        {
-                unsigned nb[2];
-                int i = WHICH_ONE_MOST(bk_p, DCHT_SENTINEL_KEY,nb);
-                if (i >= 0) {
-                        int pos = find_vacancy(bk_p[i]);
-
-                        /* find vacancy pos */
-                        store_key_val(bk_p[i], pos, key, val);
-                        tbl->current_entries += 1;
-
-                        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_BUCKET_FULL,
-                                  pos == (DCHT_BUCKET_ENTRY_SZ - 1));
-                        TRACER("add ret:%d key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
-                               i, key, val, bk_p[0], bk_p[1]);
-                        return i;
-                }
+        err = -dcht_hash_table_init_flags(tbl, size, max_entries, flags);
+        if (err) {
+                munmap(tbl, size);
+                tbl = NULL;
+                goto end;
         }
+        tbl->flags |= DCHT_FLAG_SHARED;
+ end:
+        if (!tbl || !fd_p)
+                close(fd);
+        else
+                *fd_p = fd;
+        /* created above, not a table of another writer */
+        if (!tbl && path)
+                shm_unlink_path(path);
+
+        TRACER("path:%s tbl:%p size:%zu err:%d\n", path ? path : "memfd", tbl, size, err);
+        if (!tbl)
+                errno = err;
+        return tbl;
+}
 
-        /* replaced bucket */
-        for (int i = 0; i < 2; i++) {
-                struct dcht_bucket_s * bk = bk_p[i];
-                int pos;
+struct dcht_hash_table_s *
+dcht_hash_shm_attach (const char * path,
+                      int fd)
+{
+        struct dcht_hash_table_s * tbl = NULL;
+        struct dcht_hash_table_s layout;
+        struct stat st;
+        int err = 0;
+
+        if (path) {
+                fd = shm_open_path(path, O_RDWR);
+                if (fd < 0)
+                        return NULL;
+        }
 
-                if ((pos = cuckoo_replace(tbl, bk, tbl->follow_depth)) >= 0) {
-                        NOTIFY_CB(tbl, bk, pos, DCHT_EVENT_CUCKOO_REPLACED, 1);
+        if (fstat(fd, &st)) {
+                err = errno;
+                goto end;
+        }
+        if ((size_t) st.st_size < sizeof(*tbl)) {
+                err = EPROTO;
+                goto end;
+        }
 
-                        /* find free space */
-                        store_key_val(bk, pos, key, val);
-                        tbl->current_entries += 1;
+        tbl = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (tbl == MAP_FAILED) {
+                tbl = NULL;
+                err = errno;
+                goto end;
+        }
 
-                        TRACER("replaced ret:%d key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
-                               i, key, val, bk_p[0], bk_p[1]);
-                        return i;
-                }
+        /* the offsets must be the ones of this build */
+        memset(&layout, 0, sizeof(layout));
+        if (tbl->magic != DCHT_TABLE_MAGIC ||
+            !(tbl->flags & DCHT_FLAG_SHARED) ||
+            tbl->size > (size_t) st.st_size ||
+            tbl->size < table_layout(&layout, tbl->nb_buckets, tbl->flags) ||
+            layout.ts_offset != tbl->ts_offset ||
+            layout.ref_offset != tbl->ref_offset ||
+            layout.lock_offset != tbl->lock_offset ||
+            layout.hint_offset != tbl->hint_offset ||
+            layout.heat_offset != tbl->heat_offset ||
+            layout.gen_offset != tbl->gen_offset ||
+            layout.ovf_offset != tbl->ovf_offset ||
+            layout.link_offset != tbl->link_offset ||
+            layout.nb_ovf != tbl->nb_ovf ||
+            layout.wkey_offset != tbl->wkey_offset ||
+            layout.rec_offset != tbl->rec_offset ||
+            layout.rec_ring_offset != tbl->rec_ring_offset ||
+            layout.nb_recs != tbl->nb_recs) {
+                err = EPROTO;
+        } else if (tbl->driver != (uint32_t) arch_handler->hash_id) {
+                err = ENOTSUP;
+        }
+        if (err) {
+                munmap(tbl, st.st_size);
+                tbl = NULL;
         }
-        TRACER("failed key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
-               key, val, bk_p[0], bk_p[1]);
+ end:
+        if (path)
+                close(fd);
 
-        return -ENOSPC;
+        TRACER("path:%s fd:%d tbl:%p err:%d\n", path ? path : "-", fd, tbl, err);
+        if (!tbl)
+                errno = err;
+        return tbl;
 }
 
 int
-dcht_hash_add(struct dcht_hash_table_s * tbl,
-              uint32_t key,
-              uint32_t val,
-              bool skip_update)
+dcht_hash_shm_detach (struct dcht_hash_table_s * tbl)
 {
-         struct dcht_bucket_s * bk_p[2];
-
-         buckets_fetch(tbl, bk_p, key);
+        if (!(tbl->flags & DCHT_FLAG_SHARED))
+                return -EINVAL;
+        if (munmap(tbl, tbl->size))
+                return -errno;
+        return 0;
+}
 
-         return (dcht_hash_add_in_buckets(tbl, bk_p, key, val, skip_update) < 0 ? -ENOSPC : 0);
+always_inline void
+buckets_prefetch_d (const struct arch_handler_s * drv,
+                    struct dcht_hash_table_s * tbl,
+                    uint32_t key,
+                    struct dcht_bucket_s ** bk_p)
+{
+        buckets_fetch_d(drv, tbl, bk_p, key);
+        /* dcht_hash_find_in_buckets() has no table, it reads both buckets despite the hint */
+        if (tbl->flags & DCHT_FLAG_OVERFLOW_HINT)
+                prefetch(bk_p[1]);
+        TRACER("prefetched key:%u %p %p\n", key, bk_p[0], bk_p[1]);
 }
 
-int
-dcht_hash_del_in_buckets (struct dcht_hash_table_s * tbl,
-                          struct dcht_bucket_s ** bk_p,
-                          uint32_t key)
+DRIVER_ENTRY(void, dcht_hash_buckets_prefetch, buckets_prefetch,
+             (struct dcht_hash_table_s * tbl, uint32_t key, struct dcht_bucket_s ** bk_p),
+             tbl, key, bk_p)
+
+always_inline int
+find_in_buckets_d (const struct arch_handler_s * drv,
+                   uint32_t key,
+                   struct dcht_bucket_s ** bk_p,
+                   uint32_t * val_p)
 {
-        int pos = -EINVAL;
-        int ret = FIND_KEY_IN_BUCKET_PAIR(bk_p, key, &pos);
+        int ret = FIND_VAL_IN_BUCKET_PAIR_SYNC_D(drv, bk_p, key, val_p);
 
-        if (ret >= 0) {
-                del_key(bk_p[ret], pos);
-                assert(tbl->current_entries > 0);
-                tbl->current_entries -= 1;
+        TRACER("ret:%d key:%u bk:%p %p val:%u\n",
+               ret, key, bk_p[0], bk_p[1], *val_p);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_find_in_buckets, find_in_buckets,
+             (uint32_t key, struct dcht_bucket_s ** bk_p, uint32_t * val_p),
+             key, bk_p, val_p)
+
+/*
+ * search key-val in the overflow chain of the primary bucket
+ */
+always_inline int
+ovf_find (const struct arch_handler_s * drv,
+          const struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * primary,
+          uint32_t key,
+          uint32_t * val_p)
+{
+        for (const struct dcht_bucket_s * bk = ovf_next(tbl, primary); bk; bk = ovf_next(tbl, bk)) {
+                for (unsigned hit = MATCH_IN_BUCKET_D(drv, bk, key); hit; hit &= hit - 1) {
+                        if (!load_val(bk, __builtin_ctz(hit), key, val_p))
+                                return 0;
+                }
+        }
+        return -ENOENT;
+}
+
+always_inline int
+_hash_find (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            struct dcht_bucket_s ** bk_p,
+            uint32_t key,
+            uint32_t * val_p)
+{
+        struct dcht_capture_s * cap;
+        uint64_t start = 0;
+        int ret;
+
+        /* the 32 bit key would match the tags */
+        if (tbl->flags & DCHT_FLAG_WIDE)
+                return -EINVAL;
+
+        cap = capture_get(tbl);
+        if (cap)
+                start = capture_time();
+
+        if (tbl->flags & DCHT_FLAG_OVERFLOW_HINT) {
+                /* primary only, unless keys of it overflowed */
+                int pos = FIND_KEY_IN_BUCKET_D(drv, bk_p[0], key);
+
+                if (pos >= 0 && !load_val(bk_p[0], pos, key, val_p))
+                        ret = 0;
+                else if (atomic_load_explicit(bucket_hint(tbl, bk_p[0]), memory_order_acquire))
+                        ret = find_in_buckets_d(drv, key, bk_p, val_p);
+                else
+                        ret = -ENOENT;
+        } else {
+                ret = find_in_buckets_d(drv, key, bk_p, val_p);
+                if (ret < 0 && (tbl->flags & DCHT_FLAG_MULTI))
+                        ret = ovf_find(drv, tbl, bk_p[0], key, val_p);
+        }
+        if (ret >= 0) {
+                if (tbl->flags & DCHT_FLAG_TOUCH)
+                        touch_entry(drv, tbl, bk_p[ret], key);
+                ret = 0;
+        } else {
+                ret = -ENOENT;
+        }
+
+        if (cap) {
+                capture_record(cap, start, DCHT_CAPTURE_OP_FIND, key, ret ? 0 : *val_p, ret);
+                capture_put(tbl, cap);
+        }
+        return ret;
+}
+
+always_inline int
+hash_find_d (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             uint32_t key,
+             uint32_t * val_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+        return _hash_find(drv, tbl, bk_p, key, val_p);
+}
+
+DRIVER_ENTRY(int, dcht_hash_find, hash_find,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t * val_p),
+             tbl, key, val_p)
+
+void
+dcht_front_init (struct dcht_front_s * front,
+                 const struct dcht_hash_table_s * tbl)
+{
+        memset(front, 0, sizeof(*front));
+        front->tbl = tbl;
+        for (unsigned i = 0; i < DCHT_FRONT_NB; i++)
+                front->ent[i].key = DCHT_SENTINEL_KEY;
+}
+
+always_inline int
+find_front_d (const struct arch_handler_s * drv,
+              struct dcht_hash_table_s * tbl,
+              struct dcht_front_s * front,
+              uint32_t key,
+              uint32_t * val_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+        struct dcht_front_ent_s * ent;
+        uint32_t gen;
+        int ret;
+
+        if (!(tbl->flags & DCHT_FLAG_FRONT_GEN) || front->tbl != tbl)
+                return hash_find_d(drv, tbl, key, val_p);
+
+        /* the high bits, the low ones of the product depend on the low key bits only */
+        ent = &front->ent[front_hash(key) >> (32 - DCHT_FRONT_BITS)];
+
+        /* the value is read after the generation, a later change bumps it */
+        gen = atomic_load_explicit(key_gen(tbl, key), memory_order_acquire);
+        if (ent->key == key && ent->gen == gen) {
+                *val_p = ent->val;
+                front->hits += 1;
+                return 0;
+        }
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+        ret = _hash_find(drv, tbl, bk_p, key, val_p);
+        if (!ret) {
+                ent->key = key;
+                ent->val = *val_p;
+                ent->gen = gen;
+        }
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_find_front, find_front,
+             (struct dcht_hash_table_s * tbl, struct dcht_front_s * front,
+              uint32_t key, uint32_t * val_p),
+             tbl, front, key, val_p)
+
+/**
+ * @brief make a vacancy for a new entry in the buckets pair
+ *
+ * @param tbl: hash table pointer
+ * @param bk_p: bucket pointer array
+ * @param sc: scan result of the buckets pair
+ * @param replace: try cuckoo replace if both buckets are full
+ * @param pos_p: vacant entry position
+ * @return Returns the bucket number of the vacancy.
+ *         Returns negative if no space.
+ */
+always_inline int
+place_entry (struct dcht_hash_table_s * tbl,
+             struct dcht_bucket_s ** bk_p,
+             const struct bucket_scan_s * sc,
+             bool replace,
+             int * pos_p)
+{
+        bool hint = tbl->flags & DCHT_FLAG_OVERFLOW_HINT;
+        int i;
+
+        if (hint)
+                /* the primary while it has a vacancy, to keep misses in one bucket */
+                i = sc->vacant[0] ? 0 : 1;
+        else
+                /* the one with more vacancies */
+                i = __builtin_popcount(sc->vacant[0]) >= __builtin_popcount(sc->vacant[1]) ? 0 : 1;
+
+        if (sc->vacant[i]) {
+                *pos_p = __builtin_ctz(sc->vacant[i]);
+
+                if (hint && i)
+                        hint_inc(tbl, bk_p[0]);
+                return i;
+        }
+
+        /* replaced bucket */
+        for (i = 0; replace && i < 2; i++) {
+                struct dcht_bucket_s * bk = bk_p[i];
+                int pos;
+
+                if ((pos = cuckoo_replace(tbl, bk, tbl->follow_depth)) >= 0) {
+                        NOTIFY_CB(tbl, bk, pos, DCHT_EVENT_CUCKOO_REPLACED, 1);
+
+                        /* find free space */
+                        if (hint && i)
+                                hint_inc(tbl, bk_p[0]);
+                        *pos_p = pos;
+                        return i;
+                }
+        }
+        return -ENOSPC;
+}
+
+/**
+ * @brief add a new entry to the buckets pair
+ *
+ * @param tbl: hash table pointer
+ * @param bk_p: bucket pointer array
+ * @param sc: scan result of the buckets pair
+ * @param key: key
+ * @param val: value
+ * @param replace: try cuckoo replace if both buckets are full
+ * @return Returns the bucket number where the entry was added.
+ *         Returns negative if no space.
+ */
+always_inline int
+add_entry (struct dcht_hash_table_s * tbl,
+           struct dcht_bucket_s ** bk_p,
+           const struct bucket_scan_s * sc,
+           uint32_t key,
+           uint32_t val,
+           bool replace)
+{
+        int pos;
+        int i = place_entry(tbl, bk_p, sc, replace, &pos);
+
+        if (i < 0) {
+                TRACER("failed key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
+                       key, val, bk_p[0], bk_p[1]);
+                return i;
+        }
+
+        store_entry(tbl, bk_p[i], pos, key, val);
+        tbl->current_entries += 1;
+
+        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_BUCKET_FULL,
+                  pos == (DCHT_BUCKET_ENTRY_SZ - 1));
+        TRACER("add ret:%d key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
+               i, key, val, bk_p[0], bk_p[1]);
+        return i;
+}
+
+always_inline int
+_hash_add_in_buckets (const struct arch_handler_s * drv,
+                      struct dcht_hash_table_s * tbl,
+                      struct dcht_bucket_s ** bk_p,
+                      uint32_t key,
+                      uint32_t val,
+                      bool skip_update,
+                      bool replace)
+{
+        struct bucket_scan_s sc;
+
+        if (key == DCHT_SENTINEL_KEY || (tbl->flags & DCHT_FLAG_NOT_ADD32)) {
+                TRACER("invalid key:%u flags:%x\n", key, tbl->flags);
+                return -EINVAL;
+        }
+
+        SCAN_BUCKET_PAIR_D(drv, bk_p, key, &sc);
+
+        /* check update */
+        if (skip_update && (sc.hit[0] | sc.hit[1])) {
+                int i = sc.hit[0] ? 0 : 1;
+                int pos = __builtin_ctz(sc.hit[i]);
+
+                /* find key, update */
+                store_entry(tbl, bk_p[i], pos, key, val);
+
+                NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_UPDATE_VALUE, 1);
+                TRACER("update ret:%d key:%u val:%u bk_p[0]:%p bk_p[1]:%p\n",
+                       i, key, val, bk_p[0], bk_p[1]);
+
+                return i;
+        }
+
+        return add_entry(tbl, bk_p, &sc, key, val, replace);
+}
+
+always_inline int
+add_in_buckets_d (const struct arch_handler_s * drv,
+                  struct dcht_hash_table_s * tbl,
+                  struct dcht_bucket_s ** bk_p,
+                  uint32_t key,
+                  uint32_t val,
+                  bool skip_update)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        uint64_t start = 0;
+        int ret;
+
+        if (cap)
+                start = capture_time();
+
+        ret = _hash_add_in_buckets(drv, tbl, bk_p, key, val, skip_update, true);
+
+        if (cap)
+                capture_record(cap, start,
+                               skip_update ? DCHT_CAPTURE_OP_ADD_UPDATE : DCHT_CAPTURE_OP_ADD,
+                               key, val, ret);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_add_in_buckets, add_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p,
+              uint32_t key, uint32_t val, bool skip_update),
+             tbl, bk_p, key, val, skip_update)
+
+always_inline int
+hash_add_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            uint32_t key,
+            uint32_t val,
+            bool skip_update)
+{
+         struct dcht_bucket_s * bk_p[2];
+         int ret;
+
+         buckets_fetch_d(drv, tbl, bk_p, key);
+
+         ret = add_in_buckets_d(drv, tbl, bk_p, key, val, skip_update);
+         if (ret == -EINVAL)
+                 return ret;
+         return (ret < 0 ? -ENOSPC : 0);
+}
+
+DRIVER_ENTRY(int, dcht_hash_add, hash_add,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t val, bool skip_update),
+             tbl, key, val, skip_update)
+
+always_inline int
+find_or_add_in_buckets_d (const struct arch_handler_s * drv,
+                          struct dcht_hash_table_s * tbl,
+                          struct dcht_bucket_s ** bk_p,
+                          uint32_t key,
+                          uint32_t dflt,
+                          uint32_t * val_p,
+                          bool * added_p)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        struct bucket_scan_s sc;
+        uint64_t start = 0;
+        int ret;
+
+        if (cap)
+                start = capture_time();
+
+        *added_p = false;
+        if (key == DCHT_SENTINEL_KEY || (tbl->flags & DCHT_FLAG_NOT_ADD32)) {
+                TRACER("invalid key:%u flags:%x\n", key, tbl->flags);
+                ret = -EINVAL;
+                goto end;
+        }
+
+        SCAN_BUCKET_PAIR_D(drv, bk_p, key, &sc);
+
+        if (sc.hit[0] | sc.hit[1]) {
+                int pos;
+
+                ret = sc.hit[0] ? 0 : 1;
+                pos = __builtin_ctz(sc.hit[ret]);
+
+                /* only the writer changes keys */
+                load_val(bk_p[ret], pos, key, val_p);
+                if (tbl->flags & DCHT_FLAG_TOUCH)
+                        touch_entry(drv, tbl, bk_p[ret], key);
+        } else {
+                ret = add_entry(tbl, bk_p, &sc, key, dflt, true);
+                if (ret >= 0) {
+                        *val_p = dflt;
+                        *added_p = true;
+                }
+        }
+
+        TRACER("ret:%d key:%u val:%u added:%d\n", ret, key, ret < 0 ? 0 : *val_p, *added_p);
+ end:
+        if (cap)
+                capture_record(cap, start,
+                               *added_p ? DCHT_CAPTURE_OP_ADD : DCHT_CAPTURE_OP_FIND,
+                               key, *added_p ? dflt : ret < 0 ? 0 : *val_p, ret);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_find_or_add_in_buckets, find_or_add_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p,
+              uint32_t key, uint32_t dflt, uint32_t * val_p, bool * added_p),
+             tbl, bk_p, key, dflt, val_p, added_p)
+
+always_inline int
+find_or_add_d (const struct arch_handler_s * drv,
+               struct dcht_hash_table_s * tbl,
+               uint32_t key,
+               uint32_t dflt,
+               uint32_t * val_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+        bool added;
+        int ret;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        ret = find_or_add_in_buckets_d(drv, tbl, bk_p, key, dflt, val_p, &added);
+        if (ret < 0)
+                return ret;
+        return added ? 1 : 0;
+}
+
+DRIVER_ENTRY(int, dcht_hash_find_or_add, find_or_add,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t dflt, uint32_t * val_p),
+             tbl, key, dflt, val_p)
+
+/**
+ * @brief evict the least recently referenced entry of full buckets pair (CLOCK)
+ *
+ * @param tbl: hash table pointer
+ * @param bk_p: bucket pointer array
+ * @param pos_p: evicted entry position
+ * @return evicted bucket number
+ */
+always_inline int
+evict_entry (struct dcht_hash_table_s * tbl,
+             struct dcht_bucket_s ** bk_p,
+             int * pos_p)
+{
+        unsigned ref = *bucket_ref(tbl, bk_p[0]) | (*bucket_ref(tbl, bk_p[1]) << DCHT_BUCKET_ENTRY_SZ);
+        unsigned all = (1u << (DCHT_BUCKET_ENTRY_SZ * 2)) - 1;
+        unsigned victims = ~ref & all;
+        unsigned hand = tbl->evict_hand++ % (DCHT_BUCKET_ENTRY_SZ * 2);
+        int n;
+
+        if (!victims) {
+                /* all referenced, give them a second chance */
+                atomic_store_explicit(bucket_ref(tbl, bk_p[0]), 0, memory_order_relaxed);
+                atomic_store_explicit(bucket_ref(tbl, bk_p[1]), 0, memory_order_relaxed);
+                victims = all;
+        }
+
+        /* first victim from the rotating hand */
+        victims = ((victims >> hand) | (victims << (DCHT_BUCKET_ENTRY_SZ * 2 - hand))) & all;
+        n = (__builtin_ctz(victims) + hand) % (DCHT_BUCKET_ENTRY_SZ * 2);
+
+        *pos_p = n % DCHT_BUCKET_ENTRY_SZ;
+        return n / DCHT_BUCKET_ENTRY_SZ;
+}
+
+always_inline int
+_hash_add_evict_in_buckets (const struct arch_handler_s * drv,
+                            struct dcht_hash_table_s * tbl,
+                            struct dcht_bucket_s ** bk_p,
+                            uint32_t key,
+                            uint32_t val,
+                            uint32_t * ev_key_p,
+                            uint32_t * ev_val_p)
+{
+        int i, pos;
+
+        *ev_key_p = DCHT_SENTINEL_KEY;
+
+        if (!(tbl->flags & DCHT_FLAG_CACHE))
+                return -EINVAL;
+
+        i = _hash_add_in_buckets(drv, tbl, bk_p, key, val, true,
+                                 !(tbl->flags & DCHT_FLAG_CACHE_EVICT_ALWAYS));
+        if (i != -ENOSPC)
+                return i;
+
+        i = evict_entry(tbl, bk_p, &pos);
+
+        bucket_lock(tbl, bk_p[i]);
+        *ev_key_p = bk_p[i]->key[pos];
+        *ev_val_p = bk_p[i]->val[pos];
+
+        /* readers must not see the new value with the evicted key */
+        del_key(bk_p[i], pos);
+        bucket_unlock(tbl, bk_p[i]);
+        hint_removed(tbl, bk_p[i], *ev_key_p);
+        gen_bump(tbl, *ev_key_p);
+
+        if ((tbl->flags & DCHT_FLAG_OVERFLOW_HINT) && i)
+                hint_inc(tbl, bk_p[0]);
+        store_entry(tbl, bk_p[i], pos, key, val);
+
+        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_EVICTED, 1);
+        TRACER("evicted ret:%d key:%u val:%u ev_key:%u ev_val:%u\n",
+               i, key, val, *ev_key_p, *ev_val_p);
+        return i;
+}
+
+always_inline int
+add_evict_in_buckets_d (const struct arch_handler_s * drv,
+                        struct dcht_hash_table_s * tbl,
+                        struct dcht_bucket_s ** bk_p,
+                        uint32_t key,
+                        uint32_t val,
+                        uint32_t * ev_key_p,
+                        uint32_t * ev_val_p)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        uint64_t start = 0;
+        int ret;
+
+        if (cap)
+                start = capture_time();
+
+        ret = _hash_add_evict_in_buckets(drv, tbl, bk_p, key, val, ev_key_p, ev_val_p);
+
+        if (cap) {
+                if (ret >= 0 && *ev_key_p != DCHT_SENTINEL_KEY)
+                        capture_record(cap, start, DCHT_CAPTURE_OP_DEL, *ev_key_p, 0, 0);
+                capture_record(cap, start, DCHT_CAPTURE_OP_ADD_UPDATE, key, val, ret);
+        }
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_add_evict_in_buckets, add_evict_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p,
+              uint32_t key, uint32_t val, uint32_t * ev_key_p, uint32_t * ev_val_p),
+             tbl, bk_p, key, val, ev_key_p, ev_val_p)
+
+always_inline int
+add_evict_d (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             uint32_t key,
+             uint32_t val,
+             uint32_t * ev_key_p,
+             uint32_t * ev_val_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        return (add_evict_in_buckets_d(drv, tbl, bk_p, key, val, ev_key_p, ev_val_p) < 0 ? -ENOSPC : 0);
+}
+
+DRIVER_ENTRY(int, dcht_hash_add_evict, add_evict,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t val,
+              uint32_t * ev_key_p, uint32_t * ev_val_p),
+             tbl, key, val, ev_key_p, ev_val_p)
+
+/**
+ * @brief find key (and val) in a bucket (writer thread)
+ *
+ * @param bk: bucket
+ * @param key: key
+ * @param val_p: value to match, NULL matches any
+ * @return position, negative if not found
+ */
+always_inline int
+find_pair (const struct arch_handler_s * drv,
+           const struct dcht_bucket_s * bk,
+           uint32_t key,
+           const uint32_t * val_p)
+{
+        for (unsigned hit = MATCH_IN_BUCKET_D(drv, bk, key); hit; hit &= hit - 1) {
+                int pos = __builtin_ctz(hit);
+
+                if (!val_p || bk->val[pos] == *val_p)
+                        return pos;
+        }
+        return -ENOENT;
+}
+
+/*
+ * delete key (and val) in the overflow chain of the primary bucket
+ */
+always_inline int
+ovf_del (const struct arch_handler_s * drv,
+         struct dcht_hash_table_s * tbl,
+         const struct dcht_bucket_s * primary,
+         uint32_t key,
+         const uint32_t * val_p)
+{
+        for (struct dcht_bucket_s * bk = ovf_next(tbl, primary); bk; bk = ovf_next(tbl, bk)) {
+                int pos = find_pair(drv, bk, key, val_p);
+
+                if (pos >= 0) {
+                        del_key(bk, pos);
+                        return 0;
+                }
+        }
+        return -ENOENT;
+}
+
+always_inline int
+del_in_buckets_d (const struct arch_handler_s * drv,
+                  struct dcht_hash_table_s * tbl,
+                  struct dcht_bucket_s ** bk_p,
+                  uint32_t key)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        uint64_t start = 0;
+        int pos = -EINVAL;
+        int ret;
+
+        if (tbl->flags & DCHT_FLAG_WIDE)
+                return -EINVAL;
+
+        if (cap)
+                start = capture_time();
+
+        ret = FIND_KEY_IN_BUCKET_PAIR_D(drv, bk_p, key, &pos);
+
+        if (ret >= 0) {
+                uint32_t idx = bk_p[ret]->val[pos];
+
+                bucket_lock(tbl, bk_p[ret]);
+                del_key(bk_p[ret], pos);
+                bucket_unlock(tbl, bk_p[ret]);
+                if (tbl->flags & DCHT_FLAG_VALS_MASK)
+                        rec_retire(tbl, idx);
+                if ((tbl->flags & DCHT_FLAG_OVERFLOW_HINT) && ret)
+                        hint_dec(tbl, bk_p[0]);
+                gen_bump(tbl, key);
+                assert(tbl->current_entries > 0);
+                tbl->current_entries -= 1;
+        } else if ((tbl->flags & DCHT_FLAG_MULTI) && !ovf_del(drv, tbl, bk_p[0], key, NULL)) {
+                assert(tbl->current_entries > 0);
+                tbl->current_entries -= 1;
+                ret = 2;
+        }
+
+        if (cap)
+                capture_record(cap, start, DCHT_CAPTURE_OP_DEL, key, 0, ret);
+
+        TRACER("ret:%d key:%u pos:%d\n", ret, key, pos);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_del_in_buckets, del_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p, uint32_t key),
+             tbl, bk_p, key)
+
+always_inline int
+hash_del_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            uint32_t key)
+{
+        struct dcht_bucket_s * bk_p[2];
+        int ret;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        ret = del_in_buckets_d(drv, tbl, bk_p, key);
+        if (ret == -EINVAL)
+                return ret;
+        return ret >= 0 ? 0 : -ENOENT;
+}
+
+DRIVER_ENTRY(int, dcht_hash_del, hash_del,
+             (struct dcht_hash_table_s * tbl, uint32_t key),
+             tbl, key)
+
+/*
+ * multimap (DCHT_FLAG_MULTI)
+ */
+/**
+ * @brief link a new overflow bucket behind tail
+ *
+ * @param tbl: hash table pointer
+ * @param tail: last bucket of a chain
+ * @return linked bucket, NULL if no overflow bucket left
+ */
+always_inline struct dcht_bucket_s *
+ovf_append (struct dcht_hash_table_s * tbl,
+            struct dcht_bucket_s * tail)
+{
+        struct dcht_bucket_s * bk;
+
+        if (tbl->ovf_used >= tbl->nb_ovf)
+                return NULL;
+
+        bk = &ovf_buckets(tbl)[tbl->ovf_used++];
+        BUCKET_INIT(bk);
+        atomic_store_explicit(bucket_link(tbl, tail), tbl->ovf_used, memory_order_release);
+        return bk;
+}
+
+always_inline int
+multi_add_d (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             uint32_t key,
+             uint32_t val)
+{
+        struct dcht_bucket_s * bk_p[2], * tail, * vacant = NULL;
+        struct bucket_scan_s sc;
+        int ret = -EEXIST;
+
+        if (!(tbl->flags & DCHT_FLAG_MULTI) || key == DCHT_SENTINEL_KEY)
+                return -EINVAL;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        if (find_pair(drv, bk_p[0], key, &val) >= 0 || find_pair(drv, bk_p[1], key, &val) >= 0)
+                goto end;
+
+        tail = bk_p[0];
+        for (struct dcht_bucket_s * bk = ovf_next(tbl, tail); bk; bk = ovf_next(tbl, bk)) {
+                if (find_pair(drv, bk, key, &val) >= 0)
+                        goto end;
+                if (!vacant && FIND_KEY_IN_BUCKET_D(drv, bk, DCHT_SENTINEL_KEY) >= 0)
+                        vacant = bk;
+                tail = bk;
+        }
+
+        /* the buckets pair first, a chain costs readers a cacheline per bucket */
+        SCAN_BUCKET_PAIR_D(drv, bk_p, key, &sc);
+        ret = add_entry(tbl, bk_p, &sc, key, val, true);
+        if (ret >= 0) {
+                ret = 0;
+                goto end;
+        }
+
+        if (!vacant)
+                vacant = ovf_append(tbl, tail);
+        if (!vacant) {
+                ret = -ENOSPC;
+                goto end;
+        }
+        store_entry(tbl, vacant, FIND_KEY_IN_BUCKET_D(drv, vacant, DCHT_SENTINEL_KEY), key, val);
+        tbl->current_entries += 1;
+        ret = 0;
+ end:
+        TRACER("ret:%d key:%u val:%u\n", ret, key, val);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_multi_add, multi_add,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t val),
+             tbl, key, val)
+
+/*
+ * set the values of the key match bitmap in one pass
+ */
+always_inline unsigned
+collect_vals (const struct dcht_bucket_s * bk,
+              unsigned hit,
+              uint32_t key,
+              uint32_t * vals,
+              unsigned nb,
+              unsigned nb_max)
+{
+        if (nb >= nb_max)
+                return nb + __builtin_popcount(hit);
+
+        for (; hit; hit &= hit - 1) {
+                uint32_t val;
+
+                /* skip the entries deleted while reading */
+                if (load_val(bk, __builtin_ctz(hit), key, &val))
+                        continue;
+                if (nb < nb_max)
+                        vals[nb] = val;
+                nb += 1;
+        }
+        return nb;
+}
+
+always_inline unsigned
+multi_find_d (const struct arch_handler_s * drv,
+              struct dcht_hash_table_s * tbl,
+              uint32_t key,
+              uint32_t * vals,
+              unsigned nb_max)
+{
+        struct dcht_bucket_s * bk_p[2];
+        struct bucket_scan_s sc;
+        unsigned nb;
+
+        if (tbl->flags & DCHT_FLAG_WIDE)
+                return 0;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+        SCAN_BUCKET_PAIR_D(drv, bk_p, key, &sc);
+
+        nb = collect_vals(bk_p[0], sc.hit[0], key, vals, 0, nb_max);
+        nb = collect_vals(bk_p[1], sc.hit[1], key, vals, nb, nb_max);
+        if (tbl->flags & DCHT_FLAG_MULTI) {
+                for (struct dcht_bucket_s * bk = ovf_next(tbl, bk_p[0]); bk; bk = ovf_next(tbl, bk))
+                        nb = collect_vals(bk, MATCH_IN_BUCKET_D(drv, bk, key), key, vals, nb, nb_max);
+        }
+
+        TRACER("key:%u nb:%u\n", key, nb);
+        return nb;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_multi_find, multi_find,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t * vals, unsigned nb_max),
+             tbl, key, vals, nb_max)
+
+always_inline int
+multi_del_d (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             uint32_t key,
+             uint32_t val)
+{
+        struct dcht_bucket_s * bk_p[2];
+        int ret = -ENOENT;
+
+        if (!(tbl->flags & DCHT_FLAG_MULTI))
+                return -EINVAL;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        for (int i = 0; i < 2; i++) {
+                int pos = find_pair(drv, bk_p[i], key, &val);
+
+                if (pos >= 0) {
+                        del_key(bk_p[i], pos);
+                        ret = 0;
+                        break;
+                }
+        }
+        if (ret)
+                ret = ovf_del(drv, tbl, bk_p[0], key, &val);
+        if (!ret) {
+                assert(tbl->current_entries > 0);
+                tbl->current_entries -= 1;
+        }
+
+        TRACER("ret:%d key:%u val:%u\n", ret, key, val);
+        return ret;
+}
+
+DRIVER_ENTRY(int, dcht_hash_multi_del, multi_del,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t val),
+             tbl, key, val)
+
+/*
+ * wide keys (DCHT_FLAG_KEY64, DCHT_FLAG_KEY128)
+ * the engine works on the tags, a full key is written before its tag is
+ * published and compared after the tag was matched.
+ */
+always_inline uint32_t
+wkey_tag (const struct arch_handler_s * drv,
+          const uint64_t * wkey,
+          unsigned words)
+{
+        uint32_t x = 0xdeadbeef;
+
+        for (unsigned i = 0; i < words; i++) {
+                x = HASH_D(drv, x, (uint32_t) wkey[i]);
+                x = HASH_D(drv, x, (uint32_t) (wkey[i] >> 32));
+        }
+        /* zero is the sentinel */
+        return x ? x : 1;
+}
+
+/*
+ * for reader thread, after the tag was read
+ */
+always_inline bool
+wkey_equal (const uint64_t * slot,
+            const uint64_t * wkey,
+            unsigned words)
+{
+        for (unsigned i = 0; i < words; i++) {
+                if (atomic_load_explicit(&slot[i], memory_order_relaxed) != wkey[i])
+                        return false;
+        }
+        return true;
+}
+
+/*
+ * for writer thread
+ */
+always_inline int
+wkey_pos (const struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * bk,
+          unsigned hit,
+          const uint64_t * wkey,
+          unsigned words)
+{
+        for (; hit; hit &= hit - 1) {
+                int pos = __builtin_ctz(hit);
+
+                if (!memcmp(bucket_wkey(tbl, bk, pos), wkey, sizeof(uint64_t) * words))
+                        return pos;
+        }
+        return -ENOENT;
+}
+
+always_inline int
+wkey_find_in_bucket (const struct arch_handler_s * drv,
+                     const struct dcht_hash_table_s * tbl,
+                     const struct dcht_bucket_s * bk,
+                     uint32_t tag,
+                     const uint64_t * wkey,
+                     unsigned words,
+                     uint32_t * val_p)
+{
+        for (unsigned hit = MATCH_IN_BUCKET_D(drv, bk, tag); hit; hit &= hit - 1) {
+                int pos = __builtin_ctz(hit);
+
+                /* the acquire of the tag orders the full key read */
+                if (load_key(bk, pos) == tag &&
+                    wkey_equal(bucket_wkey(tbl, bk, pos), wkey, words) &&
+                    !load_val(bk, pos, tag, val_p))
+                        return pos;
+        }
+        return -ENOENT;
+}
+
+always_inline int
+wkey_add (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          const uint64_t * wkey,
+          unsigned words,
+          uint32_t val,
+          bool skip_update)
+{
+        uint32_t tag = wkey_tag(drv, wkey, words);
+        struct dcht_bucket_s * bk_p[2];
+        struct bucket_scan_s sc;
+        uint64_t * slot;
+        int i, pos;
+
+        buckets_fetch_d(drv, tbl, bk_p, tag);
+        SCAN_BUCKET_PAIR_D(drv, bk_p, tag, &sc);
+
+        for (i = 0; i < 2; i++) {
+                pos = wkey_pos(tbl, bk_p[i], sc.hit[i], wkey, words);
+                if (pos >= 0) {
+                        if (!skip_update)
+                                return -EEXIST;
+
+                        store_entry(tbl, bk_p[i], pos, tag, val);
+                        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_UPDATE_VALUE, 1);
+                        return 0;
+                }
+        }
+
+        i = place_entry(tbl, bk_p, &sc, true, &pos);
+        if (i < 0) {
+                TRACER("failed tag:%08x val:%u\n", tag, val);
+                return -ENOSPC;
+        }
+
+        /* published by the tag */
+        slot = bucket_wkey(tbl, bk_p[i], pos);
+        for (unsigned w = 0; w < words; w++)
+                atomic_store_explicit(&slot[w], wkey[w], memory_order_relaxed);
+        store_entry(tbl, bk_p[i], pos, tag, val);
+        tbl->current_entries += 1;
+
+        NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_BUCKET_FULL,
+                  pos == (DCHT_BUCKET_ENTRY_SZ - 1));
+        TRACER("add ret:%d tag:%08x val:%u\n", i, tag, val);
+        return 0;
+}
+
+always_inline int
+wkey_find (const struct arch_handler_s * drv,
+           struct dcht_hash_table_s * tbl,
+           const uint64_t * wkey,
+           unsigned words,
+           uint32_t * val_p)
+{
+        uint32_t tag = wkey_tag(drv, wkey, words);
+        struct dcht_bucket_s * bk_p[2];
+        int i, pos = -ENOENT;
+
+        buckets_fetch_d(drv, tbl, bk_p, tag);
+        /* vacancies are filled from the head, most keys are in the first line */
+        prefetch(bucket_wkey(tbl, bk_p[0], 0));
+
+        for (i = 0; i < 2; i++) {
+                pos = wkey_find_in_bucket(drv, tbl, bk_p[i], tag, wkey, words, val_p);
+                if (pos >= 0)
+                        break;
+
+                /* primary only, unless keys of it overflowed */
+                if ((tbl->flags & DCHT_FLAG_OVERFLOW_HINT) &&
+                    !atomic_load_explicit(bucket_hint(tbl, bk_p[0]), memory_order_acquire))
+                        break;
+        }
+        if (pos < 0)
+                return -ENOENT;
+
+        if (tbl->flags & DCHT_FLAG_TOUCH)
+                touch_entry_pos(tbl, bk_p[i], pos,
+                                (tbl->flags & DCHT_FLAG_HOTNESS) && heat_sampled());
+        return 0;
+}
+
+always_inline int
+wkey_del (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          const uint64_t * wkey,
+          unsigned words)
+{
+        uint32_t tag = wkey_tag(drv, wkey, words);
+        struct dcht_bucket_s * bk_p[2];
+
+        buckets_fetch_d(drv, tbl, bk_p, tag);
+
+        for (int i = 0; i < 2; i++) {
+                int pos = wkey_pos(tbl, bk_p[i], MATCH_IN_BUCKET_D(drv, bk_p[i], tag), wkey, words);
+
+                if (pos >= 0) {
+                        del_key(bk_p[i], pos);
+                        if ((tbl->flags & DCHT_FLAG_OVERFLOW_HINT) && i)
+                                hint_dec(tbl, bk_p[0]);
+                        assert(tbl->current_entries > 0);
+                        tbl->current_entries -= 1;
+
+                        TRACER("del ret:%d tag:%08x pos:%d\n", i, tag, pos);
+                        return 0;
+                }
+        }
+        return -ENOENT;
+}
+
+always_inline int
+add64_d (const struct arch_handler_s * drv,
+         struct dcht_hash_table_s * tbl,
+         uint64_t key,
+         uint32_t val,
+         bool skip_update)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY64))
+                return -EINVAL;
+        return wkey_add(drv, tbl, &key, 1, val, skip_update);
+}
+
+DRIVER_ENTRY(int, dcht_hash_add64, add64,
+             (struct dcht_hash_table_s * tbl, uint64_t key, uint32_t val, bool skip_update),
+             tbl, key, val, skip_update)
+
+always_inline int
+find64_d (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          uint64_t key,
+          uint32_t * val_p)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY64))
+                return -EINVAL;
+        return wkey_find(drv, tbl, &key, 1, val_p);
+}
+
+DRIVER_ENTRY(int, dcht_hash_find64, find64,
+             (struct dcht_hash_table_s * tbl, uint64_t key, uint32_t * val_p),
+             tbl, key, val_p)
+
+always_inline int
+del64_d (const struct arch_handler_s * drv,
+         struct dcht_hash_table_s * tbl,
+         uint64_t key)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY64))
+                return -EINVAL;
+        return wkey_del(drv, tbl, &key, 1);
+}
+
+DRIVER_ENTRY(int, dcht_hash_del64, del64,
+             (struct dcht_hash_table_s * tbl, uint64_t key),
+             tbl, key)
+
+always_inline int
+add128_d (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          const struct dcht_key128_s * key,
+          uint32_t val,
+          bool skip_update)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY128))
+                return -EINVAL;
+        return wkey_add(drv, tbl, key->w, 2, val, skip_update);
+}
+
+DRIVER_ENTRY(int, dcht_hash_add128, add128,
+             (struct dcht_hash_table_s * tbl, const struct dcht_key128_s * key,
+              uint32_t val, bool skip_update),
+             tbl, key, val, skip_update)
+
+always_inline int
+find128_d (const struct arch_handler_s * drv,
+           struct dcht_hash_table_s * tbl,
+           const struct dcht_key128_s * key,
+           uint32_t * val_p)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY128))
+                return -EINVAL;
+        return wkey_find(drv, tbl, key->w, 2, val_p);
+}
+
+DRIVER_ENTRY(int, dcht_hash_find128, find128,
+             (struct dcht_hash_table_s * tbl, const struct dcht_key128_s * key, uint32_t * val_p),
+             tbl, key, val_p)
+
+always_inline int
+del128_d (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          const struct dcht_key128_s * key)
+{
+        if (!(tbl->flags & DCHT_FLAG_KEY128))
+                return -EINVAL;
+        return wkey_del(drv, tbl, key->w, 2);
+}
+
+DRIVER_ENTRY(int, dcht_hash_del128, del128,
+             (struct dcht_hash_table_s * tbl, const struct dcht_key128_s * key),
+             tbl, key)
+
+const uint64_t *
+dcht_hash_entry_wkey (const struct dcht_hash_table_s * tbl,
+                      const struct dcht_bucket_s * bk,
+                      int pos)
+{
+        if (!(tbl->flags & DCHT_FLAG_WIDE))
+                return NULL;
+        return bucket_wkey(tbl, bk, pos);
+}
+
+/*
+ * value store (DCHT_FLAG_VALS)
+ */
+int
+dcht_hash_add_rec (struct dcht_hash_table_s * tbl,
+                   uint32_t key,
+                   const void * rec,
+                   size_t len,
+                   bool skip_update)
+{
+        struct dcht_bucket_s * bk_p[2];
+        struct bucket_scan_s sc;
+        uint32_t idx;
+        int i;
+
+        if (!(tbl->flags & DCHT_FLAG_VALS_MASK) || key == DCHT_SENTINEL_KEY ||
+            len > tbl->rec_size)
+                return -EINVAL;
+
+        buckets_fetch(tbl, bk_p, key);
+        SCAN_BUCKET_PAIR(bk_p, key, &sc);
+        if ((sc.hit[0] | sc.hit[1]) && !skip_update)
+                return -EEXIST;
+
+        /* never rewritten in place, readers may be reading the old one */
+        idx = rec_alloc(tbl);
+        rec_publish(tbl, idx, key, rec, len);
+
+        if (sc.hit[0] | sc.hit[1]) {
+                int pos;
+                uint32_t old;
+
+                i = sc.hit[0] ? 0 : 1;
+                pos = __builtin_ctz(sc.hit[i]);
+                old = bk_p[i]->val[pos];
+
+                store_entry(tbl, bk_p[i], pos, key, idx);
+                rec_retire(tbl, old);
+
+                NOTIFY_CB(tbl, bk_p[i], pos, DCHT_EVENT_UPDATE_VALUE, 1);
+                TRACER("update ret:%d key:%u idx:%u old:%u\n", i, key, idx, old);
+                return 0;
+        }
+
+        i = add_entry(tbl, bk_p, &sc, key, idx, true);
+        if (i < 0) {
+                rec_retire(tbl, idx);
+                return -ENOSPC;
+        }
+        return 0;
+}
+
+always_inline const void *
+_hash_find_rec (const struct arch_handler_s * drv,
+                struct dcht_hash_table_s * tbl,
+                struct dcht_bucket_s ** bk_p,
+                uint32_t key,
+                uint32_t * seq_p)
+{
+        for (int loop = 0; loop < REC_RETRY_MAX; loop++) {
+                const struct rec_meta_s * meta;
+                uint32_t idx, seq;
+
+                if (_hash_find(drv, tbl, bk_p, key, &idx))
+                        break;
+
+                meta = rec_meta(tbl, idx);
+                seq = atomic_load_explicit(&meta->seq, memory_order_acquire);
+
+                /* not retired and reused since the slot was read */
+                if (!(seq & 1) && atomic_load_explicit(&meta->key, memory_order_relaxed) == key) {
+                        *seq_p = seq;
+                        return rec_ptr(tbl, idx);
+                }
+        }
+        return NULL;
+}
+
+always_inline const void *
+find_rec_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            uint32_t key,
+            uint32_t * seq_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+
+        if (!(tbl->flags & DCHT_FLAG_VALS_MASK))
+                return NULL;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+        return _hash_find_rec(drv, tbl, bk_p, key, seq_p);
+}
+
+DRIVER_ENTRY(const void *, dcht_hash_find_rec, find_rec,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t * seq_p),
+             tbl, key, seq_p)
+
+bool
+dcht_hash_rec_stable (const struct dcht_hash_table_s * tbl,
+                      const void * rec,
+                      uint32_t seq)
+{
+        const struct rec_meta_s * meta = (const struct rec_meta_s *) rec - 1;
+
+        (void) tbl;
+        /* the record reads before the seq */
+        atomic_thread_fence(memory_order_acquire);
+        return atomic_load_explicit(&meta->seq, memory_order_relaxed) == seq;
+}
+
+/*
+ * bulk operations
+ * the buckets of the operation DCHT_BULK_AHEAD ahead are fetched while
+ * the current one runs. a bucket pointer stays valid across cuckoo moves.
+ */
+#define BULK_RING_SZ	DCHT_BULK_AHEAD
+
+always_inline void
+bulk_prime (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            struct dcht_bucket_s * (*ring)[2],
+            const uint32_t * keys,
+            unsigned nb)
+{
+        for (unsigned i = 0; i < nb && i < BULK_RING_SZ; i++)
+                buckets_fetch_d(drv, tbl, ring[i], keys[i]);
+}
+
+always_inline struct dcht_bucket_s **
+bulk_next (const struct arch_handler_s * drv,
+           struct dcht_hash_table_s * tbl,
+           struct dcht_bucket_s * (*ring)[2],
+           const uint32_t * keys,
+           unsigned nb,
+           unsigned i,
+           struct dcht_bucket_s ** bk_p)
+{
+        struct dcht_bucket_s ** slot = ring[i % BULK_RING_SZ];
+
+        bk_p[0] = slot[0];
+        bk_p[1] = slot[1];
+        if (i + BULK_RING_SZ < nb)
+                buckets_fetch_d(drv, tbl, slot, keys[i + BULK_RING_SZ]);
+        return bk_p;
+}
+
+always_inline unsigned
+find_bulk_d (const struct arch_handler_s * drv,
+             struct dcht_hash_table_s * tbl,
+             const uint32_t * keys,
+             unsigned nb,
+             uint32_t * vals,
+             int * ret)
+{
+        struct dcht_bucket_s * ring[BULK_RING_SZ][2];
+        unsigned done = 0;
+
+        bulk_prime(drv, tbl, ring, keys, nb);
+        for (unsigned i = 0; i < nb; i++) {
+                struct dcht_bucket_s * bk_p[2];
+                int r;
+
+                r = _hash_find(drv, tbl, bulk_next(drv, tbl, ring, keys, nb, i, bk_p), keys[i], &vals[i]);
+                if (!r)
+                        done += 1;
+                if (ret)
+                        ret[i] = r;
+        }
+
+        TRACER("nb:%u found:%u\n", nb, done);
+        return done;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_find_bulk, find_bulk,
+             (struct dcht_hash_table_s * tbl, const uint32_t * keys, unsigned nb,
+              uint32_t * vals, int * ret),
+             tbl, keys, nb, vals, ret)
+
+/*
+ * records found REC_BULK_AHEAD keys ago, their headers being fetched
+ */
+#define REC_BULK_AHEAD	DCHT_BULK_AHEAD
+
+struct rec_pending_s {
+        struct dcht_bucket_s * bk_p[2];
+        uint32_t idx;
+        bool found;
+};
+
+/*
+ * validate a record found ahead, search again if it was reused meanwhile
+ */
+always_inline const void *
+rec_settle (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            struct rec_pending_s * pend,
+            uint32_t key,
+            uint32_t * seq_p)
+{
+        const struct rec_meta_s * meta;
+        uint32_t seq;
+
+        if (!pend->found)
+                return NULL;
+
+        meta = rec_meta(tbl, pend->idx);
+        seq = atomic_load_explicit(&meta->seq, memory_order_acquire);
+        if (!(seq & 1) && atomic_load_explicit(&meta->key, memory_order_relaxed) == key) {
+                *seq_p = seq;
+                return rec_ptr(tbl, pend->idx);
+        }
+        return _hash_find_rec(drv, tbl, pend->bk_p, key, seq_p);
+}
+
+always_inline unsigned
+find_rec_bulk_d (const struct arch_handler_s * drv,
+                 struct dcht_hash_table_s * tbl,
+                 const uint32_t * keys,
+                 unsigned nb,
+                 const void ** recs,
+                 uint32_t * seqs)
+{
+        struct dcht_bucket_s * ring[BULK_RING_SZ][2];
+        struct rec_pending_s pend[REC_BULK_AHEAD];
+        unsigned done = 0;
+
+        if (!(tbl->flags & DCHT_FLAG_VALS_MASK))
+                return 0;
+
+        bulk_prime(drv, tbl, ring, keys, nb);
+        for (unsigned i = 0; i < nb + REC_BULK_AHEAD; i++) {
+                struct rec_pending_s * p = &pend[i % REC_BULK_AHEAD];
+
+                /* the record of the key found REC_BULK_AHEAD ago, before its slot is reused */
+                if (i >= REC_BULK_AHEAD) {
+                        unsigned j = i - REC_BULK_AHEAD;
+
+                        recs[j] = rec_settle(drv, tbl, p, keys[j], &seqs[j]);
+                        if (recs[j])
+                                done += 1;
+                }
+                if (i < nb) {
+                        p->found = !_hash_find(drv, tbl, bulk_next(drv, tbl, ring, keys, nb, i, p->bk_p),
+                                               keys[i], &p->idx);
+                        if (p->found)
+                                prefetch(rec_meta(tbl, p->idx));
+                }
+        }
+
+        TRACER("nb:%u found:%u\n", nb, done);
+        return done;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_find_rec_bulk, find_rec_bulk,
+             (struct dcht_hash_table_s * tbl, const uint32_t * keys, unsigned nb,
+              const void ** recs, uint32_t * seqs),
+             tbl, keys, nb, recs, seqs)
+
+always_inline unsigned
+add_bulk_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            const uint32_t * keys,
+            const uint32_t * vals,
+            unsigned nb,
+            bool skip_update,
+            int * ret)
+{
+        struct dcht_bucket_s * ring[BULK_RING_SZ][2];
+        unsigned done = 0;
+
+        bulk_prime(drv, tbl, ring, keys, nb);
+        for (unsigned i = 0; i < nb; i++) {
+                struct dcht_bucket_s * bk_p[2];
+                int r;
+
+                r = add_in_buckets_d(drv, tbl, bulk_next(drv, tbl, ring, keys, nb, i, bk_p),
+                                     keys[i], vals[i], skip_update);
+                if (r >= 0) {
+                        r = 0;
+                        done += 1;
+                }
+                if (ret)
+                        ret[i] = r;
+        }
+
+        TRACER("nb:%u added:%u\n", nb, done);
+        return done;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_add_bulk, add_bulk,
+             (struct dcht_hash_table_s * tbl, const uint32_t * keys, const uint32_t * vals,
+              unsigned nb, bool skip_update, int * ret),
+             tbl, keys, vals, nb, skip_update, ret)
+
+always_inline unsigned
+del_bulk_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            const uint32_t * keys,
+            unsigned nb,
+            int * ret)
+{
+        struct dcht_bucket_s * ring[BULK_RING_SZ][2];
+        unsigned done = 0;
+
+        bulk_prime(drv, tbl, ring, keys, nb);
+        for (unsigned i = 0; i < nb; i++) {
+                struct dcht_bucket_s * bk_p[2];
+                int r;
+
+                r = del_in_buckets_d(drv, tbl, bulk_next(drv, tbl, ring, keys, nb, i, bk_p), keys[i]);
+                if (r >= 0) {
+                        r = 0;
+                        done += 1;
+                } else if (r != -EINVAL) {
+                        r = -ENOENT;
+                }
+                if (ret)
+                        ret[i] = r;
+        }
+
+        TRACER("nb:%u deleted:%u\n", nb, done);
+        return done;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_del_bulk, del_bulk,
+             (struct dcht_hash_table_s * tbl, const uint32_t * keys, unsigned nb, int * ret),
+             tbl, keys, nb, ret)
+
+always_inline int
+find_cascade_d (const struct arch_handler_s * drv,
+                struct dcht_hash_table_s ** tbls,
+                unsigned nb_tbls,
+                const uint32_t * keys,
+                unsigned nb,
+                uint32_t * vals,
+                int * idx)
+{
+        struct dcht_bucket_s * ring[BULK_RING_SZ][DCHT_CASCADE_MAX][2];
+        int done = 0;
+
+        if (!nb_tbls || nb_tbls > DCHT_CASCADE_MAX)
+                return -EINVAL;
+
+        /* buckets of all tables for the keys ahead */
+        for (unsigned i = 0; i < nb && i < BULK_RING_SZ; i++) {
+                for (unsigned t = 0; t < nb_tbls; t++)
+                        buckets_fetch_d(drv, tbls[t], ring[i][t], keys[i]);
+        }
+
+        for (unsigned i = 0; i < nb; i++) {
+                struct dcht_bucket_s * (*slot)[2] = ring[i % BULK_RING_SZ];
+
+                idx[i] = -ENOENT;
+                for (unsigned t = 0; t < nb_tbls; t++) {
+                        if (!_hash_find(drv, tbls[t], slot[t], keys[i], &vals[i])) {
+                                idx[i] = t;
+                                done += 1;
+                                break;
+                        }
+                }
+
+                if (i + BULK_RING_SZ < nb) {
+                        for (unsigned t = 0; t < nb_tbls; t++)
+                                buckets_fetch_d(drv, tbls[t], slot[t], keys[i + BULK_RING_SZ]);
+                }
+        }
+
+        TRACER("nb:%u tables:%u found:%d\n", nb, nb_tbls, done);
+        return done;
+}
+
+DRIVER_ENTRY(int, dcht_hash_find_cascade, find_cascade,
+             (struct dcht_hash_table_s ** tbls, unsigned nb_tbls, const uint32_t * keys,
+              unsigned nb, uint32_t * vals, int * idx),
+             tbls, nb_tbls, keys, nb, vals, idx)
+
+/*
+ * asynchronous memory access chaining (AMAC) engine
+ * each in-flight operation is a state machine, a step either prefetches the
+ * next memory it needs or completes, then the next slot runs. an add that
+ * needs cuckoo replace prefetches the other buckets of all keys in its
+ * buckets pair before it displaces them.
+ */
+enum amac_state_e {
+        AMAC_STATE_IDLE = 0,
+        AMAC_STATE_PROBE,	/* buckets pair prefetched */
+        AMAC_STATE_DISPLACE,	/* other buckets of the displaced keys prefetched */
+};
+
+struct amac_slot_s {
+        struct dcht_amac_req_s * req;
+        struct dcht_bucket_s * bk_p[2];
+        enum amac_state_e state;
+};
+
+/*
+ * the operations on a key run in order, admission stalls while the key is in flight
+ */
+always_inline bool
+amac_key_in_flight (const struct amac_slot_s * slot,
+                    unsigned width,
+                    uint32_t key)
+{
+        for (unsigned i = 0; i < width; i++) {
+                if (slot[i].state != AMAC_STATE_IDLE && slot[i].req->key == key)
+                        return true;
+        }
+        return false;
+}
+
+always_inline int
+amac_add (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          struct amac_slot_s * slot)
+{
+        struct dcht_amac_req_s * req = slot->req;
+        int ret;
+
+        ret = add_in_buckets_d(drv, tbl, slot->bk_p, req->key, req->val,
+                               req->op == DCHT_AMAC_OP_ADD_UPDATE);
+        return ret < 0 ? ret : 0;
+}
+
+/*
+ * run one step of the operation, returns true if it is completed
+ */
+always_inline bool
+amac_step (const struct arch_handler_s * drv,
+           struct dcht_hash_table_s * tbl,
+           struct amac_slot_s * slot)
+{
+        struct dcht_amac_req_s * req = slot->req;
+
+        if (slot->state == AMAC_STATE_DISPLACE) {
+                req->ret = amac_add(drv, tbl, slot);
+                return true;
+        }
+
+        switch (req->op) {
+        case DCHT_AMAC_OP_FIND:
+                req->ret = _hash_find(drv, tbl, slot->bk_p, req->key, &req->val);
+                break;
+
+        case DCHT_AMAC_OP_ADD:
+        case DCHT_AMAC_OP_ADD_UPDATE:
+                {
+                        struct bucket_scan_s sc;
+
+                        SCAN_BUCKET_PAIR_D(drv, slot->bk_p, req->key, &sc);
+                        if (!(sc.vacant[0] | sc.vacant[1]) &&
+                            (req->op == DCHT_AMAC_OP_ADD || !(sc.hit[0] | sc.hit[1])) &&
+                            req->key != DCHT_SENTINEL_KEY && !(tbl->flags & DCHT_FLAG_NOT_ADD32)) {
+                                for (int i = 0; i < 2; i++) {
+                                        for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++) {
+                                                struct dcht_bucket_s * bk_p[2];
+
+                                                buckets_fetch_d(drv, tbl, bk_p, slot->bk_p[i]->key[pos]);
+                                        }
+                                }
+                                slot->state = AMAC_STATE_DISPLACE;
+                                return false;
+                        }
+                        req->ret = amac_add(drv, tbl, slot);
+                }
+                break;
+
+        case DCHT_AMAC_OP_DEL:
+                req->ret = del_in_buckets_d(drv, tbl, slot->bk_p, req->key);
+                if (req->ret >= 0)
+                        req->ret = 0;
+                else if (req->ret != -EINVAL)
+                        req->ret = -ENOENT;
+                break;
+
+        default:
+                req->ret = -EINVAL;
+                break;
+        }
+        return true;
+}
+
+always_inline unsigned
+amac_run_d (const struct arch_handler_s * drv,
+            struct dcht_hash_table_s * tbl,
+            struct dcht_amac_req_s * reqs,
+            unsigned nb,
+            unsigned width)
+{
+        struct amac_slot_s slot[DCHT_AMAC_WIDTH_MAX];
+        unsigned next = 0, done = 0, succeeded = 0;
+
+        if (!width)
+                width = 1;
+        else if (width > DCHT_AMAC_WIDTH_MAX)
+                width = DCHT_AMAC_WIDTH_MAX;
+
+        for (unsigned i = 0; i < width; i++)
+                slot[i].state = AMAC_STATE_IDLE;
+
+        while (done < nb) {
+                for (unsigned i = 0; i < width; i++) {
+                        struct amac_slot_s * sl = &slot[i];
+
+                        if (sl->state == AMAC_STATE_IDLE) {
+                                if (next >= nb || amac_key_in_flight(slot, width, reqs[next].key))
+                                        continue;
+
+                                sl->req = &reqs[next++];
+                                buckets_fetch_d(drv, tbl, sl->bk_p, sl->req->key);
+                                sl->state = AMAC_STATE_PROBE;
+                        } else if (amac_step(drv, tbl, sl)) {
+                                if (!sl->req->ret)
+                                        succeeded += 1;
+                                sl->state = AMAC_STATE_IDLE;
+                                done += 1;
+                        }
+                }
+        }
+
+        TRACER("nb:%u width:%u succeeded:%u\n", nb, width, succeeded);
+        return succeeded;
+}
+
+DRIVER_ENTRY(unsigned, dcht_hash_amac_run, amac_run,
+             (struct dcht_hash_table_s * tbl, struct dcht_amac_req_s * reqs, unsigned nb,
+              unsigned width),
+             tbl, reqs, nb, width)
+
+/*
+ * value operations
+ */
+always_inline uint32_t
+val_op (uint32_t * val_p,
+        enum dcht_val_op_e op,
+        uint32_t arg)
+{
+        uint32_t old;
+
+        switch (op) {
+        case DCHT_VAL_OP_FETCH_ADD:
+                old = atomic_fetch_add_explicit(val_p, arg, memory_order_relaxed);
+                break;
+        case DCHT_VAL_OP_SWAP:
+                old = atomic_exchange_explicit(val_p, arg, memory_order_relaxed);
+                break;
+        case DCHT_VAL_OP_MAX:
+                old = atomic_load_explicit(val_p, memory_order_relaxed);
+                while (old < arg &&
+                       !atomic_compare_exchange_weak_explicit(val_p, &old, arg,
+                                                              memory_order_relaxed,
+                                                              memory_order_relaxed))
+                        ;
+                break;
+        case DCHT_VAL_OP_MIN:
+        default:
+                old = atomic_load_explicit(val_p, memory_order_relaxed);
+                while (old > arg &&
+                       !atomic_compare_exchange_weak_explicit(val_p, &old, arg,
+                                                              memory_order_relaxed,
+                                                              memory_order_relaxed))
+                        ;
+                break;
+        }
+        return old;
+}
+
+/*
+ * the value left by a value operation on old
+ */
+always_inline uint32_t
+val_op_result (uint32_t old,
+               enum dcht_val_op_e op,
+               uint32_t arg)
+{
+        switch (op) {
+        case DCHT_VAL_OP_FETCH_ADD:
+                return old + arg;
+        case DCHT_VAL_OP_SWAP:
+                return arg;
+        case DCHT_VAL_OP_MAX:
+                return old < arg ? arg : old;
+        case DCHT_VAL_OP_MIN:
+        default:
+                return old > arg ? arg : old;
+        }
+}
+
+/*
+ * find key and lock its bucket, the entry cannot be moved or deleted while locked
+ */
+always_inline int
+find_key_locked (const struct arch_handler_s * drv,
+                 struct dcht_hash_table_s * tbl,
+                 struct dcht_bucket_s ** bk_p,
+                 uint32_t key,
+                 int * pos_p)
+{
+        int i;
+
+        while ((i = FIND_KEY_IN_BUCKET_PAIR_D(drv, bk_p, key, pos_p)) >= 0) {
+                bucket_lock(tbl, bk_p[i]);
+                if (load_key(bk_p[i], *pos_p) == key)
+                        break;
+
+                /* moved or deleted by writer */
+                bucket_unlock(tbl, bk_p[i]);
+        }
+        return i;
+}
+
+always_inline int
+val_op_in_buckets_d (const struct arch_handler_s * drv,
+                     struct dcht_hash_table_s * tbl,
+                     struct dcht_bucket_s ** bk_p,
+                     uint32_t key,
+                     enum dcht_val_op_e op,
+                     uint32_t arg,
+                     uint32_t * old_p)
+{
+        struct dcht_capture_s * cap;
+        uint64_t start = 0;
+        uint32_t old;
+        int i, pos;
+
+        if (!(tbl->flags & DCHT_FLAG_ATOMIC_VAL) || (tbl->flags & DCHT_FLAG_NOT_VAL32) ||
+            op >= DCHT_VAL_OP_NB)
+                return -EINVAL;
+
+        cap = capture_get(tbl);
+        if (cap)
+                start = capture_time();
+
+        i = find_key_locked(drv, tbl, bk_p, key, &pos);
+        if (i >= 0) {
+                old = val_op(&bk_p[i]->val[pos], op, arg);
+                /* under the bucket lock, the records of the entry are in operation order */
+                if (cap)
+                        capture_record(cap, start, DCHT_CAPTURE_OP_ADD_UPDATE, key,
+                                       val_op_result(old, op, arg), 0);
+                bucket_unlock(tbl, bk_p[i]);
+                gen_bump(tbl, key);
+
+                if (old_p)
+                        *old_p = old;
+        } else if (cap) {
+                capture_record(cap, start, DCHT_CAPTURE_OP_FIND, key, 0, i);
+        }
+        capture_put(tbl, cap);
+
+        TRACER("ret:%d key:%u op:%d arg:%u\n", i, key, op, arg);
+        return i;
+}
+
+DRIVER_ENTRY(int, dcht_hash_val_op_in_buckets, val_op_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p, uint32_t key,
+              enum dcht_val_op_e op, uint32_t arg, uint32_t * old_p),
+             tbl, bk_p, key, op, arg, old_p)
+
+always_inline int
+val_op_d (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          uint32_t key,
+          enum dcht_val_op_e op,
+          uint32_t arg,
+          uint32_t * old_p)
+{
+        struct dcht_bucket_s * bk_p[2];
+        int ret;
+
+        buckets_fetch_d(drv, tbl, bk_p, key);
+
+        ret = val_op_in_buckets_d(drv, tbl, bk_p, key, op, arg, old_p);
+        return ret < 0 ? ret : 0;
+}
+
+DRIVER_ENTRY(int, dcht_hash_val_op, val_op,
+             (struct dcht_hash_table_s * tbl, uint32_t key, enum dcht_val_op_e op,
+              uint32_t arg, uint32_t * old_p),
+             tbl, key, op, arg, old_p)
+
+always_inline int
+val_cas_in_buckets_d (const struct arch_handler_s * drv,
+                      struct dcht_hash_table_s * tbl,
+                      struct dcht_bucket_s ** bk_p,
+                      uint32_t key,
+                      uint32_t * expected_p,
+                      uint32_t desired)
+{
+        struct dcht_capture_s * cap;
+        uint64_t start = 0;
+        int i, pos;
+
+        if (!(tbl->flags & DCHT_FLAG_ATOMIC_VAL) || (tbl->flags & DCHT_FLAG_NOT_VAL32))
+                return -EINVAL;
+
+        cap = capture_get(tbl);
+        if (cap)
+                start = capture_time();
+
+        i = find_key_locked(drv, tbl, bk_p, key, &pos);
+        if (i >= 0) {
+                bool done = atomic_compare_exchange_strong_explicit(&bk_p[i]->val[pos],
+                                                                    expected_p, desired,
+                                                                    memory_order_relaxed,
+                                                                    memory_order_relaxed);
+                /* a failed exchange read the current value, as a find */
+                if (cap)
+                        capture_record(cap, start,
+                                       done ? DCHT_CAPTURE_OP_ADD_UPDATE : DCHT_CAPTURE_OP_FIND,
+                                       key, done ? desired : *expected_p, 0);
+                bucket_unlock(tbl, bk_p[i]);
+                if (done)
+                        gen_bump(tbl, key);
+                else
+                        i = -EAGAIN;
+        } else if (cap) {
+                capture_record(cap, start, DCHT_CAPTURE_OP_FIND, key, 0, i);
         }
+        capture_put(tbl, cap);
 
-        TRACER("ret:%d key:%u pos:%d\n", ret, key, pos);
-        return ret;
+        TRACER("ret:%d key:%u expected:%u desired:%u\n", i, key, *expected_p, desired);
+        return i;
 }
 
-int
-dcht_hash_del (struct dcht_hash_table_s * tbl,
-               uint32_t key)
+DRIVER_ENTRY(int, dcht_hash_val_cas_in_buckets, val_cas_in_buckets,
+             (struct dcht_hash_table_s * tbl, struct dcht_bucket_s ** bk_p, uint32_t key,
+              uint32_t * expected_p, uint32_t desired),
+             tbl, bk_p, key, expected_p, desired)
+
+always_inline int
+val_cas_d (const struct arch_handler_s * drv,
+           struct dcht_hash_table_s * tbl,
+           uint32_t key,
+           uint32_t * expected_p,
+           uint32_t desired)
 {
         struct dcht_bucket_s * bk_p[2];
+        int ret;
 
-        buckets_fetch(tbl, bk_p, key);
+        buckets_fetch_d(drv, tbl, bk_p, key);
 
-        return dcht_hash_del_in_buckets(tbl, bk_p, key) >= 0 ? 0 : -ENOENT;
+        ret = val_cas_in_buckets_d(drv, tbl, bk_p, key, expected_p, desired);
+        return ret < 0 ? ret : 0;
 }
 
+DRIVER_ENTRY(int, dcht_hash_val_cas, val_cas,
+             (struct dcht_hash_table_s * tbl, uint32_t key, uint32_t * expected_p,
+              uint32_t desired),
+             tbl, key, expected_p, desired)
+
 always_inline int
 _hash_bk_walk (struct dcht_hash_table_s * tbl,
                int (* bucket_cb)(struct dcht_hash_table_s *,
@@ -1145,6 +4299,12 @@ _hash_bk_walk (struct dcht_hash_table_s * tbl,
                 if (NB_KEYS_IN_BUCKET(bk, DCHT_SENTINEL_KEY) != DCHT_BUCKET_ENTRY_SZ)
                         ret = bucket_cb(tbl, bk, arg);
         }
+        for (unsigned j = 0; !ret && j < tbl->ovf_used; j++) {
+                struct dcht_bucket_s * bk = &ovf_buckets(tbl)[j];
+
+                if (NB_KEYS_IN_BUCKET(bk, DCHT_SENTINEL_KEY) != DCHT_BUCKET_ENTRY_SZ)
+                        ret = bucket_cb(tbl, bk, arg);
+        }
 
         TRACER("ret:%d loop:%u\n", ret, i);
         return ret;
@@ -1200,6 +4360,18 @@ dcht_hash_walk (struct dcht_hash_table_s * tbl,
         return _hash_bk_walk(tbl, _bucket_cb, &walk);
 }
 
+always_inline bool
+in_chain (const struct dcht_hash_table_s * tbl,
+          const struct dcht_bucket_s * primary,
+          const struct dcht_bucket_s * bk)
+{
+        for (const struct dcht_bucket_s * c = ovf_next(tbl, primary); c; c = ovf_next(tbl, c)) {
+                if (c == bk)
+                        return true;
+        }
+        return false;
+}
+
 static int
 _bucket_verify_cb (struct dcht_hash_table_s * tbl,
                    const struct dcht_bucket_s * bk,
@@ -1224,6 +4396,40 @@ _bucket_verify_cb (struct dcht_hash_table_s * tbl,
                 uint32_t key = bk->key[i];
                 unsigned nb[2];
 
+                if (tbl->flags & DCHT_FLAG_WIDE) {
+                        /* tags may collide, full keys must not */
+                        const uint64_t * wkey = bucket_wkey(tbl, bk, i);
+                        unsigned nb_wkey = 0;
+
+                        for (int j = 0; j < 2; j++) {
+                                for (unsigned hit = MATCH_IN_BUCKET(bk_p[i][j], key); hit; hit &= hit - 1) {
+                                        if (!memcmp(bucket_wkey(tbl, bk_p[i][j], __builtin_ctz(hit)), wkey,
+                                                    sizeof(uint64_t) * wkey_words(tbl)))
+                                                nb_wkey += 1;
+                                }
+                        }
+                        if ((bk != bk_p[i][0] && bk != bk_p[i][1]) ||
+                            wkey_tag(arch_handler, wkey, wkey_words(tbl)) != key || nb_wkey != 1) {
+                                TRACER("invalid bk:%p tag:%08x nb:%u\n", bk, key, nb_wkey);
+                                ret = -EINVAL;
+                                break;
+                        }
+                        *nb_p += 1;
+                        continue;
+                }
+
+                if (tbl->flags & DCHT_FLAG_MULTI) {
+                        /* duplicates in the pair or in the chain of the primary */
+                        if (bk != bk_p[i][0] && bk != bk_p[i][1] &&
+                            !in_chain(tbl, bk_p[i][0], bk)) {
+                                TRACER("invalid bk:%p key:%u\n", bk, key);
+                                ret = -EINVAL;
+                                break;
+                        }
+                        *nb_p += 1;
+                        continue;
+                }
+
                 /* hash check */
                 int w = WHICH_ONE_MOST(bk_p[i], key, nb);
                 if (!(w >= 0 && bk == bk_p[i][w] && nb[w] == 1 && nb[(w + 1) & 1] == 0)) {
@@ -1237,6 +4443,86 @@ _bucket_verify_cb (struct dcht_hash_table_s * tbl,
         return ret;
 }
 
+/*
+ * the hint of each bucket must be the number of its keys in their secondary
+ */
+static int
+hint_verify (struct dcht_hash_table_s * tbl)
+{
+        unsigned * nb = calloc(tbl->nb_buckets, sizeof(unsigned));
+        int ret = 0;
+
+        if (!nb)
+                return -ENOMEM;
+
+        for (unsigned b = 0; b < tbl->nb_buckets; b++) {
+                struct dcht_bucket_s * bk = &tbl->buckets[b];
+
+                for (int i = 0; i < (int) DCHT_BUCKET_ENTRY_SZ; i++) {
+                        struct dcht_bucket_s * bk_p[2];
+
+                        if (bk->key[i] == DCHT_SENTINEL_KEY)
+                                continue;
+                        buckets_fetch(tbl, bk_p, bk->key[i]);
+                        if (bk_p[1] == bk)
+                                nb[bk_p[0] - tbl->buckets] += 1;
+                }
+        }
+
+        for (unsigned b = 0; b < tbl->nb_buckets; b++) {
+                uint8_t hint = *bucket_hint(tbl, &tbl->buckets[b]);
+
+                if (hint != HINT_SATURATED && hint != nb[b]) {
+                        TRACER("mismatched hint bk:%u hint:%u nb:%u\n", b, hint, nb[b]);
+                        ret = -1;
+                        break;
+                }
+        }
+        free(nb);
+        return ret;
+}
+
+/*
+ * each entry has its own published record, the others are free
+ */
+static int
+rec_verify (struct dcht_hash_table_s * tbl)
+{
+        unsigned nb_free = tbl->rec_free;
+
+        if (nb_free + tbl->current_entries != tbl->nb_recs ||
+            tbl->rec_head >= tbl->nb_recs || tbl->rec_tail >= tbl->nb_recs ||
+            (tbl->rec_tail + tbl->nb_recs - tbl->rec_head) % tbl->nb_recs != nb_free % tbl->nb_recs) {
+                TRACER("mismatched records free:%u entries:%u head:%u tail:%u\n",
+                       nb_free, tbl->current_entries, tbl->rec_head, tbl->rec_tail);
+                return -1;
+        }
+        for (unsigned b = 0; b < tbl->nb_buckets; b++) {
+                struct dcht_bucket_s * bk = &tbl->buckets[b];
+
+                for (int i = 0; i < (int) DCHT_BUCKET_ENTRY_SZ; i++) {
+                        const struct rec_meta_s * meta;
+
+                        if (bk->key[i] == DCHT_SENTINEL_KEY)
+                                continue;
+                        if (bk->val[i] >= tbl->nb_recs)
+                                return -1;
+                        meta = rec_meta(tbl, bk->val[i]);
+                        if ((meta->seq & 1) || meta->key != bk->key[i]) {
+                                TRACER("bad record key:%u idx:%u\n", bk->key[i], bk->val[i]);
+                                return -1;
+                        }
+                }
+        }
+        for (unsigned n = 0, i = tbl->rec_head; n < nb_free; n++, i = rec_ring_next(tbl, i)) {
+                if (!(rec_meta(tbl, rec_ring(tbl)[i])->seq & 1)) {
+                        TRACER("published record in ring:%u\n", i);
+                        return -1;
+                }
+        }
+        return 0;
+}
+
 int
 dcht_hash_verify (struct dcht_hash_table_s * tbl)
 {
@@ -1250,6 +4536,10 @@ dcht_hash_verify (struct dcht_hash_table_s * tbl)
                         ret = -1;
                 }
         }
+        if (!ret && (tbl->flags & DCHT_FLAG_OVERFLOW_HINT))
+                ret = hint_verify(tbl);
+        if (!ret && (tbl->flags & DCHT_FLAG_VALS_MASK))
+                ret = rec_verify(tbl);
         return ret;
 }
 
@@ -1259,6 +4549,445 @@ dcht_hash_bucket_keys_nb (const struct dcht_bucket_s * bk)
         return DCHT_BUCKET_ENTRY_SZ - NB_KEYS_IN_BUCKET(bk, DCHT_SENTINEL_KEY);
 }
 
+void
+dcht_hash_set_time (struct dcht_hash_table_s * tbl,
+                    uint32_t now)
+{
+        atomic_store_explicit(&tbl->now, now, memory_order_relaxed);
+}
+
+always_inline int
+expire_d (const struct arch_handler_s * drv,
+          struct dcht_hash_table_s * tbl,
+          unsigned nb_buckets,
+          uint32_t deadline,
+          void (*expire_cb)(struct dcht_hash_table_s *,
+                            uint32_t, uint32_t,
+                            void *),
+          void * arg)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        unsigned pos = tbl->sweep_pos;
+        int nb = 0;
+
+        if (!(tbl->flags & DCHT_FLAG_TTL))
+                return -EINVAL;
+        if (nb_buckets > tbl->nb_buckets)
+                nb_buckets = tbl->nb_buckets;
+
+        for (unsigned n = 0; n < nb_buckets; n++) {
+                struct dcht_bucket_s * bk = &tbl->buckets[pos];
+                unsigned mask = EXPIRED_IN_BUCKET_D(drv, bk, bucket_ts(tbl, bk), deadline);
+
+                if (++pos == tbl->nb_buckets)
+                        pos = 0;
+                prefetch(&tbl->buckets[pos]);
+                prefetch(bucket_ts(tbl, &tbl->buckets[pos]));
+
+                while (mask) {
+                        int i = __builtin_ctz(mask);
+                        uint64_t start = 0;
+
+                        if (cap)
+                                start = capture_time();
+
+                        bucket_lock(tbl, bk);
+                        uint32_t key = bk->key[i];
+                        uint32_t val = bk->val[i];
+
+                        del_key(bk, i);
+                        bucket_unlock(tbl, bk);
+                        hint_removed(tbl, bk, key);
+                        gen_bump(tbl, key);
+
+                        /* the replay does not age entries, it deletes them */
+                        if (cap)
+                                capture_record(cap, start, DCHT_CAPTURE_OP_DEL, key, 0, 0);
+
+                        mask &= mask - 1;
+                        assert(tbl->current_entries > 0);
+                        tbl->current_entries -= 1;
+                        nb += 1;
+
+                        /* the callback must not modify the table */
+                        if (expire_cb)
+                                expire_cb(tbl, key, val, arg);
+                }
+        }
+        tbl->sweep_pos = pos;
+
+        TRACER("deadline:%u expired:%d next:%u\n", deadline, nb, pos);
+        return nb;
+}
+
+DRIVER_ENTRY(int, dcht_hash_expire, expire,
+             (struct dcht_hash_table_s * tbl, unsigned nb_buckets, uint32_t deadline,
+              void (*expire_cb)(struct dcht_hash_table_s *, uint32_t, uint32_t, void *),
+              void * arg),
+             tbl, nb_buckets, deadline, expire_cb, arg)
+
+/*
+ * make room in the primary bucket for a hot key, moving its coldest key
+ * living in its primary to a vacancy in its secondary
+ */
+static int
+heat_make_room (struct dcht_hash_table_s * tbl,
+                struct dcht_bucket_s * prim,
+                uint8_t hot)
+{
+        const uint8_t * heat = bucket_heat(tbl, prim);
+        struct dcht_bucket_s * dst = NULL;
+        int cold = -1, dpos = -1;
+
+        for (int i = 0; i < (int) DCHT_BUCKET_ENTRY_SZ; i++) {
+                struct dcht_bucket_s * bk_p[2];
+                int pos;
+
+                if (heat[i] >= hot || (cold >= 0 && heat[i] >= heat[cold]))
+                        continue;
+
+                buckets_fetch(tbl, bk_p, prim->key[i]);
+                if (bk_p[0] != prim || (pos = find_vacancy(bk_p[1])) < 0)
+                        continue;
+
+                cold = i;
+                dst = bk_p[1];
+                dpos = pos;
+        }
+
+        if (cold >= 0) {
+                move_entry(tbl, dst, dpos, prim, cold, prim);
+                NOTIFY_CB(tbl, prim, cold, DCHT_EVENT_MOVED_ENTRY, 1);
+        }
+        return cold;
+}
+
+int
+dcht_hash_rebalance (struct dcht_hash_table_s * tbl,
+                     unsigned nb_buckets,
+                     unsigned threshold)
+{
+        unsigned b = tbl->heat_pos;
+        int nb = 0;
+
+        if (!(tbl->flags & DCHT_FLAG_HOTNESS))
+                return -EINVAL;
+        if (nb_buckets > tbl->nb_buckets)
+                nb_buckets = tbl->nb_buckets;
+
+        for (unsigned n = 0; n < nb_buckets; n++) {
+                struct dcht_bucket_s * bk = &tbl->buckets[b];
+                uint8_t * heat = bucket_heat(tbl, bk);
+
+                if (++b == tbl->nb_buckets)
+                        b = 0;
+                prefetch(&tbl->buckets[b]);
+
+                for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++) {
+                        struct dcht_bucket_s * bk_p[2];
+                        int dpos;
+
+                        if (bk->key[pos] == DCHT_SENTINEL_KEY || heat[pos] < threshold)
+                                continue;
+
+                        /* hot key in its secondary */
+                        buckets_fetch(tbl, bk_p, bk->key[pos]);
+                        if (bk_p[1] != bk)
+                                continue;
+
+                        dpos = find_vacancy(bk_p[0]);
+                        if (dpos < 0) {
+                                dpos = heat_make_room(tbl, bk_p[0], heat[pos]);
+                                if (dpos < 0)
+                                        continue;
+                                nb += 1;
+                        }
+                        move_entry(tbl, bk_p[0], dpos, bk, pos, bk_p[0]);
+                        NOTIFY_CB(tbl, bk, pos, DCHT_EVENT_MOVED_ENTRY, 1);
+                        nb += 1;
+                }
+
+                /* aging */
+                for (int pos = 0; pos < (int) DCHT_BUCKET_ENTRY_SZ; pos++)
+                        heat[pos] >>= 1;
+        }
+        tbl->heat_pos = b;
+
+        TRACER("threshold:%u moved:%d next:%u\n", threshold, nb, b);
+        return nb;
+}
+
+int
+dcht_hash_capture_start (struct dcht_hash_table_s * tbl,
+                         const char * path)
+{
+        struct dcht_capture_hdr_s hdr;
+        struct dcht_capture_s * cap;
+
+        if (tbl->capture)
+                return -EBUSY;
+        /* the capture is process local, readers in other processes would see it */
+        if (tbl->flags & DCHT_FLAG_SHARED)
+                return -ENOTSUP;
+        /* the replay drives the 32 bit single value API only */
+        if (tbl->flags & (DCHT_FLAG_MULTI | DCHT_FLAG_WIDE | DCHT_FLAG_VALS_MASK))
+                return -ENOTSUP;
+
+        cap = calloc(1, sizeof(*cap));
+        if (!cap)
+                return -ENOMEM;
+
+        cap->fp = fopen(path, "w");
+        if (!cap->fp) {
+                int ret = -errno;
+
+                free(cap);
+                return ret;
+        }
+
+        hdr.magic        = DCHT_CAPTURE_MAGIC;
+        hdr.version      = DCHT_CAPTURE_VERSION;
+        hdr.max_entries  = tbl->max_entries;
+        hdr.follow_depth = tbl->follow_depth;
+        hdr.flags        = tbl->flags;
+        hdr.driver       = tbl->driver;
+        if (fwrite(&hdr, sizeof(hdr), 1, cap->fp) != 1) {
+                fclose(cap->fp);
+                free(cap);
+                return -EIO;
+        }
+
+        pthread_mutex_init(&cap->mutex, NULL);
+        cap->last_ns = capture_time();
+
+        atomic_store_explicit(&tbl->capture, cap, memory_order_release);
+        TRACER("capture start:%s\n", path);
+        return 0;
+}
+
+long
+dcht_hash_capture_stop (struct dcht_hash_table_s * tbl)
+{
+        struct dcht_capture_s * cap = tbl->capture;
+        long ret;
+
+        if (!cap)
+                return -ENOENT;
+
+        /* new reader calls skip it, then wait for the ones holding it */
+        atomic_store_explicit(&tbl->capture, NULL, memory_order_seq_cst);
+        while (atomic_load_explicit(&tbl->capture_users, memory_order_seq_cst))
+                cpu_relax();
+
+        pthread_mutex_lock(&cap->mutex);
+        capture_flush(cap);
+        if (fclose(cap->fp) && !cap->err)
+                cap->err = -EIO;
+        ret = cap->err ? cap->err : cap->nb;
+        pthread_mutex_unlock(&cap->mutex);
+
+        pthread_mutex_destroy(&cap->mutex);
+        free(cap);
+
+        TRACER("capture stop:%ld\n", ret);
+        return ret;
+}
+
+/*
+ * RCU table handle
+ * a reader publishes the epoch it entered in its own cacheline and clears it
+ * on exit. the writer swaps the table pointer, advances the epoch, and the old
+ * table is free once no reader is left in an epoch before the swap.
+ */
+#define RCU_DEFER_MAX	16
+
+struct rcu_reader_s {
+        uint64_t epoch;		/* 0: quiescent */
+        bool used;
+} __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+
+struct rcu_defer_s {
+        struct dcht_hash_table_s * tbl;
+        uint64_t epoch;		/* freed when every reader passed it */
+};
+
+struct dcht_hash_rcu_s {
+        struct dcht_hash_table_s * tbl;
+        void (*free_cb)(struct dcht_hash_table_s *);
+
+        uint64_t epoch __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+
+        unsigned nb_defer;
+        struct rcu_defer_s defer[RCU_DEFER_MAX];
+
+        struct rcu_reader_s readers[DCHT_RCU_READERS_MAX];
+};
+
+static void
+rcu_free_default (struct dcht_hash_table_s * tbl)
+{
+        free(tbl);
+}
+
+struct dcht_hash_rcu_s *
+dcht_hash_rcu_create (struct dcht_hash_table_s * tbl,
+                      void (*free_cb)(struct dcht_hash_table_s *))
+{
+        struct dcht_hash_rcu_s * rcu = aligned_alloc(DCHT_CACHELINE_SIZE, sizeof(*rcu));
+
+        if (rcu) {
+                memset(rcu, 0, sizeof(*rcu));
+                rcu->tbl = tbl;
+                rcu->free_cb = free_cb ? free_cb : rcu_free_default;
+                rcu->epoch = 1;
+        }
+        return rcu;
+}
+
+int
+dcht_hash_rcu_reader_register (struct dcht_hash_rcu_s * rcu)
+{
+        for (int id = 0; id < DCHT_RCU_READERS_MAX; id++) {
+                if (!atomic_exchange_explicit(&rcu->readers[id].used, true, memory_order_acq_rel)) {
+                        atomic_store_explicit(&rcu->readers[id].epoch, 0, memory_order_relaxed);
+                        return id;
+                }
+        }
+        return -ENOSPC;
+}
+
+void
+dcht_hash_rcu_reader_unregister (struct dcht_hash_rcu_s * rcu,
+                                 int id)
+{
+        atomic_store_explicit(&rcu->readers[id].epoch, 0, memory_order_release);
+        atomic_store_explicit(&rcu->readers[id].used, false, memory_order_release);
+}
+
+struct dcht_hash_table_s *
+dcht_hash_rcu_read_lock (struct dcht_hash_rcu_s * rcu,
+                         int id)
+{
+        uint64_t epoch = atomic_load_explicit(&rcu->epoch, memory_order_relaxed);
+
+        /* the store must be visible before the table pointer is read */
+        atomic_store_explicit(&rcu->readers[id].epoch, epoch, memory_order_seq_cst);
+        return atomic_load_explicit(&rcu->tbl, memory_order_seq_cst);
+}
+
+void
+dcht_hash_rcu_read_unlock (struct dcht_hash_rcu_s * rcu,
+                           int id)
+{
+        atomic_store_explicit(&rcu->readers[id].epoch, 0, memory_order_release);
+}
+
+/*
+ * true if no reader is in an epoch before the epoch
+ */
+always_inline bool
+rcu_passed (struct dcht_hash_rcu_s * rcu,
+            uint64_t epoch)
+{
+        for (int id = 0; id < DCHT_RCU_READERS_MAX; id++) {
+                uint64_t e = atomic_load_explicit(&rcu->readers[id].epoch, memory_order_seq_cst);
+
+                if (e && e < epoch)
+                        return false;
+        }
+        return true;
+}
+
+struct dcht_hash_table_s *
+dcht_hash_rcu_swap (struct dcht_hash_rcu_s * rcu,
+                    struct dcht_hash_table_s * tbl)
+{
+        struct dcht_hash_table_s * old;
+
+        old = atomic_exchange_explicit(&rcu->tbl, tbl, memory_order_seq_cst);
+        atomic_fetch_add_explicit(&rcu->epoch, 1, memory_order_seq_cst);
+
+        TRACER("swap old:%p new:%p epoch:%"PRIu64"\n", old, tbl, rcu->epoch);
+        return old;
+}
+
+void
+dcht_hash_rcu_synchronize (struct dcht_hash_rcu_s * rcu)
+{
+        uint64_t epoch = atomic_load_explicit(&rcu->epoch, memory_order_seq_cst);
+
+        while (!rcu_passed(rcu, epoch))
+                cpu_relax();
+}
+
+unsigned
+dcht_hash_rcu_reclaim (struct dcht_hash_rcu_s * rcu)
+{
+        unsigned nb = 0;
+
+        for (unsigned i = 0; i < rcu->nb_defer; ) {
+                if (rcu_passed(rcu, rcu->defer[i].epoch)) {
+                        rcu->free_cb(rcu->defer[i].tbl);
+                        rcu->defer[i] = rcu->defer[--rcu->nb_defer];
+                        nb += 1;
+                } else {
+                        i++;
+                }
+        }
+        return nb;
+}
+
+void
+dcht_hash_rcu_defer_free (struct dcht_hash_rcu_s * rcu,
+                          struct dcht_hash_table_s * tbl)
+{
+        if (!tbl)
+                return;
+
+        if (rcu->nb_defer == RCU_DEFER_MAX) {
+                dcht_hash_rcu_synchronize(rcu);
+                dcht_hash_rcu_reclaim(rcu);
+        }
+
+        rcu->defer[rcu->nb_defer].tbl = tbl;
+        rcu->defer[rcu->nb_defer].epoch = atomic_load_explicit(&rcu->epoch, memory_order_seq_cst);
+        rcu->nb_defer += 1;
+
+        dcht_hash_rcu_reclaim(rcu);
+}
+
+int
+dcht_hash_rcu_clean (struct dcht_hash_rcu_s * rcu)
+{
+        struct dcht_hash_table_s * old = rcu->tbl;
+        struct dcht_hash_table_s * tbl;
+
+        if (old->flags & DCHT_FLAG_SHARED)
+                return -ENOTSUP;
+
+        tbl = dcht_hash_table_create_flags(old->max_entries, old->flags);
+        if (!tbl)
+                return -ENOMEM;
+
+        tbl->follow_depth    = old->follow_depth;
+        tbl->event_notify_cb = old->event_notify_cb;
+        tbl->arg             = old->arg;
+        tbl->now             = old->now;
+
+        dcht_hash_rcu_defer_free(rcu, dcht_hash_rcu_swap(rcu, tbl));
+        return 0;
+}
+
+void
+dcht_hash_rcu_destroy (struct dcht_hash_rcu_s * rcu)
+{
+        dcht_hash_rcu_synchronize(rcu);
+        dcht_hash_rcu_reclaim(rcu);
+        if (rcu->tbl)
+                rcu->free_cb(rcu->tbl);
+        free(rcu);
+}
+
 /***************************************************************************
  * unit test
  ***************************************************************************/
@@ -1421,6 +5150,71 @@ dcht_hash_utest (struct dcht_hash_table_s * tbl)
                 return -1;
         }
 
+        /* scan bucket pair test */
+        {
+                struct bucket_scan_s sc;
+
+                BUCKET_INIT(bk_p[0]);
+                BUCKET_INIT(bk_p[1]);
+                key = ~DCHT_SENTINEL_KEY;
+                store_key(bk_p[0], 2, key - 1);
+                store_key(bk_p[1], 0, key - 1);
+                store_key(bk_p[1], 5, key);
+                store_key(bk_p[1], DCHT_BUCKET_ENTRY_SZ - 1, key);
+
+                SCAN_BUCKET_PAIR(bk_p, key, &sc);
+                if (sc.hit[0] || sc.hit[1] != ((1u << 5) | (1u << (DCHT_BUCKET_ENTRY_SZ - 1))) ||
+                    sc.vacant[0] != (((1u << DCHT_BUCKET_ENTRY_SZ) - 1) & ~(1u << 2)) ||
+                    sc.vacant[1] != (((1u << DCHT_BUCKET_ENTRY_SZ) - 1) & ~sc.hit[1] & ~1u)) {
+                        TRACER("failed at scan bucket pair test. hit:%x %x vacant:%x %x\n",
+                               sc.hit[0], sc.hit[1], sc.vacant[0], sc.vacant[1]);
+                        return -1;
+                }
+        }
+
+        /* key match bitmap test */
+        {
+                unsigned mask;
+
+                BUCKET_INIT(bk_p[0]);
+                bk = bk_p[0];
+                key = ~DCHT_SENTINEL_KEY;
+                store_key(bk, 1, key);
+                store_key(bk, 2, key - 1);
+                store_key(bk, 4, key);
+                store_key(bk, DCHT_BUCKET_ENTRY_SZ - 1, key);
+
+                mask = MATCH_IN_BUCKET(bk, key);
+                if (mask != ((1u << 1) | (1u << 4) | (1u << (DCHT_BUCKET_ENTRY_SZ - 1))) ||
+                    MATCH_IN_BUCKET(bk, DCHT_SENTINEL_KEY) != (~mask & ~(1u << 2) & DCHT_BUCKET_FULL)) {
+                        TRACER("failed at key match test. mask:%x\n", mask);
+                        return -1;
+                }
+        }
+
+        /* expired entries test */
+        {
+                uint32_t ts[DCHT_BUCKET_ENTRY_SZ] __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+                unsigned mask;
+
+                BUCKET_INIT(bk_p[0]);
+                bk = bk_p[0];
+                key = ~DCHT_SENTINEL_KEY;
+                for (int i = 0; i < (int) DCHT_BUCKET_ENTRY_SZ; i++)
+                        ts[i] = 100 + i;
+                ts[3] = 0xfffffff0;	/* before deadline across wrap around */
+                store_key(bk, 0, key);
+                store_key(bk, 1, key);
+                store_key(bk, 3, key);
+                store_key(bk, DCHT_BUCKET_ENTRY_SZ - 1, key);
+
+                mask = EXPIRED_IN_BUCKET(bk, ts, 101);
+                if (mask != ((1u << 0) | (1u << 3))) {
+                        TRACER("failed at expired entries test. mask:%x\n", mask);
+                        return -1;
+                }
+        }
+
         dcht_hash_clean(tbl);
 
         TRACER("All Ok.\n\n");
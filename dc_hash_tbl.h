@@ -16,6 +16,10 @@
 #include <stdbool.h>
 #include <errno.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*
  * configuration some parameters
  */
@@ -30,6 +34,29 @@
 #define DCHT_FOLLOW_DEPTH_DEFAULT	3
 #define	DCHT_SENTINEL_KEY		0
 
+/*
+ * table flags (dcht_hash_table_create_flags)
+ */
+#define DCHT_FLAG_TTL			(1u << 0)	/* per entry access timestamp */
+#define DCHT_FLAG_TTL_REFRESH		(1u << 1)	/* dcht_hash_find() refreshes timestamp */
+#define DCHT_FLAG_CACHE			(1u << 2)	/* per entry reference bit, evict on add */
+#define DCHT_FLAG_CACHE_EVICT_ALWAYS	(1u << 3)	/* evict instead of cuckoo replace */
+#define DCHT_FLAG_ATOMIC_VAL		(1u << 4)	/* atomic value operations */
+#define DCHT_FLAG_SHARED		(1u << 5)	/* in shared memory, set by dcht_hash_shm_create() */
+#define DCHT_FLAG_OVERFLOW_HINT		(1u << 6)	/* misses read the primary bucket only */
+#define DCHT_FLAG_HOTNESS		(1u << 7)	/* sampled access counters, hot keys to primary */
+#define DCHT_FLAG_FRONT_GEN		(1u << 8)	/* generation numbers for front caches */
+#define DCHT_FLAG_MULTI			(1u << 9)	/* multimap, values per key in an overflow chain */
+#define DCHT_FLAG_KEY64			(1u << 10)	/* 64 bit keys, dcht_hash_xxx64() */
+#define DCHT_FLAG_KEY128		(1u << 11)	/* 128 bit keys, dcht_hash_xxx128() */
+#define DCHT_FLAG_VALS_SHIFT		12
+#define DCHT_FLAG_VALS_MASK		(7u << DCHT_FLAG_VALS_SHIFT)	/* value store, dcht_hash_xxx_rec() */
+
+/* value store of _size (8 ~ 504) byte records, with the 8 byte header a power of 2 */
+#define DCHT_FLAG_VALS(_size)							\
+        (((_size) <= 8 ? 1u : (_size) <= 24 ? 2u : (_size) <= 56 ? 3u :		\
+          (_size) <= 120 ? 4u : (_size) <= 248 ? 5u : 6u) << DCHT_FLAG_VALS_SHIFT)
+
 
 /*
  * bucket table : must be cacheline size alignment
@@ -42,6 +69,18 @@ struct dcht_bucket_s {
         uint32_t val[DCHT_BUCKET_ENTRY_SZ];
 } __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
 
+/*
+ * atomic operations on the value of an existing key
+ */
+enum dcht_val_op_e {
+        DCHT_VAL_OP_FETCH_ADD = 0,	/* val += arg */
+        DCHT_VAL_OP_SWAP,		/* val = arg */
+        DCHT_VAL_OP_MAX,		/* val = max(val, arg) */
+        DCHT_VAL_OP_MIN,		/* val = min(val, arg) */
+
+        DCHT_VAL_OP_NB,
+};
+
 /*
  * Action event for debug
  */
@@ -52,10 +91,49 @@ enum dcht_event_e {
         DCHT_EVENT_MOVED_ENTRY,
         DCHT_EVENT_CUCKOO_REPLACED,
         DCHT_EVENT_UPDATE_VALUE,
+        DCHT_EVENT_EVICTED,
 
         DCHT_EVENT_NB,
 };
 
+#define DCHT_TABLE_MAGIC		0x54484344	/* "DCHT" */
+
+/*
+ * operation capture file format
+ *   struct dcht_capture_hdr_s, followed by struct dcht_capture_rec_s x N
+ */
+#define DCHT_CAPTURE_MAGIC		0x50414344	/* "DCAP" */
+#define DCHT_CAPTURE_VERSION		3	/* 3: table flags and driver, 32 bit latency */
+
+enum dcht_capture_op_e {
+        DCHT_CAPTURE_OP_FIND = 0,
+        DCHT_CAPTURE_OP_ADD,		/* add, skip_update = false */
+        DCHT_CAPTURE_OP_ADD_UPDATE,	/* add, skip_update = true */
+        DCHT_CAPTURE_OP_DEL,
+        DCHT_CAPTURE_OP_CLEAN,		/* dcht_hash_clean(), key and val are 0 */
+
+        DCHT_CAPTURE_OP_NB,
+};
+
+struct dcht_capture_hdr_s {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t max_entries;
+        int32_t follow_depth;
+        uint32_t flags;		/* DCHT_FLAG_xxx of the table */
+        uint32_t driver;	/* hash driver id of the table */
+};
+
+struct dcht_capture_rec_s {
+        uint32_t key;
+        uint32_t val;		/* added value or found value */
+        uint32_t delta_ns;	/* since the previous record (saturated) */
+        uint32_t lat_ns;	/* latency of the call (saturated) */
+        uint8_t op;		/* enum dcht_capture_op_e */
+        int8_t ret;		/* 0 or negative errno */
+        uint16_t reserved;
+};
+
 /*
  * cuckoo hash table
  */
@@ -72,9 +150,9 @@ struct dcht_hash_table_s {
         int follow_depth;
 
         unsigned retry_hash;		/* for debug, retry hash counter */
-        unsigned _padding;
+        unsigned flags;			/* DCHT_FLAG_xxx */
 
-        /* event notification callback for debug */
+        /* event notification callback for debug, called in the writer process */
         void (*event_notify_cb)(void *,			/* arg */
                                 enum dcht_event_e,	/* event type */
                                 struct dcht_bucket_s *,	/* bucket */
@@ -82,6 +160,43 @@ struct dcht_hash_table_s {
                                 );
         void * arg;
 
+        /* operation capture, NULL when not capturing */
+        struct dcht_capture_s * capture;
+        unsigned capture_users;		/* reader calls holding capture */
+
+        /*
+         * optional areas placed behind the buckets,
+         * offset from the table head
+         */
+        size_t ts_offset;		/* DCHT_FLAG_TTL: timestamps */
+
+        uint32_t now;			/* DCHT_FLAG_TTL: current time */
+        unsigned sweep_pos;		/* DCHT_FLAG_TTL: next bucket to age */
+
+        size_t ref_offset;		/* DCHT_FLAG_CACHE: reference bits */
+        unsigned evict_hand;		/* DCHT_FLAG_CACHE: victim search start */
+
+        size_t lock_offset;		/* DCHT_FLAG_ATOMIC_VAL: bucket locks */
+        size_t hint_offset;		/* DCHT_FLAG_OVERFLOW_HINT: overflow counters */
+        size_t heat_offset;		/* DCHT_FLAG_HOTNESS: access counters */
+        unsigned heat_pos;		/* DCHT_FLAG_HOTNESS: next bucket to rebalance */
+        size_t gen_offset;		/* DCHT_FLAG_FRONT_GEN: striped generation numbers */
+        size_t ovf_offset;		/* DCHT_FLAG_MULTI: overflow buckets */
+        size_t link_offset;		/* DCHT_FLAG_MULTI: overflow chain links */
+        unsigned nb_ovf;		/* DCHT_FLAG_MULTI: number of overflow buckets */
+        unsigned ovf_used;		/* DCHT_FLAG_MULTI: overflow buckets in chains */
+        size_t wkey_offset;		/* DCHT_FLAG_KEY64|KEY128: full keys */
+        size_t rec_offset;		/* DCHT_FLAG_VALS: value records */
+        size_t rec_ring_offset;		/* DCHT_FLAG_VALS: free records, oldest first */
+        unsigned rec_size;		/* DCHT_FLAG_VALS: bytes of a record, without header */
+        unsigned nb_recs;		/* DCHT_FLAG_VALS: number of records */
+        unsigned rec_head;		/* DCHT_FLAG_VALS: next free record in ring */
+        unsigned rec_tail;		/* DCHT_FLAG_VALS: next retired record in ring */
+        unsigned rec_free;		/* DCHT_FLAG_VALS: free records in ring */
+
+        uint32_t magic;			/* DCHT_TABLE_MAGIC */
+        uint32_t driver;		/* hash driver id, the key to bucket mapping depends on it */
+
         struct dcht_bucket_s buckets[] __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
 };
 
@@ -116,6 +231,75 @@ extern int dcht_hash_table_init(struct dcht_hash_table_s * tbl,
  */
 extern struct dcht_hash_table_s * dcht_hash_table_create(unsigned max_entries);
 
+/**
+ * @brief Calculate hash table size with optional areas
+ *
+ * @param max_entries:Maximum registration number
+ * @param flags: DCHT_FLAG_xxx
+ * @return Return used memory size
+ */
+extern size_t dcht_hash_table_size_flags(unsigned max_entries,
+                                         unsigned flags);
+
+/**
+ * @brief Initialize the hash table with optional areas
+ *
+ * @param tbl: hash table pointer(Must be cacheline size algined)
+ * @param size: size of hash table
+ * @param max_entries: Maximum registration number
+ * @param flags: DCHT_FLAG_xxx
+ * @return success then zero, failuer thern negative
+ */
+extern int dcht_hash_table_init_flags(struct dcht_hash_table_s * tbl,
+                                      size_t size,
+                                      unsigned max_entries,
+                                      unsigned flags);
+
+/**
+ * @brief create hash table with optional areas
+ *
+ * @param max_entries: Maximum number that can be registered
+ * @param flags: DCHT_FLAG_xxx
+ * @return created hash table pointer
+ */
+extern struct dcht_hash_table_s * dcht_hash_table_create_flags(unsigned max_entries,
+                                                               unsigned flags);
+
+/**
+ * @brief create hash table in shared memory, the caller is the writer
+ *
+ * @param path: "/name" for a POSIX shared memory object, a file path,
+ *              or NULL for an anonymous memfd
+ * @param max_entries: max entries
+ * @param flags: DCHT_FLAG_xxx
+ * @param fd_p: Pointer to set the file descriptor, it is closed if NULL
+ *              (required for memfd)
+ * @return hash table, NULL on error with errno, EEXIST if path exists
+ */
+extern struct dcht_hash_table_s * dcht_hash_shm_create(const char * path,
+                                                       unsigned max_entries,
+                                                       unsigned flags,
+                                                       int * fd_p);
+
+/**
+ * @brief attach hash table in shared memory created by another process
+ *
+ * @param path: same as dcht_hash_shm_create(), or NULL to use fd
+ * @param fd: file descriptor, used if path is NULL
+ * @return hash table, NULL on error with errno
+ *         (EPROTO on bad table, ENOTSUP on hash driver mismatch)
+ */
+extern struct dcht_hash_table_s * dcht_hash_shm_attach(const char * path,
+                                                       int fd);
+
+/**
+ * @brief detach hash table in shared memory
+ *
+ * @param tbl: hash table
+ * @return success:0 failed:negative
+ */
+extern int dcht_hash_shm_detach(struct dcht_hash_table_s * tbl);
+
 /**
  * @brief release all entries
  *
@@ -173,6 +357,51 @@ extern int dcht_hash_find(struct dcht_hash_table_s * tbl,
                           uint32_t key,
                           uint32_t * val_p);
 
+/*
+ * per reader direct-mapped front cache of hits (DCHT_FLAG_FRONT_GEN)
+ * an entry is valid while the generation of its key stripe is unchanged.
+ * a hit does not reach the table, so the flag excludes DCHT_FLAG_TTL_REFRESH,
+ * DCHT_FLAG_CACHE and DCHT_FLAG_HOTNESS, which update entries on hit.
+ */
+#define DCHT_FRONT_BITS	10
+#define DCHT_FRONT_NB	(1u << DCHT_FRONT_BITS)
+
+struct dcht_front_ent_s {
+        uint32_t key;
+        uint32_t val;
+        uint32_t gen;
+};
+
+struct dcht_front_s {
+        const struct dcht_hash_table_s * tbl;
+        uint64_t hits;
+        struct dcht_front_ent_s ent[DCHT_FRONT_NB];
+} __attribute__ ((aligned(DCHT_CACHELINE_SIZE)));
+
+/**
+ * @brief initialize front cache for a table
+ *
+ * @param front: front cache, owned by one reader thread
+ * @param tbl: hash table
+ * @return void
+ */
+extern void dcht_front_init(struct dcht_front_s * front,
+                            const struct dcht_hash_table_s * tbl);
+
+/**
+ * @brief search key-val through the front cache
+ *
+ * @param tbl: hash table
+ * @param front: front cache of the calling thread
+ * @param key: search key
+ * @param val_p: Pointer to set the read value
+ * @return found key:0 not found:negative
+ */
+extern int dcht_hash_find_front(struct dcht_hash_table_s * tbl,
+                                struct dcht_front_s * front,
+                                uint32_t key,
+                                uint32_t * val_p);
+
 /**
  * @brief add key and value in bucket #0 or #1
  *
@@ -195,20 +424,91 @@ extern int dcht_hash_add_in_buckets(struct dcht_hash_table_s * tbl,
  * @param tbl: hash table
  * @param key: key
  * @param val: value
- * @return success:0 failed:negative
+ * @return success:0 bad key or table:-EINVAL failed:negative
  */
 extern int dcht_hash_add(struct dcht_hash_table_s * tbl,
                          uint32_t key,
                          uint32_t val,
                          bool skip_update);
 
+/**
+ * @brief find key in bucket #0 or #1, add it with the default value if not found
+ *
+ * @param tbl: hash table
+ * @param bk_p: bucket pointer array
+ * @param key: key
+ * @param dflt: value of the added entry
+ * @param val_p: Pointer to set the value found or added
+ * @param added_p: Pointer to set whether the entry was added
+ * @return Returns the bucket number where key was found or added.
+ *         Returns negative if it fails.
+ */
+extern int dcht_hash_find_or_add_in_buckets(struct dcht_hash_table_s * tbl,
+                                            struct dcht_bucket_s ** bk_p,
+                                            uint32_t key,
+                                            uint32_t dflt,
+                                            uint32_t * val_p,
+                                            bool * added_p);
+
+/**
+ * @brief find key in hash table, add it with the default value if not found
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param dflt: value of the added entry
+ * @param val_p: Pointer to set the value found or added
+ * @return found:0 added:1 failed:negative
+ */
+extern int dcht_hash_find_or_add(struct dcht_hash_table_s * tbl,
+                                 uint32_t key,
+                                 uint32_t dflt,
+                                 uint32_t * val_p);
+
+/**
+ * @brief add key and value in bucket #0 or #1, evict the least recently
+ *        referenced entry of both buckets if they are full (DCHT_FLAG_CACHE)
+ *
+ * @param tbl: hash table
+ * @param bk_p: bucket pointer array
+ * @param key: key
+ * @param val: value
+ * @param ev_key_p: evicted key, DCHT_SENTINEL_KEY if nothing was evicted
+ * @param ev_val_p: evicted value
+ * @return Returns the bucket number that was successfully added.
+ *         Returns negative if it fails.
+ */
+extern int dcht_hash_add_evict_in_buckets(struct dcht_hash_table_s * tbl,
+                                          struct dcht_bucket_s ** bk_p,
+                                          uint32_t key,
+                                          uint32_t val,
+                                          uint32_t * ev_key_p,
+                                          uint32_t * ev_val_p);
+
+/**
+ * @brief add or update key and value in hash table,
+ *        evict an entry if there is no space (DCHT_FLAG_CACHE)
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param val: value
+ * @param ev_key_p: evicted key, DCHT_SENTINEL_KEY if nothing was evicted
+ * @param ev_val_p: evicted value
+ * @return success:0 failed:negative
+ */
+extern int dcht_hash_add_evict(struct dcht_hash_table_s * tbl,
+                               uint32_t key,
+                               uint32_t val,
+                               uint32_t * ev_key_p,
+                               uint32_t * ev_val_p);
+
 /**
  * @brief delete key in hash table
  *
  * @param tbl: hash taable
  * @param bk_p: bucket pointer array
  * @param key: deleting key
- * @return Returns the bucket number that was successfully deleted.
+ * @return Returns the bucket number that was successfully deleted,
+ *         2 for the overflow chain (DCHT_FLAG_MULTI).
  *         Returns negative if not found key.
  */
 extern int dcht_hash_del_in_buckets(struct dcht_hash_table_s * tbl,
@@ -225,6 +525,394 @@ extern int dcht_hash_del_in_buckets(struct dcht_hash_table_s * tbl,
 extern int dcht_hash_del(struct dcht_hash_table_s * tbl,
                          uint32_t key);
 
+/*
+ * multimap (DCHT_FLAG_MULTI)
+ * a key has any number of values, in its buckets pair and then in the overflow
+ * chain of its primary bucket. dcht_hash_find() returns one of them.
+ * dcht_hash_add() and dcht_hash_find_or_add() return -EINVAL on these tables.
+ */
+
+/**
+ * @brief add a key-value pair
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param val: value
+ * @return success:0 pair exists:-EEXIST no space:-ENOSPC
+ */
+extern int dcht_hash_multi_add(struct dcht_hash_table_s * tbl,
+                               uint32_t key,
+                               uint32_t val);
+
+/**
+ * @brief search all values of key
+ *
+ * @param tbl: hash table
+ * @param key: search key
+ * @param vals: values array to set the read values
+ * @param nb_max: size of vals
+ * @return number of values of key, only nb_max of them are set if more
+ */
+extern unsigned dcht_hash_multi_find(struct dcht_hash_table_s * tbl,
+                                     uint32_t key,
+                                     uint32_t * vals,
+                                     unsigned nb_max);
+
+/**
+ * @brief delete a key-value pair
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param val: value
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_multi_del(struct dcht_hash_table_s * tbl,
+                               uint32_t key,
+                               uint32_t val);
+
+/*
+ * wide keys (DCHT_FLAG_KEY64, DCHT_FLAG_KEY128)
+ * the bucket holds a 32 bit tag of the key, the full key is in the same
+ * slot of a key array behind the buckets. a hit reads the bucket and the
+ * cacheline of its full key. any key value is valid, tags may collide.
+ * the 32 bit key API returns -EINVAL on these tables, except the ones
+ * without the table (dcht_hash_find_in_buckets()).
+ */
+struct dcht_key128_s {
+        uint64_t w[2];
+};
+
+/**
+ * @brief add 64 bit key and value (DCHT_FLAG_KEY64)
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param val: value
+ * @param skip_update: update the value if key exists
+ * @return success:0 exists:-EEXIST no space:-ENOSPC
+ */
+extern int dcht_hash_add64(struct dcht_hash_table_s * tbl,
+                           uint64_t key,
+                           uint32_t val,
+                           bool skip_update);
+
+/**
+ * @brief search 64 bit key (DCHT_FLAG_KEY64)
+ *
+ * @param tbl: hash table
+ * @param key: search key
+ * @param val_p: Pointer to set the read value
+ * @return found key:0 not found:negative
+ */
+extern int dcht_hash_find64(struct dcht_hash_table_s * tbl,
+                            uint64_t key,
+                            uint32_t * val_p);
+
+/**
+ * @brief delete 64 bit key (DCHT_FLAG_KEY64)
+ *
+ * @param tbl: hash table
+ * @param key: deleting key
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_del64(struct dcht_hash_table_s * tbl,
+                           uint64_t key);
+
+/**
+ * @brief add 128 bit key and value (DCHT_FLAG_KEY128)
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param val: value
+ * @param skip_update: update the value if key exists
+ * @return success:0 exists:-EEXIST no space:-ENOSPC
+ */
+extern int dcht_hash_add128(struct dcht_hash_table_s * tbl,
+                            const struct dcht_key128_s * key,
+                            uint32_t val,
+                            bool skip_update);
+
+/**
+ * @brief search 128 bit key (DCHT_FLAG_KEY128)
+ *
+ * @param tbl: hash table
+ * @param key: search key
+ * @param val_p: Pointer to set the read value
+ * @return found key:0 not found:negative
+ */
+extern int dcht_hash_find128(struct dcht_hash_table_s * tbl,
+                             const struct dcht_key128_s * key,
+                             uint32_t * val_p);
+
+/**
+ * @brief delete 128 bit key (DCHT_FLAG_KEY128)
+ *
+ * @param tbl: hash table
+ * @param key: deleting key
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_del128(struct dcht_hash_table_s * tbl,
+                            const struct dcht_key128_s * key);
+
+/**
+ * @brief full key of an entry, for dcht_hash_bk_walk() callbacks
+ *
+ * @param tbl: hash table
+ * @param bk: bucket
+ * @param pos: entry position in bk
+ * @return 1 or 2 words of the key, NULL if the table has no wide keys
+ */
+extern const uint64_t * dcht_hash_entry_wkey(const struct dcht_hash_table_s * tbl,
+                                             const struct dcht_bucket_s * bk,
+                                             int pos);
+
+/*
+ * value store (DCHT_FLAG_VALS)
+ * the value of a slot is the index of a record in a slab owned by the table.
+ * an update writes a new record, a deleted or replaced record is reused
+ * after the records retired before it. a record has a sequence number, a
+ * reader checks it after reading the record.
+ * the 32 bit add, find_or_add and value APIs return -EINVAL on these tables,
+ * dcht_hash_del() releases the record.
+ */
+
+/**
+ * @brief add key and a copy of its record
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param rec: record
+ * @param len: bytes of rec, up to tbl->rec_size
+ * @param skip_update: replace the record if key exists
+ * @return success:0 exists:-EEXIST no space:-ENOSPC bad table or len:-EINVAL
+ */
+extern int dcht_hash_add_rec(struct dcht_hash_table_s * tbl,
+                             uint32_t key,
+                             const void * rec,
+                             size_t len,
+                             bool skip_update);
+
+/**
+ * @brief search record of key
+ *
+ * @param tbl: hash table
+ * @param key: search key
+ * @param seq_p: Pointer to set the sequence number of the record
+ * @return record, NULL if not found
+ */
+extern const void * dcht_hash_find_rec(struct dcht_hash_table_s * tbl,
+                                       uint32_t key,
+                                       uint32_t * seq_p);
+
+/**
+ * @brief search records of keys, each record is prefetched once its key is found
+ *        and checked DCHT_BULK_AHEAD keys later
+ *
+ * @param tbl: hash table
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param recs: array to set the records, NULL if not found
+ * @param seqs: array to set the sequence numbers
+ * @return number of keys found
+ */
+extern unsigned dcht_hash_find_rec_bulk(struct dcht_hash_table_s * tbl,
+                                        const uint32_t * keys,
+                                        unsigned nb,
+                                        const void ** recs,
+                                        uint32_t * seqs);
+
+/**
+ * @brief check that the record was not reused after it was found
+ *
+ * @param tbl: hash table
+ * @param rec: found record
+ * @param seq: sequence number of the record when found
+ * @return true if what was read of the record is valid
+ */
+extern bool dcht_hash_rec_stable(const struct dcht_hash_table_s * tbl,
+                                 const void * rec,
+                                 uint32_t seq);
+
+/*
+ * bulk operations: number of operations the bucket prefetch runs ahead
+ */
+#ifndef DCHT_BULK_AHEAD
+# define DCHT_BULK_AHEAD	8
+#endif
+
+/**
+ * @brief search keys in hash table, with bucket prefetch running ahead
+ *
+ * @param tbl: hash table
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param vals: values array to set the read values
+ * @param ret: status array, found:0 not found:-ENOENT (may be NULL)
+ * @return number of keys found
+ */
+extern unsigned dcht_hash_find_bulk(struct dcht_hash_table_s * tbl,
+                                    const uint32_t * keys,
+                                    unsigned nb,
+                                    uint32_t * vals,
+                                    int * ret);
+
+/**
+ * @brief add keys and values in hash table, with bucket prefetch running ahead
+ *
+ * @param tbl: hash table
+ * @param keys: keys array
+ * @param vals: values array
+ * @param nb: number of keys
+ * @param skip_update: update the value if key exists
+ * @param ret: status array, success:0 failed:negative (may be NULL)
+ * @return number of keys added or updated
+ */
+extern unsigned dcht_hash_add_bulk(struct dcht_hash_table_s * tbl,
+                                   const uint32_t * keys,
+                                   const uint32_t * vals,
+                                   unsigned nb,
+                                   bool skip_update,
+                                   int * ret);
+
+/**
+ * @brief delete keys in hash table, with bucket prefetch running ahead
+ *
+ * @param tbl: hash table
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param ret: status array, success:0 not found:-ENOENT (may be NULL)
+ * @return number of keys deleted
+ */
+extern unsigned dcht_hash_del_bulk(struct dcht_hash_table_s * tbl,
+                                   const uint32_t * keys,
+                                   unsigned nb,
+                                   int * ret);
+
+#define DCHT_CASCADE_MAX	8	/* max tables of a cascade */
+
+/**
+ * @brief search keys in a cascade of tables in priority order, with the
+ *        buckets of all tables prefetched ahead
+ *
+ * @param tbls: tables array, the first one has the highest priority
+ * @param nb_tbls: number of tables (1 to DCHT_CASCADE_MAX)
+ * @param keys: keys array
+ * @param nb: number of keys
+ * @param vals: values array to set the value of the first hit
+ * @param idx: array to set the table index of the first hit, -ENOENT if not found
+ * @return number of keys found, -EINVAL on invalid number of tables
+ */
+extern int dcht_hash_find_cascade(struct dcht_hash_table_s ** tbls,
+                                  unsigned nb_tbls,
+                                  const uint32_t * keys,
+                                  unsigned nb,
+                                  uint32_t * vals,
+                                  int * idx);
+
+/*
+ * asynchronous memory access chaining (AMAC) engine
+ */
+#define DCHT_AMAC_WIDTH_MAX	32	/* max in-flight operations */
+
+enum dcht_amac_op_e {
+        DCHT_AMAC_OP_FIND = 0,
+        DCHT_AMAC_OP_ADD,
+        DCHT_AMAC_OP_ADD_UPDATE,
+        DCHT_AMAC_OP_DEL,
+
+        DCHT_AMAC_OP_NB,
+};
+
+struct dcht_amac_req_s {
+        uint32_t key;
+        uint32_t val;		/* value to add, or the value found */
+        enum dcht_amac_op_e op;
+        int ret;		/* success:0 failed:negative */
+};
+
+/**
+ * @brief run a stream of mixed operations with up to width of them in flight.
+ *        the operations on the same key complete in the stream order.
+ *
+ * @param tbl: hash table
+ * @param reqs: operations array
+ * @param nb: number of operations
+ * @param width: number of in-flight operations (1 to DCHT_AMAC_WIDTH_MAX)
+ * @return number of succeeded operations
+ */
+extern unsigned dcht_hash_amac_run(struct dcht_hash_table_s * tbl,
+                                   struct dcht_amac_req_s * reqs,
+                                   unsigned nb,
+                                   unsigned width);
+
+/**
+ * @brief atomic operation on the value of key in bucket #0 or #1
+ *        (DCHT_FLAG_ATOMIC_VAL, any thread)
+ *
+ * @param tbl: hash table
+ * @param bk_p: bucket pointer array
+ * @param key: key
+ * @param op: operation
+ * @param arg: operand
+ * @param old_p: Pointer to set the value before the operation (may be NULL)
+ * @return Returns the bucket number where key was found.
+ *         Returns negative if not found.
+ */
+extern int dcht_hash_val_op_in_buckets(struct dcht_hash_table_s * tbl,
+                                       struct dcht_bucket_s ** bk_p,
+                                       uint32_t key,
+                                       enum dcht_val_op_e op,
+                                       uint32_t arg,
+                                       uint32_t * old_p);
+
+/**
+ * @brief atomic operation on the value of key (DCHT_FLAG_ATOMIC_VAL, any thread)
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param op: operation
+ * @param arg: operand
+ * @param old_p: Pointer to set the value before the operation (may be NULL)
+ * @return success:0 not found:-ENOENT
+ */
+extern int dcht_hash_val_op(struct dcht_hash_table_s * tbl,
+                            uint32_t key,
+                            enum dcht_val_op_e op,
+                            uint32_t arg,
+                            uint32_t * old_p);
+
+/**
+ * @brief compare and exchange the value of key in bucket #0 or #1
+ *        (DCHT_FLAG_ATOMIC_VAL, any thread)
+ *
+ * @param tbl: hash table
+ * @param bk_p: bucket pointer array
+ * @param key: key
+ * @param expected_p: expected value, set to the current value on mismatch
+ * @param desired: new value
+ * @return Returns the bucket number where the value was exchanged.
+ *         -EAGAIN on mismatch, -ENOENT if not found.
+ */
+extern int dcht_hash_val_cas_in_buckets(struct dcht_hash_table_s * tbl,
+                                        struct dcht_bucket_s ** bk_p,
+                                        uint32_t key,
+                                        uint32_t * expected_p,
+                                        uint32_t desired);
+
+/**
+ * @brief compare and exchange the value of key (DCHT_FLAG_ATOMIC_VAL, any thread)
+ *
+ * @param tbl: hash table
+ * @param key: key
+ * @param expected_p: expected value, set to the current value on mismatch
+ * @param desired: new value
+ * @return success:0 mismatch:-EAGAIN not found:-ENOENT
+ */
+extern int dcht_hash_val_cas(struct dcht_hash_table_s * tbl,
+                             uint32_t key,
+                             uint32_t * expected_p,
+                             uint32_t desired);
+
 /**
  * @brief walk bucket in hash table entries
  *
@@ -255,6 +943,180 @@ extern int dcht_hash_walk(struct dcht_hash_table_s * tbl,
                                          void *),
                           void * arg);
 
+/**
+ * @brief set the current time stamped on added, updated and found entries
+ *        (DCHT_FLAG_TTL)
+ *
+ * @param tbl: hash table pointer
+ * @param now: current time in any unit, wraps around
+ * @return void
+ */
+extern void dcht_hash_set_time(struct dcht_hash_table_s * tbl,
+                               uint32_t now);
+
+/**
+ * @brief age a bounded number of buckets, delete entries not accessed since deadline
+ *        (DCHT_FLAG_TTL, writer thread)
+ *
+ * @param tbl: hash table pointer
+ * @param nb_buckets: number of buckets to walk from the previous position
+ * @param deadline: entries with a timestamp before deadline are expired
+ * @param expire_cb: called with each deleted entry (may be NULL)
+ * @param arg: any argument to expire_cb
+ * @return number of expired entries, negative on error
+ */
+extern int dcht_hash_expire(struct dcht_hash_table_s * tbl,
+                            unsigned nb_buckets,
+                            uint32_t deadline,
+                            void (*expire_cb)(struct dcht_hash_table_s *,
+                                              uint32_t key,
+                                              uint32_t val,
+                                              void *),
+                            void * arg);
+
+/**
+ * @brief walk a bounded number of buckets, move hot keys living in their secondary
+ *        bucket into their primary, and halve the access counters
+ *        (DCHT_FLAG_HOTNESS, writer thread)
+ *
+ * @param tbl: hash table pointer
+ * @param nb_buckets: number of buckets to walk from the previous position
+ * @param threshold: access counter of hot keys
+ * @return number of moved entries, negative on error
+ */
+extern int dcht_hash_rebalance(struct dcht_hash_table_s * tbl,
+                               unsigned nb_buckets,
+                               unsigned threshold);
+
+/**
+ * @brief start capturing find/add/del calls into a file
+ *
+ * @param tbl: hash table pointer
+ * @param path: capture file path (truncated)
+ * @return success then zero, failuer then negative,
+ *         -ENOTSUP on shared, multimap, wide key and value store tables
+ */
+extern int dcht_hash_capture_start(struct dcht_hash_table_s * tbl,
+                                   const char * path);
+
+/**
+ * @brief stop capturing and close the capture file
+ * waits for the reader calls still recording into it
+ *
+ * @param tbl: hash table pointer
+ * @return success then number of captured records, failuer then negative
+ */
+extern long dcht_hash_capture_stop(struct dcht_hash_table_s * tbl);
+
+/*
+ * RCU table handle: atomically swappable table pointer with epoch based
+ * reader quiescence. readers use their own registered slot, never shared writes.
+ */
+#define DCHT_RCU_READERS_MAX	64
+
+struct dcht_hash_rcu_s;
+
+/**
+ * @brief create RCU handle
+ *
+ * @param tbl: initial table
+ * @param free_cb: table destructor, free() if NULL
+ * @return handle, NULL on no memory
+ */
+extern struct dcht_hash_rcu_s * dcht_hash_rcu_create(struct dcht_hash_table_s * tbl,
+                                                     void (*free_cb)(struct dcht_hash_table_s *));
+
+/**
+ * @brief destroy RCU handle, waiting for readers and freeing all tables
+ *
+ * @param rcu: handle
+ * @return void
+ */
+extern void dcht_hash_rcu_destroy(struct dcht_hash_rcu_s * rcu);
+
+/**
+ * @brief register a reader thread
+ *
+ * @param rcu: handle
+ * @return reader id, -ENOSPC if DCHT_RCU_READERS_MAX readers are registered
+ */
+extern int dcht_hash_rcu_reader_register(struct dcht_hash_rcu_s * rcu);
+
+/**
+ * @brief unregister a reader thread
+ *
+ * @param rcu: handle
+ * @param id: reader id
+ * @return void
+ */
+extern void dcht_hash_rcu_reader_unregister(struct dcht_hash_rcu_s * rcu,
+                                            int id);
+
+/**
+ * @brief enter read side critical section
+ *
+ * @param rcu: handle
+ * @param id: reader id
+ * @return current table, valid until dcht_hash_rcu_read_unlock()
+ */
+extern struct dcht_hash_table_s * dcht_hash_rcu_read_lock(struct dcht_hash_rcu_s * rcu,
+                                                          int id);
+
+/**
+ * @brief exit read side critical section
+ *
+ * @param rcu: handle
+ * @param id: reader id
+ * @return void
+ */
+extern void dcht_hash_rcu_read_unlock(struct dcht_hash_rcu_s * rcu,
+                                      int id);
+
+/**
+ * @brief publish a new table (writer)
+ *
+ * @param rcu: handle
+ * @param tbl: new table
+ * @return old table, still referenced by readers until a grace period
+ */
+extern struct dcht_hash_table_s * dcht_hash_rcu_swap(struct dcht_hash_rcu_s * rcu,
+                                                     struct dcht_hash_table_s * tbl);
+
+/**
+ * @brief wait until no reader references a table swapped out before (writer)
+ *
+ * @param rcu: handle
+ * @return void
+ */
+extern void dcht_hash_rcu_synchronize(struct dcht_hash_rcu_s * rcu);
+
+/**
+ * @brief free table after a grace period, without waiting (writer)
+ *
+ * @param rcu: handle
+ * @param tbl: swapped out table
+ * @return void
+ */
+extern void dcht_hash_rcu_defer_free(struct dcht_hash_rcu_s * rcu,
+                                     struct dcht_hash_table_s * tbl);
+
+/**
+ * @brief free the deferred tables no reader references any more (writer)
+ *
+ * @param rcu: handle
+ * @return number of freed tables
+ */
+extern unsigned dcht_hash_rcu_reclaim(struct dcht_hash_rcu_s * rcu);
+
+/**
+ * @brief release all entries, safe against concurrent readers (writer)
+ *        an empty table replaces the current one, which is freed later
+ *
+ * @param rcu: handle
+ * @return success:0 no memory:-ENOMEM shared table:-ENOTSUP
+ */
+extern int dcht_hash_rcu_clean(struct dcht_hash_rcu_s * rcu);
+
 /**
  * @brief Unit Test in hash table
  *
@@ -270,4 +1132,8 @@ extern unsigned dcht_hash_bucket_keys_nb(const struct dcht_bucket_s * bk);
 
 extern int dcht_hash_verify(struct dcht_hash_table_s * tbl);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif	/* !_DC_HASH_TBL_H_ */
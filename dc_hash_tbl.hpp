@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * cuckoo hash table, C++17 header only template
+ * (1) single writer thread, multi reader thread.
+ * (2) lock free
+ * (3) hash and bucket compare chosen at compile time, inlined into the caller
+ * (4) Zero cannot be used for Key
+ */
+
+#ifndef _DC_HASH_TBL_HPP_
+#define _DC_HASH_TBL_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__)
+# include <immintrin.h>
+#endif	/* __x86_64__ */
+
+namespace dcht {
+
+constexpr std::size_t cacheline_size = 64;
+constexpr std::size_t line_pair_size = 128;	/* the unit of the adjacent line prefetcher */
+constexpr int follow_depth_default = 3;
+constexpr std::size_t bulk_ahead = 8;
+
+/*****************************************************************************
+ * hash policies
+ * 64 bit result, the low half selects the primary, the high half the secondary
+ *****************************************************************************/
+struct hash_mul {
+        template <typename Key>
+        uint64_t operator()(Key key) const noexcept {
+                uint64_t h = static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ull;
+
+                h ^= h >> 29;
+                h *= 0xbf58476d1ce4e5b9ull;
+                h ^= h >> 32;
+                return h;
+        }
+};
+
+#if defined(__SSE4_2__)
+struct hash_crc32 {
+        /* keys narrower than 32 bits are hashed as 32 bit ones */
+        template <typename Key>
+        uint64_t operator()(Key key) const noexcept {
+                if constexpr (sizeof(Key) <= sizeof(uint32_t)) {
+                        uint32_t k = static_cast<uint32_t>(key);
+                        uint32_t x = _mm_crc32_u32(0xdeadbeef, k);
+                        uint32_t y = _mm_crc32_u32(x, __builtin_bswap32(k));
+
+                        return (static_cast<uint64_t>(y) << 32) | x;
+                } else {
+                        uint64_t k = static_cast<uint64_t>(key);
+                        uint32_t x = static_cast<uint32_t>(_mm_crc32_u64(0xdeadbeef, k));
+                        uint32_t y = static_cast<uint32_t>(_mm_crc32_u64(x, __builtin_bswap64(k)));
+
+                        return (static_cast<uint64_t>(y) << 32) | x;
+                }
+        }
+};
+
+using hash_default = hash_crc32;
+#else	/* !__SSE4_2__ */
+using hash_default = hash_mul;
+#endif	/* !__SSE4_2__ */
+
+/*****************************************************************************
+ * bucket compare policies
+ * match<Key, Slots>() returns the bitmap of the slots having key,
+ * keys is aligned to the bucket
+ *****************************************************************************/
+struct simd_generic {
+        template <typename Key, unsigned Slots>
+        static unsigned match(const Key * keys, Key key) noexcept {
+                unsigned mask = 0;
+
+                for (unsigned i = 0; i < Slots; i++)
+                        mask |= static_cast<unsigned>(keys[i] == key) << i;
+                return mask;
+        }
+};
+
+#if defined(__SSE2__)
+struct simd_sse2 {
+        template <typename Key, unsigned Slots>
+        static unsigned match(const Key * keys, Key key) noexcept {
+                constexpr unsigned lanes = 16 / sizeof(Key);
+
+                if constexpr (Slots % lanes) {
+                        return simd_generic::match<Key, Slots>(keys, key);
+                } else if constexpr (sizeof(Key) == sizeof(uint32_t)) {
+                        const __m128i k = _mm_set1_epi32(static_cast<int>(key));
+                        unsigned mask = 0;
+
+                        for (unsigned i = 0; i < Slots / lanes; i++) {
+                                __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(&keys[i * lanes]));
+                                __m128i c = _mm_cmpeq_epi32(v, k);
+
+                                mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(c))) << (i * lanes);
+                        }
+                        return mask;
+#if defined(__SSE4_1__)
+                } else if constexpr (sizeof(Key) == sizeof(uint64_t)) {
+                        const __m128i k = _mm_set1_epi64x(static_cast<long long>(key));
+                        unsigned mask = 0;
+
+                        for (unsigned i = 0; i < Slots / lanes; i++) {
+                                __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(&keys[i * lanes]));
+                                __m128i c = _mm_cmpeq_epi64(v, k);
+
+                                mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(c))) << (i * lanes);
+                        }
+                        return mask;
+#endif	/* __SSE4_1__ */
+                } else {
+                        return simd_generic::match<Key, Slots>(keys, key);
+                }
+        }
+};
+#endif	/* __SSE2__ */
+
+#if defined(__AVX2__)
+struct simd_avx2 {
+        template <typename Key, unsigned Slots>
+        static unsigned match(const Key * keys, Key key) noexcept {
+                constexpr unsigned lanes = 32 / sizeof(Key);
+
+                if constexpr ((sizeof(Key) != sizeof(uint32_t) && sizeof(Key) != sizeof(uint64_t)) ||
+                              Slots % lanes) {
+                        return simd_sse2::match<Key, Slots>(keys, key);
+                } else {
+                        unsigned mask = 0;
+
+                        for (unsigned i = 0; i < Slots / lanes; i++) {
+                                __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(&keys[i * lanes]));
+
+                                if constexpr (sizeof(Key) == sizeof(uint32_t)) {
+                                        __m256i c = _mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(key)));
+
+                                        mask |= static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(c))) << (i * lanes);
+                                } else {
+                                        __m256i c = _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(static_cast<long long>(key)));
+
+                                        mask |= static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(c))) << (i * lanes);
+                                }
+                        }
+                        return mask;
+                }
+        }
+};
+
+#if defined(__AVX512F__)
+/*
+ * 16 x 32 bit or 8 x 64 bit keys, a 128 byte bucket of 32 bit keys and values in one compare
+ */
+struct simd_avx512 {
+        template <typename Key, unsigned Slots>
+        static unsigned match(const Key * keys, Key key) noexcept {
+                constexpr unsigned lanes = 64 / sizeof(Key);
+
+                if constexpr ((sizeof(Key) != sizeof(uint32_t) && sizeof(Key) != sizeof(uint64_t)) ||
+                              Slots % lanes) {
+                        return simd_avx2::match<Key, Slots>(keys, key);
+                } else {
+                        unsigned mask = 0;
+
+                        for (unsigned i = 0; i < Slots / lanes; i++) {
+                                __m512i v = _mm512_load_si512(&keys[i * lanes]);
+
+                                if constexpr (sizeof(Key) == sizeof(uint32_t))
+                                        mask |= static_cast<unsigned>(_mm512_cmpeq_epi32_mask(v, _mm512_set1_epi32(static_cast<int>(key)))) << (i * lanes);
+                                else
+                                        mask |= static_cast<unsigned>(_mm512_cmpeq_epi64_mask(v, _mm512_set1_epi64(static_cast<long long>(key)))) << (i * lanes);
+                        }
+                        return mask;
+                }
+        }
+};
+
+using simd_default = simd_avx512;
+#else	/* !__AVX512F__ */
+using simd_default = simd_avx2;
+#endif	/* !__AVX512F__ */
+#elif defined(__SSE2__)
+using simd_default = simd_sse2;
+#else
+using simd_default = simd_generic;
+#endif
+
+/*
+ * bucket : aligned to its size up to a line pair,
+ * a bucket of up to 64 bytes never crosses a cacheline, a larger one is one line pair
+ */
+constexpr std::size_t
+bucket_align(std::size_t size)
+{
+        std::size_t align = 16;
+
+        while (align < size && align < line_pair_size)
+                align <<= 1;
+        return align;
+}
+
+template <typename Key, typename Val, unsigned Slots>
+struct alignas(bucket_align(Slots * (sizeof(Key) + sizeof(Val)))) bucket {
+        std::atomic<Key> key[Slots];
+        std::atomic<Val> val[Slots];
+};
+
+/*****************************************************************************
+ * table
+ * SlotsPerBucket: with the key and value sizes, the bucket geometry.
+ *   4 x 32 bit: 32 bytes, 8: a 64 byte cacheline, 16: a 128 byte line pair
+ * NbBuckets: zero sizes the table at run time, a power of 2 fixes the mask
+ *****************************************************************************/
+template <typename Key = uint32_t,
+          typename Val = uint32_t,
+          unsigned SlotsPerBucket = 8,
+          typename Hash = hash_default,
+          typename Simd = simd_default,
+          std::size_t NbBuckets = 0>
+class table {
+        static_assert(std::is_integral_v<Key> && std::is_unsigned_v<Key>, "Key must be unsigned integral");
+        static_assert(std::atomic<Key>::is_always_lock_free && sizeof(std::atomic<Key>) == sizeof(Key),
+                      "Key must be a lock free atomic");
+        static_assert(std::atomic<Val>::is_always_lock_free, "Val must be a lock free atomic");
+        static_assert(SlotsPerBucket >= 1 && SlotsPerBucket <= 32, "1 ~ 32 slots per bucket");
+        static_assert(NbBuckets == 0 || (NbBuckets >= 2 && !(NbBuckets & (NbBuckets - 1))),
+                      "NbBuckets must be a power of 2");
+
+public:
+        using key_type = Key;
+        using mapped_type = Val;
+        using bucket_type = bucket<Key, Val, SlotsPerBucket>;
+
+        static constexpr Key sentinel = 0;
+        static constexpr unsigned slots = SlotsPerBucket;
+        static constexpr std::size_t bucket_size = sizeof(bucket_type);
+
+        /*
+         * max_entries is ignored if NbBuckets is set
+         */
+        explicit table(std::size_t max_entries = NbBuckets * SlotsPerBucket) {
+                nb_buckets_ = NbBuckets ? NbBuckets : nb_buckets_for(max_entries);
+                buckets_ = static_cast<bucket_type *>(::operator new(sizeof(bucket_type) * nb_buckets_,
+                                                                     std::align_val_t(table_align)));
+                for (std::size_t i = 0; i < nb_buckets_; i++)
+                        new (&buckets_[i]) bucket_type;
+                clear();
+        }
+
+        ~table() {
+                release();
+        }
+
+        table(const table &) = delete;
+        table & operator=(const table &) = delete;
+
+        table(table && other) noexcept
+                : buckets_(std::exchange(other.buckets_, nullptr)),
+                  nb_buckets_(std::exchange(other.nb_buckets_, 0)),
+                  current_entries_(std::exchange(other.current_entries_, 0)),
+                  follow_depth_(other.follow_depth_) {
+        }
+
+        table & operator=(table && other) noexcept {
+                if (this != &other) {
+                        release();
+                        buckets_ = std::exchange(other.buckets_, nullptr);
+                        nb_buckets_ = std::exchange(other.nb_buckets_, 0);
+                        current_entries_ = std::exchange(other.current_entries_, 0);
+                        follow_depth_ = other.follow_depth_;
+                }
+                return *this;
+        }
+
+        std::size_t size() const noexcept { return current_entries_; }
+        std::size_t capacity() const noexcept { return nb_buckets_ * SlotsPerBucket; }
+        std::size_t bytes() const noexcept { return nb_buckets_ * sizeof(bucket_type); }
+        void set_follow_depth(int depth) noexcept { follow_depth_ = depth; }
+
+        /**
+         * @brief release all keys (writer thread)
+         */
+        void clear() noexcept {
+                for (std::size_t i = 0; i < nb_buckets_; i++) {
+                        for (unsigned pos = 0; pos < SlotsPerBucket; pos++)
+                                buckets_[i].key[pos].store(sentinel, std::memory_order_release);
+                }
+                current_entries_ = 0;
+        }
+
+        /**
+         * @brief search key (reader thread)
+         *
+         * @return true if found, the value is set to val
+         */
+        bool find(Key key, Val & val) const noexcept {
+                bucket_type * bk[2];
+
+                fetch(key, bk);
+                return find_in_buckets(bk, key, val);
+        }
+
+        /**
+         * @brief search keys, with bucket prefetch running ahead (reader thread)
+         *
+         * @param found: array to set the results (may be nullptr)
+         * @return number of keys found
+         */
+        std::size_t find_bulk(const Key * keys, std::size_t nb, Val * vals, bool * found = nullptr) const noexcept {
+                bucket_type * ring[bulk_ahead][2];
+                std::size_t done = 0;
+
+                for (std::size_t i = 0; i < nb && i < bulk_ahead; i++)
+                        fetch(keys[i], ring[i]);
+                for (std::size_t i = 0; i < nb; i++) {
+                        bucket_type ** slot = ring[i % bulk_ahead];
+                        bucket_type * bk[2] = { slot[0], slot[1] };
+                        bool hit;
+
+                        if (i + bulk_ahead < nb)
+                                fetch(keys[i + bulk_ahead], slot);
+                        hit = find_in_buckets(bk, keys[i], vals[i]);
+                        done += hit;
+                        if (found)
+                                found[i] = hit;
+                }
+                return done;
+        }
+
+        /**
+         * @brief add key and value (writer thread)
+         *
+         * @param update: update the value if key exists
+         * @return success:0 exists:-EEXIST no space:-ENOSPC sentinel key:-EINVAL
+         */
+        int add(Key key, Val val, bool update = true) noexcept {
+                bucket_type * bk[2];
+                unsigned hit[2], vacant[2];
+                int i, pos;
+
+                if (key == sentinel)
+                        return -EINVAL;
+
+                fetch(key, bk);
+                hit[0] = match(bk[0], key);
+                hit[1] = match(bk[1], key);
+                if (hit[0] | hit[1]) {
+                        if (!update)
+                                return -EEXIST;
+                        i = hit[0] ? 0 : 1;
+                        bk[i]->val[__builtin_ctz(hit[i])].store(val, std::memory_order_release);
+                        return 0;
+                }
+
+                /* the one with more vacancies */
+                vacant[0] = match(bk[0], sentinel);
+                vacant[1] = match(bk[1], sentinel);
+                i = __builtin_popcount(vacant[0]) >= __builtin_popcount(vacant[1]) ? 0 : 1;
+                if (vacant[i]) {
+                        pos = __builtin_ctz(vacant[i]);
+                } else {
+                        for (i = 0; i < 2; i++) {
+                                if ((pos = cuckoo_replace(bk[i], follow_depth_)) >= 0)
+                                        break;
+                        }
+                        if (i == 2)
+                                return -ENOSPC;
+                }
+
+                store(bk[i], pos, key, val);
+                current_entries_ += 1;
+                return 0;
+        }
+
+        /**
+         * @brief delete key (writer thread)
+         *
+         * @return success:0 not found:-ENOENT
+         */
+        int del(Key key) noexcept {
+                bucket_type * bk[2];
+
+                fetch(key, bk);
+                for (int i = 0; i < 2; i++) {
+                        unsigned hit = match(bk[i], key);
+
+                        if (hit) {
+                                bk[i]->key[__builtin_ctz(hit)].store(sentinel, std::memory_order_release);
+                                current_entries_ -= 1;
+                                return 0;
+                        }
+                }
+                return -ENOENT;
+        }
+
+        /**
+         * @brief call f(key, val) for each entry (writer thread)
+         */
+        template <typename F>
+        void walk(F && f) const {
+                for (std::size_t i = 0; i < nb_buckets_; i++) {
+                        for (unsigned pos = 0; pos < SlotsPerBucket; pos++) {
+                                Key key = buckets_[i].key[pos].load(std::memory_order_relaxed);
+
+                                if (key != sentinel)
+                                        f(key, buckets_[i].val[pos].load(std::memory_order_relaxed));
+                        }
+                }
+        }
+
+        /**
+         * @brief each key once in one of its buckets (writer thread)
+         *
+         * @return success:0 failed:-EINVAL
+         */
+        int verify() const noexcept {
+                std::size_t nb = 0;
+
+                for (std::size_t i = 0; i < nb_buckets_; i++) {
+                        for (unsigned pos = 0; pos < SlotsPerBucket; pos++) {
+                                Key key = buckets_[i].key[pos].load(std::memory_order_relaxed);
+                                bucket_type * bk[2];
+
+                                if (key == sentinel)
+                                        continue;
+                                fetch(key, bk);
+                                if ((bk[0] != &buckets_[i] && bk[1] != &buckets_[i]) ||
+                                    __builtin_popcount(match(bk[0], key)) + __builtin_popcount(match(bk[1], key)) != 1)
+                                        return -EINVAL;
+                                nb += 1;
+                        }
+                }
+                return nb == current_entries_ ? 0 : -EINVAL;
+        }
+
+private:
+        static constexpr std::size_t table_align =
+                alignof(bucket_type) > cacheline_size ? alignof(bucket_type) : cacheline_size;
+
+        static std::size_t nb_buckets_for(std::size_t max_entries) noexcept {
+                /* full rate 80% */
+                std::size_t want = (max_entries * 5 / 4 + SlotsPerBucket - 1) / SlotsPerBucket;
+                std::size_t nb = 2;
+
+                while (nb < want)
+                        nb <<= 1;
+                return nb;
+        }
+
+        std::size_t mask() const noexcept {
+                if constexpr (NbBuckets != 0)
+                        return NbBuckets - 1;
+                else
+                        return nb_buckets_ - 1;
+        }
+
+        static unsigned match(const bucket_type * bk, Key key) noexcept {
+                return Simd::template match<Key, SlotsPerBucket>(reinterpret_cast<const Key *>(bk->key), key);
+        }
+
+        void fetch(Key key, bucket_type ** bk) const noexcept {
+                uint64_t h = Hash{}(key);
+                std::size_t b0 = h & mask();
+                std::size_t b1 = (h >> 32) & mask();
+
+                /* two different buckets */
+                if (b0 == b1)
+                        b1 ^= 1;
+                bk[0] = &buckets_[b0];
+                bk[1] = &buckets_[b1];
+                for (std::size_t off = 0; off < sizeof(bucket_type); off += cacheline_size) {
+                        __builtin_prefetch(reinterpret_cast<const char *>(bk[0]) + off, 0, 3);
+                        __builtin_prefetch(reinterpret_cast<const char *>(bk[1]) + off, 0, 3);
+                }
+        }
+
+        bool find_in_buckets(bucket_type ** bk, Key key, Val & val) const noexcept {
+                for (int i = 0; i < 2; i++) {
+                        unsigned hits = match(bk[i], key);
+
+                        if (!hits)
+                                continue;
+
+                        /* the key seen by match() was published by a release store of the writer */
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        for (unsigned hit = hits; hit; hit &= hit - 1) {
+                                unsigned pos = __builtin_ctz(hit);
+                                Val v = bk[i]->val[pos].load(std::memory_order_acquire);
+
+                                /* reread if the entry was changed while reading */
+                                if (bk[i]->key[pos].load(std::memory_order_acquire) == key) {
+                                        val = v;
+                                        return true;
+                                }
+                        }
+                }
+                return false;
+        }
+
+        static void store(bucket_type * bk, int pos, Key key, Val val) noexcept {
+                /* write the value and then the key */
+                bk->val[pos].store(val, std::memory_order_relaxed);
+                bk->key[pos].store(key, std::memory_order_release);
+        }
+
+        /**
+         * @brief make free space, as cuckoo_replace() of dc_hash_tbl.c
+         *
+         * @return an empty position, if failed then negative
+         */
+        int cuckoo_replace(bucket_type * bk, int depth) noexcept {
+                bucket_type * another[SlotsPerBucket];
+
+                for (unsigned i = 0; i < SlotsPerBucket; i++) {
+                        bucket_type * bk_p[2];
+
+                        fetch(bk->key[i].load(std::memory_order_relaxed), bk_p);
+                        another[i] = bk_p[0] == bk ? bk_p[1] : bk_p[0];
+                }
+
+                for (unsigned i = 0; i < SlotsPerBucket; i++) {
+                        unsigned vacant = match(another[i], sentinel);
+
+                        if (vacant) {
+                                move(another[i], __builtin_ctz(vacant), bk, i);
+                                return i;
+                        }
+                }
+
+                if (depth > 0) {
+                        for (unsigned i = 0; i < SlotsPerBucket; i++) {
+                                int pos = cuckoo_replace(another[i], depth - 1);
+
+                                if (pos >= 0) {
+                                        move(another[i], pos, bk, i);
+                                        return i;
+                                }
+                        }
+                }
+                return -ENOSPC;
+        }
+
+        static void move(bucket_type * dbk, int dpos, bucket_type * sbk, int spos) noexcept {
+                /* readers see the entry in one of both */
+                store(dbk, dpos,
+                      sbk->key[spos].load(std::memory_order_relaxed),
+                      sbk->val[spos].load(std::memory_order_relaxed));
+                sbk->key[spos].store(sentinel, std::memory_order_release);
+        }
+
+        void release() noexcept {
+                if (buckets_)
+                        ::operator delete(buckets_, std::align_val_t(table_align));
+                buckets_ = nullptr;
+        }
+
+        bucket_type * buckets_ = nullptr;
+        std::size_t nb_buckets_ = 0;
+        std::size_t current_entries_ = 0;
+        int follow_depth_ = follow_depth_default;
+};
+
+}	/* namespace dcht */
+
+#endif	/* !_DC_HASH_TBL_HPP_ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * hardware performance counters of the test and replay programs
+ */
+
+#ifndef _DCHT_PERF_H_
+#define _DCHT_PERF_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/*********************************************************************************
+ * Hardware performance counters (perf_event_open)
+ *********************************************************************************/
+enum perf_counter_e {
+        PERF_CNT_INSTRUCTIONS = 0,
+        PERF_CNT_LLC_MISSES,
+        PERF_CNT_DTLB_MISSES,
+        PERF_CNT_BRANCH_MISSES,
+        PERF_CNT_BE_STALL_CYCLES,	/* backend stalls, memory and execution units alike */
+
+        PERF_CNT_NB,
+};
+
+static const struct {
+        const char * name;
+        uint32_t type;
+        uint64_t config;
+} perf_events[PERF_CNT_NB] = {
+        [PERF_CNT_INSTRUCTIONS] = {
+                "inst",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_INSTRUCTIONS,
+        },
+        [PERF_CNT_LLC_MISSES] = {
+                "llc-miss",
+                PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_LL |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [PERF_CNT_DTLB_MISSES] = {
+                "dtlb-miss",
+                PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [PERF_CNT_BRANCH_MISSES] = {
+                "br-miss",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_BRANCH_MISSES,
+        },
+        [PERF_CNT_BE_STALL_CYCLES] = {
+                "be-stall",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_STALLED_CYCLES_BACKEND,
+        },
+};
+
+struct perf_s {
+        int fd[PERF_CNT_NB];
+        double val[PERF_CNT_NB];
+};
+
+static struct perf_s perf;
+
+/**
+ * @brief open the counters of this thread (unsupported counters are skipped)
+ *
+ * @return number of opened counters
+ */
+static inline int
+perf_init(void)
+{
+        int nb = 0;
+
+        for (int i = 0; i < PERF_CNT_NB; i++) {
+                struct perf_event_attr attr;
+
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = perf_events[i].type;
+                attr.config = perf_events[i].config;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                perf.fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+                if (perf.fd[i] >= 0)
+                        nb += 1;
+        }
+
+        fprintf(stderr, "perf counters:%d/%d\n", nb, PERF_CNT_NB);
+        return nb;
+}
+
+static inline void
+perf_start(void)
+{
+        for (int i = 0; i < PERF_CNT_NB; i++) {
+                if (perf.fd[i] < 0)
+                        continue;
+                ioctl(perf.fd[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(perf.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+static inline void
+perf_stop(void)
+{
+        for (int i = 0; i < PERF_CNT_NB; i++) {
+                uint64_t buf[3];	/* value, time enabled, time running */
+
+                perf.val[i] = -1;
+                if (perf.fd[i] < 0)
+                        continue;
+
+                ioctl(perf.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+                if (read(perf.fd[i], buf, sizeof(buf)) != sizeof(buf) || !buf[2])
+                        continue;
+
+                /* scale if the counter was multiplexed */
+                perf.val[i] = (double) buf[0] * buf[1] / buf[2];
+        }
+}
+
+/**
+ * @brief print counters per operation of the last phase
+ */
+static inline void
+perf_dump(const char * func,
+          const char * phase,
+          uint64_t nb)
+{
+        char line[256];
+        int len = 0;
+
+        for (int i = 0; i < PERF_CNT_NB && nb; i++) {
+                if (perf.val[i] < 0)
+                        continue;
+                len += snprintf(&line[len], sizeof(line) - len, " %s:%.3f",
+                                perf_events[i].name, perf.val[i] / nb);
+        }
+
+        if (len)
+                fprintf(stderr, "%s: %s perf/op%s\n", func, phase, line);
+}
+
+#endif	/* !_DCHT_PERF_H_ */
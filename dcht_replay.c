@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * replay tool for operation capture file of dc_hash_tbl.c
+ *
+ * usage: replay [-p] [-n max_entries] [-d follow_depth] capture_file
+ *   -p: replay with the original pacing (default: full speed)
+ *   -n: override max_entries of the captured table
+ *   -d: override follow_depth of the captured table
+ * exit status is non zero if a replayed result differs from the captured one
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "dc_hash_tbl.h"
+#include "dcht_perf.h"
+
+static const char * op_name[DCHT_CAPTURE_OP_NB] = {
+        "find",
+        "add",
+        "add-update",
+        "del",
+        "clean",
+};
+
+/*
+ * log-linear latency histogram: exact below 16ns, then 16 steps per power of 2
+ */
+#define HIST_SUB_BITS	4
+#define HIST_NB		((32 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+struct stat_s {
+        uint64_t nb;
+        uint64_t failed;
+        uint64_t mismatched;
+        uint64_t lat_sum;	/* latency in ns */
+        uint32_t lat_max;
+        uint64_t hist[HIST_NB];
+};
+
+static inline uint64_t
+rdtsc(void)
+{
+        union {
+                uint64_t tsc_64;
+                struct {
+                        uint32_t lo_32;
+                        uint32_t hi_32;
+                };
+        } tsc;
+
+        asm volatile("rdtsc" :
+                     "=a" (tsc.lo_32),
+                     "=d" (tsc.hi_32));
+        return tsc.tsc_64;
+}
+
+static inline uint64_t
+time_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * tsc cycles per ns
+ */
+static double
+tsc_calibrate(void)
+{
+        uint64_t ns = time_ns();
+        uint64_t tsc = rdtsc();
+
+        usleep(100 * 1000);
+
+        ns = time_ns() - ns;
+        tsc = rdtsc() - tsc;
+        return (double) tsc / ns;
+}
+
+static inline unsigned
+hist_idx(uint32_t v)
+{
+        unsigned shift;
+
+        if (v < (1u << HIST_SUB_BITS))
+                return v;
+        shift = 31 - __builtin_clz(v) - HIST_SUB_BITS;
+        return ((shift + 1) << HIST_SUB_BITS) + ((v >> shift) & ((1u << HIST_SUB_BITS) - 1));
+}
+
+/*
+ * lowest latency of the histogram slot
+ */
+static inline uint32_t
+hist_val(unsigned idx)
+{
+        unsigned shift;
+
+        if (idx < (1u << HIST_SUB_BITS))
+                return idx;
+        shift = (idx >> HIST_SUB_BITS) - 1;
+        return ((1u << HIST_SUB_BITS) + (idx & ((1u << HIST_SUB_BITS) - 1))) << shift;
+}
+
+static inline void
+stat_add(struct stat_s * st,
+         uint32_t lat_ns,
+         int ret)
+{
+        st->nb += 1;
+        if (ret < 0)
+                st->failed += 1;
+        st->lat_sum += lat_ns;
+        if (lat_ns > st->lat_max)
+                st->lat_max = lat_ns;
+        st->hist[hist_idx(lat_ns)] += 1;
+}
+
+static uint32_t
+stat_percentile(const struct stat_s * st,
+                unsigned pct)
+{
+        uint64_t rank = st->nb * pct / 100, sum = 0;
+
+        for (unsigned i = 0; i < HIST_NB; i++) {
+                sum += st->hist[i];
+                if (sum > rank)
+                        return hist_val(i);
+        }
+        return st->lat_max;
+}
+
+static void
+stat_dump(const char * msg,
+          struct stat_s * stat,
+          uint64_t duration_ns)
+{
+        uint64_t total = 0;
+
+        for (int op = 0; op < DCHT_CAPTURE_OP_NB; op++)
+                total += stat[op].nb;
+
+        fprintf(stderr, "%s: ops:%"PRIu64" duration:%.3fms throughput:%.3fMops/s\n",
+                msg, total, (double) duration_ns / 1000000,
+                duration_ns ? (double) total * 1000 / duration_ns : 0.0);
+
+        for (int op = 0; op < DCHT_CAPTURE_OP_NB; op++) {
+                struct stat_s * st = &stat[op];
+
+                if (!st->nb)
+                        continue;
+
+                /* percentiles are the low bounds of their histogram slots, within 1/16 */
+                fprintf(stderr,
+                        "  %-10s nb:%"PRIu64" failed:%"PRIu64" mismatched:%"PRIu64" "
+                        "lat(ns) mean:%.1f p50:%u p99:%u max:%u\n",
+                        op_name[op], st->nb, st->failed, st->mismatched,
+                        (double) st->lat_sum / st->nb,
+                        stat_percentile(st, 50),
+                        stat_percentile(st, 99),
+                        st->lat_max);
+        }
+}
+
+/*
+ * open the capture file, positioned on its first record
+ */
+static FILE *
+capture_open(const char * path,
+             struct dcht_capture_hdr_s * hdr)
+{
+        FILE * fp = fopen(path, "r");
+
+        if (!fp) {
+                perror(path);
+                return NULL;
+        }
+
+        if (fread(hdr, sizeof(*hdr), 1, fp) != 1 ||
+            hdr->magic != DCHT_CAPTURE_MAGIC) {
+                fprintf(stderr, "%s: not a capture file\n", path);
+                goto err;
+        }
+        if (hdr->version != DCHT_CAPTURE_VERSION) {
+                fprintf(stderr, "%s: capture version %u, %u is supported\n",
+                        path, hdr->version, DCHT_CAPTURE_VERSION);
+                goto err;
+        }
+        return fp;
+ err:
+        fclose(fp);
+        return NULL;
+}
+
+/*
+ * records are streamed through a buffer, the file may be larger than memory
+ */
+#define REC_BUFFER_NB	4096
+
+static size_t
+capture_read(FILE * fp,
+             struct dcht_capture_rec_s * rec)
+{
+        return fread(rec, sizeof(*rec), REC_BUFFER_NB, fp);
+}
+
+static int
+replay_op(struct dcht_hash_table_s * tbl,
+          const struct dcht_capture_rec_s * rec,
+          bool * mismatched)
+{
+        uint32_t val;
+        int ret;
+
+        switch (rec->op) {
+        case DCHT_CAPTURE_OP_FIND:
+                ret = dcht_hash_find(tbl, rec->key, &val);
+                *mismatched = (ret < 0) != (rec->ret < 0) ||
+                              (!ret && val != rec->val);
+                break;
+        case DCHT_CAPTURE_OP_ADD:
+        case DCHT_CAPTURE_OP_ADD_UPDATE:
+                ret = dcht_hash_add(tbl, rec->key, rec->val,
+                                    rec->op == DCHT_CAPTURE_OP_ADD_UPDATE);
+                *mismatched = (ret < 0) != (rec->ret < 0);
+                break;
+        case DCHT_CAPTURE_OP_DEL:
+                ret = dcht_hash_del(tbl, rec->key);
+                *mismatched = (ret < 0) != (rec->ret < 0);
+                break;
+        case DCHT_CAPTURE_OP_CLEAN:
+                dcht_hash_clean(tbl);
+                ret = 0;
+                *mismatched = false;
+                break;
+        default:
+                ret = -EINVAL;
+                *mismatched = true;
+                break;
+        }
+        return ret;
+}
+
+int
+main(int ac,
+     char ** av)
+{
+        static struct stat_s captured[DCHT_CAPTURE_OP_NB];
+        static struct stat_s replayed[DCHT_CAPTURE_OP_NB];
+        static struct dcht_capture_rec_s rec[REC_BUFFER_NB];
+        struct dcht_capture_hdr_s hdr;
+        struct dcht_hash_table_s * tbl;
+        bool pacing = false;
+        long max_entries = -1;
+        long follow_depth = -1;
+        uint64_t duration, nb = 0;
+        uint64_t mismatched_total = 0;
+        size_t n;
+        FILE * fp;
+        int opt;
+
+        while ((opt = getopt(ac, av, "pn:d:")) != -1) {
+                switch (opt) {
+                case 'p':
+                        pacing = true;
+                        break;
+                case 'n':
+                        max_entries = strtol(optarg, NULL, 0);
+                        break;
+                case 'd':
+                        follow_depth = strtol(optarg, NULL, 0);
+                        break;
+                default:
+                        goto usage;
+                }
+        }
+        if (optind >= ac) {
+ usage:
+                fprintf(stderr,
+                        "usage: %s [-p] [-n max_entries] [-d follow_depth] capture_file\n",
+                        av[0]);
+                return -1;
+        }
+
+        fp = capture_open(av[optind], &hdr);
+        if (!fp)
+                return -1;
+
+        /* captured statistics */
+        duration = 0;
+        while ((n = capture_read(fp, rec)) > 0) {
+                for (size_t i = 0; i < n; i++) {
+                        if (rec[i].op >= DCHT_CAPTURE_OP_NB)
+                                continue;
+                        stat_add(&captured[rec[i].op], rec[i].lat_ns, rec[i].ret);
+                        duration += rec[i].delta_ns;
+                }
+        }
+        stat_dump("captured", captured, duration);
+
+        if (max_entries < 0)
+                max_entries = hdr.max_entries;
+        tbl = dcht_hash_table_create_flags(max_entries, hdr.flags);
+        if (!tbl) {
+                fprintf(stderr, "failed to create table max_entries:%ld flags:%x\n",
+                        max_entries, hdr.flags);
+                fclose(fp);
+                return -1;
+        }
+        tbl->follow_depth = follow_depth < 0 ? hdr.follow_depth : follow_depth;
+        if (tbl->driver != hdr.driver)
+                fprintf(stderr, "captured with hash driver:%u, replayed with:%u, "
+                        "no space results may differ\n", hdr.driver, tbl->driver);
+
+        /* replay */
+        double tsc_per_ns = tsc_calibrate();
+        uint64_t start;
+        uint64_t due = 0;
+
+        fseek(fp, sizeof(hdr), SEEK_SET);
+        perf_init();
+        perf_start();
+        start = time_ns();
+
+        while ((n = capture_read(fp, rec)) > 0) {
+                for (size_t i = 0; i < n; i++) {
+                        struct stat_s * st;
+                        bool mismatched;
+                        uint64_t tsc;
+                        double ns;
+                        int ret;
+
+                        if (rec[i].op >= DCHT_CAPTURE_OP_NB)
+                                continue;
+
+                        if (pacing) {
+                                due += rec[i].delta_ns;
+                                while (time_ns() - start < due)
+                                        ;
+                        }
+
+                        tsc = rdtsc();
+                        ret = replay_op(tbl, &rec[i], &mismatched);
+                        tsc = rdtsc() - tsc;
+                        ns = tsc / tsc_per_ns;
+
+                        st = &replayed[rec[i].op];
+                        stat_add(st, ns > UINT32_MAX ? UINT32_MAX : (uint32_t) ns, ret);
+                        if (mismatched) {
+                                st->mismatched += 1;
+                                mismatched_total += 1;
+                        }
+                        nb += 1;
+                }
+        }
+        duration = time_ns() - start;
+        perf_stop();
+        fclose(fp);
+
+        fprintf(stderr, "replayed table: max:%u cur:%u depth:%d FullRate:%.02f%%\n",
+                tbl->max_entries, tbl->current_entries, tbl->follow_depth,
+                (double) 100 * tbl->current_entries / tbl->nb_entries);
+        stat_dump(pacing ? "replayed(paced)" : "replayed", replayed, duration);
+        perf_dump("replayed", pacing ? "paced" : "full speed", nb);
+
+        free(tbl);
+
+        if (mismatched_total) {
+                fprintf(stderr, "mismatched:%"PRIu64"\n", mismatched_total);
+                return 1;
+        }
+        return 0;
+}
@@ -7,8 +7,18 @@
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "dc_hash_tbl.h"
+#include "dc_hash_set.h"
+#include "dc_cuckoo_filter.h"
+#include "dc_hash_str.h"
+#include "dcht_perf.h"
 
 /*********************************************************************************
  * Unit Test
@@ -101,6 +111,7 @@ static const char *event_msg[] = {
         "Moved Entry",
         "Cuckoo Replaced",
         "Updated Value",
+        "Evicted",
 
         "unknown",
 };
@@ -585,6 +596,7 @@ single_speed_test(struct dcht_hash_table_s * tbl,
         fprintf(stderr, "Start Single Speed Test nb:%u >>>\n", nb);
 
         /* Add */
+        perf_start();
         tsc = rdtsc();
         for (int i = 0; i < nb; i++) {
                 if (dcht_hash_add(tbl, req[i].key, req[i].val, true) < 0) {
@@ -594,16 +606,19 @@ single_speed_test(struct dcht_hash_table_s * tbl,
                 }
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Add", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Add.\n");
                 goto end;
         }
+        perf_dump(__func__, "add", nb);
         fprintf(stderr, "%s: add speed %"PRIu64"tsc/add\n\n",
                 __func__, tsc / nb);
 
         /* Search */
+        perf_start();
         tsc = rdtsc();
         for (int i = 0; i < nb; i++) {
                 uint32_t val;
@@ -615,16 +630,19 @@ single_speed_test(struct dcht_hash_table_s * tbl,
                 }
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Search", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Search.\n");
                 goto end;
 }
+        perf_dump(__func__, "search", nb);
         fprintf(stderr, "%s: search speed %"PRIu64"tsc/search\n\n",
                 __func__, tsc / nb);
 
         /* Delete */
+        perf_start();
         tsc = rdtsc();
         for (int i = 0; i < nb; i++) {
                 if (dcht_hash_del(tbl, req[i].key) < 0) {
@@ -634,12 +652,14 @@ single_speed_test(struct dcht_hash_table_s * tbl,
                 }
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Delete", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Delete.\n");
                 goto end;
         }
+        perf_dump(__func__, "delete", nb);
         fprintf(stderr, "%s: search delete %"PRIu64"tsc/delete\n",
                 __func__, tsc / nb);
 
@@ -661,50 +681,59 @@ vector_speed_test(struct dcht_hash_table_s * tbl,
         fprintf(stderr, "Start Vector Speed Test >>>\n");
 
         /* Add */
+        perf_start();
         tsc = rdtsc();
         if (vector_add(tbl, req, nb) < 0) {
                 fprintf(stderr, "%s: failed vector add\n", __func__);
                 goto end;
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Add", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Add.\n");
                 goto end;
         }
+        perf_dump(__func__, "add", nb);
         fprintf(stderr, "%s: add speed %"PRIu64"tsc/add\n\n",
                 __func__, tsc / nb);
 
         /* Search */
+        perf_start();
         tsc = rdtsc();
         if (vector_search(tbl, req, nb) < 0) {
                 fprintf(stderr, "%s: failed vector search\n", __func__);
                 goto end;
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Search", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Search.\n");
                 goto end;
         }
+        perf_dump(__func__, "search", nb);
         fprintf(stderr, "%s: search speed %"PRIu64"tsc/search\n\n",
                 __func__, tsc / nb);
 
         /* Delete */
+        perf_start();
         tsc = rdtsc();
         if (vector_del(tbl, req, nb) < 0) {
                 fprintf(stderr, "%s: failed vector del\n", __func__);
                 goto end;
         }
         tsc = rdtsc() - tsc;
+        perf_stop();
 
         table_dump("After Delete", tbl);
         if (dcht_hash_verify(tbl)) {
                 fprintf(stderr, "failed to verify at After Delete\n");
                 goto end;
         }
+        perf_dump(__func__, "delete", nb);
         fprintf(stderr, "%s: search delete %"PRIu64"tsc/delete\n",
                 __func__, tsc / nb);
 
@@ -715,6 +744,1538 @@ vector_speed_test(struct dcht_hash_table_s * tbl,
         return ret;
 }
 
+/*
+ * Bulk Speed Test
+ */
+static inline int
+bulk_speed_test(struct dcht_hash_table_s * tbl,
+                struct req_s * req,
+                int nb)
+{
+        uint32_t * keys = calloc(nb, sizeof(uint32_t));
+        uint32_t * vals = calloc(nb, sizeof(uint32_t));
+        uint32_t * found = calloc(nb, sizeof(uint32_t));
+        int * st = calloc(nb, sizeof(int));
+        uint64_t tsc[3];
+        unsigned done[3];
+        int ret = -1;
+
+        fprintf(stderr, "Start Bulk Speed Test nb:%d ahead:%d >>>\n", nb, DCHT_BULK_AHEAD);
+        if (!keys || !vals || !found || !st)
+                goto end;
+
+        for (int i = 0; i < nb; i++) {
+                keys[i] = req[i].key;
+                vals[i] = req[i].val;
+        }
+
+        perf_start();
+        tsc[0] = rdtsc();
+        done[0] = dcht_hash_add_bulk(tbl, keys, vals, nb, true, st);
+        tsc[0] = rdtsc() - tsc[0];
+        perf_stop();
+        perf_dump(__func__, "add", nb);
+
+        perf_start();
+        tsc[1] = rdtsc();
+        done[1] = dcht_hash_find_bulk(tbl, keys, nb, found, st);
+        tsc[1] = rdtsc() - tsc[1];
+        perf_stop();
+        perf_dump(__func__, "find", nb);
+        for (int i = 0; i < nb; i++) {
+                if (st[i] || found[i] != vals[i]) {
+                        fprintf(stderr, "failed to bulk find: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+
+        if (dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After Bulk Add.\n");
+                goto end;
+        }
+
+        perf_start();
+        tsc[2] = rdtsc();
+        done[2] = dcht_hash_del_bulk(tbl, keys, nb, st);
+        tsc[2] = rdtsc() - tsc[2];
+        perf_stop();
+        perf_dump(__func__, "del", nb);
+
+        table_dump("After Bulk Delete", tbl);
+        if (done[0] != (unsigned) nb || done[1] != (unsigned) nb || done[2] != (unsigned) nb ||
+            tbl->current_entries || dcht_hash_del_bulk(tbl, keys, 1, st) || st[0] != -ENOENT) {
+                fprintf(stderr, "failed at bulk: add:%u find:%u del:%u\n",
+                        done[0], done[1], done[2]);
+                goto end;
+        }
+        fprintf(stderr, "%s: add %"PRIu64"tsc/op find %"PRIu64"tsc/op del %"PRIu64"tsc/op\n",
+                __func__, tsc[0] / nb, tsc[1] / nb, tsc[2] / nb);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Bulk Speed Test\n\n");
+        dcht_hash_clean(tbl);
+        free(keys);
+        free(vals);
+        free(found);
+        free(st);
+        return ret;
+}
+
+/*
+ * Shared Memory Test
+ * a reader process attaches the table by name or by memfd and finds every key
+ */
+static int
+shm_reader(const char * path,
+           int fd,
+           struct req_s * req,
+           int nb)
+{
+        struct dcht_hash_table_s * tbl = dcht_hash_shm_attach(path, fd);
+        int lost = 0;
+
+        if (!tbl) {
+                fprintf(stderr, "failed to attach:%s %s\n", path ? path : "memfd", strerror(errno));
+                return -1;
+        }
+
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (dcht_hash_find(tbl, req[i].key, &val) || val != req[i].val)
+                        lost += 1;
+        }
+        if (dcht_hash_capture_start(tbl, "/dev/null") != -ENOTSUP)
+                lost += 1;
+
+        dcht_hash_shm_detach(tbl);
+        return lost ? -1 : 0;
+}
+
+static inline int
+shm_test(struct req_s * req,
+         int nb)
+{
+        char name[64];
+        int ret = -1;
+
+        fprintf(stderr, "Start Shared Memory Test nb:%d >>>\n", nb);
+        snprintf(name, sizeof(name), "/dcht_utest_%d", getpid());
+
+        for (int memfd = 0; memfd < 2; memfd++) {
+                const char * path = memfd ? NULL : name;
+                struct dcht_hash_table_s * tbl;
+                int fd = -1, status;
+                pid_t pid;
+
+                tbl = dcht_hash_shm_create(path, nb, DCHT_FLAG_TTL, memfd ? &fd : NULL);
+                if (!tbl) {
+                        fprintf(stderr, "failed to create:%s %s\n",
+                                path ? path : "memfd", strerror(errno));
+                        goto end;
+                }
+                for (int i = 0; i < nb; i++)
+                        dcht_hash_add(tbl, req[i].key, req[i].val, false);
+
+                /* the table of a live writer is neither truncated nor removed */
+                if (path && (dcht_hash_shm_create(path, nb, DCHT_FLAG_TTL, NULL) || errno != EEXIST)) {
+                        fprintf(stderr, "failed to refuse an existing table:%s\n", path);
+                        goto end;
+                }
+
+                pid = fork();
+                if (!pid) {
+                        /* a fresh mapping, not the inherited one */
+                        _exit(shm_reader(path, fd, req, nb) ? 1 : 0);
+                }
+                if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+                    !WIFEXITED(status) || WEXITSTATUS(status)) {
+                        fprintf(stderr, "failed at reader process:%s\n", path ? path : "memfd");
+                        goto end;
+                }
+
+                dcht_hash_shm_detach(tbl);
+                if (memfd)
+                        close(fd);
+                else
+                        shm_unlink(name);
+        }
+
+        if (dcht_hash_shm_attach(name, -1) || errno != ENOENT) {
+                fprintf(stderr, "failed at attach of removed table\n");
+                goto end;
+        }
+
+        /* a failed create leaves no object behind */
+        if (dcht_hash_shm_create(name, nb, DCHT_FLAG_FRONT_GEN | DCHT_FLAG_CACHE, NULL) ||
+            errno != EINVAL || dcht_hash_shm_attach(name, -1) || errno != ENOENT) {
+                fprintf(stderr, "failed to remove the object of a failed create\n");
+                goto end;
+        }
+
+        ret = 0;
+ end:
+        shm_unlink(name);
+        fprintf(stderr, "<<< End Shared Memory Test\n\n");
+        return ret;
+}
+
+/*
+ * RCU Test
+ * readers look keys up while the writer publishes rebuilt tables. a freed
+ * table is poisoned and kept, so that a reader still using it fails its lookup.
+ */
+#define RCU_NB_READERS		2
+#define RCU_NB_SWAP		64
+#define RCU_NB_KEYS		1024
+
+struct rcu_arg_s {
+        struct dcht_hash_rcu_s * rcu;
+        struct req_s * req;
+        atomic_bool * stop;
+        unsigned lookups;
+        unsigned failed;
+};
+
+static struct dcht_hash_table_s * rcu_graveyard[RCU_NB_SWAP + 2];
+static unsigned rcu_nb_freed;
+
+static void
+rcu_poison(struct dcht_hash_table_s * tbl)
+{
+        memset(tbl->buckets, 0, sizeof(tbl->buckets[0]) * tbl->nb_buckets);
+        rcu_graveyard[rcu_nb_freed++] = tbl;
+}
+
+static void *
+rcu_reader(void * p)
+{
+        struct rcu_arg_s * arg = p;
+        int id = dcht_hash_rcu_reader_register(arg->rcu);
+
+        if (id < 0) {
+                arg->failed += 1;
+                return NULL;
+        }
+
+        while (!atomic_load(arg->stop)) {
+                struct dcht_hash_table_s * tbl = dcht_hash_rcu_read_lock(arg->rcu, id);
+
+                for (int i = 0; i < RCU_NB_KEYS; i++) {
+                        uint32_t val;
+
+                        if (dcht_hash_find(tbl, arg->req[i].key, &val))
+                                arg->failed += 1;
+                }
+                dcht_hash_rcu_read_unlock(arg->rcu, id);
+                arg->lookups += RCU_NB_KEYS;
+        }
+
+        dcht_hash_rcu_reader_unregister(arg->rcu, id);
+        return NULL;
+}
+
+static struct dcht_hash_table_s *
+rcu_build(struct req_s * req,
+          uint32_t gen)
+{
+        struct dcht_hash_table_s * tbl = dcht_hash_table_create(RCU_NB_KEYS);
+
+        for (int i = 0; tbl && i < RCU_NB_KEYS; i++)
+                dcht_hash_add(tbl, req[i].key, gen, false);
+        return tbl;
+}
+
+static inline int
+rcu_test(struct req_s * req)
+{
+        struct rcu_arg_s arg[RCU_NB_READERS];
+        pthread_t th[RCU_NB_READERS];
+        struct dcht_hash_rcu_s * rcu;
+        atomic_bool stop = false;
+        unsigned lookups = 0;
+        int nb_th = 0, ret = -1;
+
+        fprintf(stderr, "Start RCU Test readers:%d swaps:%d >>>\n", RCU_NB_READERS, RCU_NB_SWAP);
+
+        rcu = dcht_hash_rcu_create(rcu_build(req, 0), rcu_poison);
+        if (!rcu)
+                goto end;
+
+        for (; nb_th < RCU_NB_READERS; nb_th++) {
+                arg[nb_th].rcu = rcu;
+                arg[nb_th].req = req;
+                arg[nb_th].stop = &stop;
+                arg[nb_th].lookups = 0;
+                arg[nb_th].failed = 0;
+                if (pthread_create(&th[nb_th], NULL, rcu_reader, &arg[nb_th]))
+                        goto end;
+        }
+
+        for (uint32_t gen = 1; gen <= RCU_NB_SWAP; gen++) {
+                struct dcht_hash_table_s * tbl = rcu_build(req, gen);
+
+                if (!tbl)
+                        goto end;
+                dcht_hash_rcu_defer_free(rcu, dcht_hash_rcu_swap(rcu, tbl));
+                usleep(100);
+        }
+        dcht_hash_rcu_synchronize(rcu);
+        dcht_hash_rcu_reclaim(rcu);
+
+        /* all but the current one are freed after synchronize */
+        if (rcu_nb_freed != RCU_NB_SWAP) {
+                fprintf(stderr, "failed at RCU reclaim: freed:%u\n", rcu_nb_freed);
+                goto end;
+        }
+
+        ret = 0;
+ end:
+        atomic_store(&stop, true);
+        for (int i = 0; i < nb_th; i++) {
+                pthread_join(th[i], NULL);
+                lookups += arg[i].lookups;
+                if (arg[i].failed) {
+                        fprintf(stderr, "failed at RCU reader:%d failed:%u\n", i, arg[i].failed);
+                        ret = -1;
+                }
+        }
+        if (!ret)
+                fprintf(stderr, "%s: lookups:%u freed:%u\n",
+                        __func__, lookups, rcu_nb_freed);
+        if (rcu)
+                dcht_hash_rcu_destroy(rcu);
+        for (unsigned i = 0; i < rcu_nb_freed; i++)
+                free(rcu_graveyard[i]);
+        rcu_nb_freed = 0;
+
+        fprintf(stderr, "<<< End RCU Test\n\n");
+        return ret;
+}
+
+/*
+ * Overflow Hint Test
+ * miss lookups read the primary bucket only unless its keys overflowed
+ */
+static inline int
+hint_test(struct req_s * req,
+          int nb)
+{
+        int ret = -1;
+
+        fprintf(stderr, "Start Overflow Hint Test >>>\n");
+
+        for (int hint = 0; hint < 2; hint++) {
+                struct dcht_hash_table_s * tbl;
+                uint64_t tsc[2];
+                int nb_add;
+
+                tbl = dcht_hash_table_create_flags(nb / 2, hint ? DCHT_FLAG_OVERFLOW_HINT : 0);
+                if (!tbl)
+                        goto end;
+                nb_add = tbl->nb_entries * 0.8;
+                if (nb_add > nb / 2)
+                        nb_add = nb / 2;
+
+                for (int i = 0; i < nb_add; i++) {
+                        if (dcht_hash_add(tbl, req[i].key, req[i].val, false)) {
+                                fprintf(stderr, "failed to add: %d %u\n", i, req[i].key);
+                                free(tbl);
+                                goto end;
+                        }
+                }
+
+                /* hits, then misses */
+                for (int j = 0; j < 2; j++) {
+                        int base = j ? nb_add : 0;
+
+                        tsc[j] = rdtsc();
+                        for (int i = 0; i < nb_add; i++) {
+                                uint32_t val;
+
+                                if (!dcht_hash_find(tbl, req[base + i].key, &val) != !j) {
+                                        fprintf(stderr, "failed to find: %d %u\n",
+                                                base + i, req[base + i].key);
+                                        free(tbl);
+                                        goto end;
+                                }
+                        }
+                        tsc[j] = rdtsc() - tsc[j];
+                }
+
+                /* the hints must follow deletions back to zero */
+                for (int i = 0; i < nb_add; i += 2)
+                        dcht_hash_del(tbl, req[i].key);
+                if (dcht_hash_verify(tbl)) {
+                        fprintf(stderr, "failed to verify at After Hint Delete.\n");
+                        free(tbl);
+                        goto end;
+                }
+
+                fprintf(stderr, "%s: hint:%d hit %"PRIu64"tsc/find miss %"PRIu64"tsc/find\n",
+                        __func__, hint, tsc[0] / nb_add, tsc[1] / nb_add);
+                free(tbl);
+        }
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Overflow Hint Test\n\n");
+        return ret;
+}
+
+/*
+ * Hotness Test
+ * after rebalance, the hot keys are found in their primary bucket
+ */
+static unsigned
+hot_in_secondary(struct dcht_hash_table_s * tbl,
+                 struct req_s * req,
+                 int nb)
+{
+        unsigned nb_sec = 0;
+
+        for (int i = 0; i < nb; i++) {
+                struct dcht_bucket_s * bk_p[2];
+                uint32_t val;
+
+                dcht_hash_buckets_prefetch(tbl, req[i].key, bk_p);
+                if (dcht_hash_find_in_buckets(req[i].key, bk_p, &val) == 1)
+                        nb_sec += 1;
+        }
+        return nb_sec;
+}
+
+static inline int
+hotness_test(struct req_s * req,
+             int nb)
+{
+        struct dcht_hash_table_s * tbl;
+        unsigned nb_hot = nb / 16, sec[2];
+        int moved, nb_add, ret = -1;
+
+        fprintf(stderr, "Start Hotness Test >>>\n");
+
+        tbl = dcht_hash_table_create_flags(nb / 2, DCHT_FLAG_HOTNESS);
+        if (!tbl)
+                goto end;
+
+        /* hot keys are added last, most of them to the secondary of full buckets */
+        nb_add = tbl->nb_entries * 0.9;
+        if (nb_add > nb)
+                nb_add = nb;
+        for (int i = nb_add - 1; i >= 0; i--)
+                dcht_hash_add(tbl, req[i].key, req[i].val, false);
+
+        for (int loop = 0; loop < 64; loop++) {
+                for (unsigned i = 0; i < nb_hot; i++) {
+                        uint32_t val;
+
+                        dcht_hash_find(tbl, req[i].key, &val);
+                }
+        }
+
+        sec[0] = hot_in_secondary(tbl, req, nb_hot);
+        moved = dcht_hash_rebalance(tbl, tbl->nb_buckets, 2);
+        sec[1] = hot_in_secondary(tbl, req, nb_hot);
+
+        table_dump("After Rebalance", tbl);
+        if (moved < 0 || sec[1] >= sec[0] || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed at rebalance: moved:%d secondary:%u -> %u\n",
+                        moved, sec[0], sec[1]);
+                goto end;
+        }
+        fprintf(stderr, "%s: hot:%u in secondary:%u -> %u moved:%d\n",
+                __func__, nb_hot, sec[0], sec[1], moved);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Hotness Test\n\n");
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Multimap Test
+ * key#i has (i % MULTI_VALS_MAX) + 1 values, the long ones go to overflow chains
+ */
+#define MULTI_VALS_MAX	24
+
+static inline int
+multimap_test(struct req_s * req,
+              int nb)
+{
+        struct dcht_hash_table_s * tbl;
+        uint32_t vals[MULTI_VALS_MAX];
+        unsigned nb_keys = nb / MULTI_VALS_MAX, nb_pairs = 0;
+        uint64_t tsc;
+        int ret = -1;
+
+        fprintf(stderr, "Start Multimap Test keys:%u >>>\n", nb_keys);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_MULTI);
+        if (!tbl)
+                goto end;
+
+        for (unsigned i = 0; i < nb_keys; i++) {
+                for (unsigned v = 0; v <= i % MULTI_VALS_MAX; v++) {
+                        if (dcht_hash_multi_add(tbl, req[i].key, v)) {
+                                fprintf(stderr, "failed to add key:%u val:%u\n", req[i].key, v);
+                                goto end;
+                        }
+                        nb_pairs += 1;
+                }
+        }
+        if (dcht_hash_multi_add(tbl, req[0].key, 0) != -EEXIST) {
+                fprintf(stderr, "added an existing pair\n");
+                goto end;
+        }
+        if (dcht_hash_add(tbl, req[0].key, 0, false) != -EINVAL ||
+            dcht_hash_find_or_add(tbl, req[nb_keys].key, 0, &vals[0]) != -EINVAL) {
+                fprintf(stderr, "single value add on a multimap\n");
+                goto end;
+        }
+
+        tsc = rdtsc();
+        for (unsigned i = 0; i < nb_keys; i++) {
+                unsigned n = dcht_hash_multi_find(tbl, req[i].key, vals, MULTI_VALS_MAX);
+                uint32_t sum = 0;
+
+                for (unsigned v = 0; v < n; v++)
+                        sum += vals[v];
+                if (n != i % MULTI_VALS_MAX + 1 || sum != n * (n - 1) / 2) {
+                        fprintf(stderr, "failed to find key:%u nb:%u sum:%u\n", req[i].key, n, sum);
+                        goto end;
+                }
+        }
+        tsc = rdtsc() - tsc;
+
+        table_dump("After Multimap Add", tbl);
+        if (dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify\n");
+                goto end;
+        }
+
+        /* delete the even values */
+        for (unsigned i = 0; i < nb_keys; i++) {
+                for (unsigned v = 0; v <= i % MULTI_VALS_MAX; v += 2) {
+                        if (dcht_hash_multi_del(tbl, req[i].key, v)) {
+                                fprintf(stderr, "failed to delete key:%u val:%u\n", req[i].key, v);
+                                goto end;
+                        }
+                        nb_pairs -= 1;
+                }
+        }
+        for (unsigned i = 0; i < nb_keys; i++) {
+                unsigned n = dcht_hash_multi_find(tbl, req[i].key, vals, MULTI_VALS_MAX);
+
+                for (unsigned v = 0; v < n; v++) {
+                        if (!(vals[v] & 1))
+                                n = ~0u;
+                }
+                if (n != (i % MULTI_VALS_MAX + 1) / 2) {
+                        fprintf(stderr, "failed after delete key:%u nb:%u\n", req[i].key, n);
+                        goto end;
+                }
+        }
+        if (tbl->current_entries != nb_pairs || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify after delete\n");
+                goto end;
+        }
+
+        fprintf(stderr, "%s: pairs:%u overflow buckets:%u/%u find all %0.2f tsc/key\n",
+                __func__, nb_pairs, tbl->ovf_used, tbl->nb_ovf, (double) tsc / nb_keys);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Multimap Test\n\n");
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Set Test
+ * keys only set against a table with the same keys
+ */
+static inline int
+set_test(struct req_s * req,
+         int nb)
+{
+        struct dcht_hash_set_s * set;
+        struct dcht_hash_table_s * tbl;
+        uint32_t * keys = calloc(nb, sizeof(uint32_t));
+        uint64_t tsc[3];
+        unsigned found[3] = { 0, 0, 0 };
+        int ret = -1;
+
+        fprintf(stderr, "Start Set Test nb:%d >>>\n", nb);
+
+        set = dcht_hash_set_create(nb);
+        tbl = dcht_hash_table_create(nb);
+        if (!set || !tbl || !keys)
+                goto end;
+
+        for (int i = 0; i < nb; i++) {
+                keys[i] = req[i].key;
+                if (dcht_hash_set_add(set, keys[i]) ||
+                    dcht_hash_add(tbl, keys[i], req[i].val, false)) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        if (dcht_hash_set_add(set, keys[0]) != -EEXIST || dcht_hash_set_verify(set)) {
+                fprintf(stderr, "failed to verify set\n");
+                goto end;
+        }
+
+        tsc[0] = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                found[0] += !dcht_hash_find(tbl, keys[i], &val);
+        }
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        for (int i = 0; i < nb; i++)
+                found[1] += dcht_hash_set_contains(set, keys[i]);
+        tsc[1] = rdtsc() - tsc[1];
+
+        tsc[2] = rdtsc();
+        found[2] = dcht_hash_set_contains_bulk(set, keys, nb, NULL);
+        tsc[2] = rdtsc() - tsc[2];
+
+        if (found[0] != (unsigned) nb || found[1] != (unsigned) nb || found[2] != (unsigned) nb) {
+                fprintf(stderr, "failed to find: %u %u %u\n", found[0], found[1], found[2]);
+                goto end;
+        }
+
+        /* delete the odd ones */
+        for (int i = 1; i < nb; i += 2) {
+                if (dcht_hash_set_del(set, keys[i])) {
+                        fprintf(stderr, "failed to delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        for (int i = 0; i < nb; i++) {
+                if (dcht_hash_set_contains(set, keys[i]) != !(i & 1)) {
+                        fprintf(stderr, "failed after delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        if (set->current_entries != (unsigned) (nb + 1) / 2 || dcht_hash_set_verify(set)) {
+                fprintf(stderr, "failed to verify set after delete\n");
+                goto end;
+        }
+
+        fprintf(stderr, "%s: size table:%zu set:%zu find:%"PRIu64" contains:%"PRIu64
+                " bulk:%"PRIu64" tsc/key\n",
+                __func__, tbl->size, set->size, tsc[0] / nb, tsc[1] / nb, tsc[2] / nb);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Set Test\n\n");
+        free(keys);
+        free(tbl);
+        free(set);
+        return ret;
+}
+
+/*
+ * Wide Key Test
+ * four keys share the low 32 bits of a request key, they differ in the upper bits
+ */
+static inline void
+wide_key(struct req_s * req,
+         int i,
+         struct dcht_key128_s * key)
+{
+        key->w[0] = ((uint64_t) (i & 3) << 32) | req[i >> 2].key;
+        key->w[1] = (uint64_t) ~i << 1;
+}
+
+static inline int
+wide_key_op(struct dcht_hash_table_s * tbl,
+            const struct dcht_key128_s * key,
+            char op,
+            uint32_t val,
+            uint32_t * val_p)
+{
+        if (tbl->flags & DCHT_FLAG_KEY64) {
+                switch (op) {
+                case 'a':
+                        return dcht_hash_add64(tbl, key->w[0], val, false);
+                case 'u':
+                        return dcht_hash_add64(tbl, key->w[0], val, true);
+                case 'f':
+                        return dcht_hash_find64(tbl, key->w[0], val_p);
+                default:
+                        return dcht_hash_del64(tbl, key->w[0]);
+                }
+        }
+        switch (op) {
+        case 'a':
+                return dcht_hash_add128(tbl, key, val, false);
+        case 'u':
+                return dcht_hash_add128(tbl, key, val, true);
+        case 'f':
+                return dcht_hash_find128(tbl, key, val_p);
+        default:
+                return dcht_hash_del128(tbl, key);
+        }
+}
+
+static inline int
+wide_key_test(struct req_s * req,
+              int nb,
+              unsigned flags)
+{
+        struct dcht_hash_table_s * tbl;
+        struct dcht_key128_s key, zero = { { 0, 0 } };
+        unsigned found = 0;
+        uint64_t tsc;
+        int ret = -1;
+
+        fprintf(stderr, "Start Wide Key Test nb:%d flags:%x >>>\n", nb, flags);
+
+        if (dcht_hash_table_create_flags(nb, flags | DCHT_FLAG_MULTI) ||
+            dcht_hash_table_create_flags(nb, DCHT_FLAG_KEY64 | DCHT_FLAG_KEY128)) {
+                fprintf(stderr, "invalid flags accepted\n");
+                return -1;
+        }
+        tbl = dcht_hash_table_create_flags(nb, flags);
+        if (!tbl)
+                goto end;
+
+        for (int i = 0; i < nb; i++) {
+                wide_key(req, i, &key);
+                if (wide_key_op(tbl, &key, 'a', i, NULL)) {
+                        fprintf(stderr, "failed to add: %d %016"PRIx64"\n", i, key.w[0]);
+                        goto end;
+                }
+        }
+        /* any key value is valid */
+        wide_key(req, 0, &key);
+        if (wide_key_op(tbl, &key, 'a', 0, NULL) != -EEXIST ||
+            wide_key_op(tbl, &key, 'u', nb, NULL) ||
+            wide_key_op(tbl, &zero, 'a', nb + 1, NULL) ||
+            dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify table\n");
+                goto end;
+        }
+
+        /* the 32 bit key API would work on the tags */
+        {
+                uint32_t k32 = req[0].key, val = 1;
+                int r32[3] = { 0, 0, 0 };
+
+                if (dcht_hash_add(tbl, k32, val, false) != -EINVAL ||
+                    dcht_hash_find(tbl, k32, &val) != -EINVAL ||
+                    dcht_hash_del(tbl, k32) != -EINVAL ||
+                    dcht_hash_find_or_add(tbl, k32, val, &val) != -EINVAL ||
+                    dcht_hash_add_bulk(tbl, &k32, &val, 1, true, &r32[0]) ||
+                    dcht_hash_find_bulk(tbl, &k32, 1, &val, &r32[1]) ||
+                    dcht_hash_del_bulk(tbl, &k32, 1, &r32[2]) ||
+                    r32[0] != -EINVAL || r32[1] != -EINVAL || r32[2] != -EINVAL ||
+                    dcht_hash_verify(tbl)) {
+                        fprintf(stderr, "32 bit key API not rejected\n");
+                        goto end;
+                }
+        }
+
+        tsc = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                wide_key(req, i, &key);
+                if (!wide_key_op(tbl, &key, 'f', 0, &val) && val == (i ? (uint32_t) i : (uint32_t) nb))
+                        found += 1;
+        }
+        tsc = rdtsc() - tsc;
+        if (found != (unsigned) nb) {
+                fprintf(stderr, "failed to find: %u\n", found);
+                goto end;
+        }
+
+        /* delete the odd ones and the zero key */
+        for (int i = 1; i < nb; i += 2) {
+                wide_key(req, i, &key);
+                if (wide_key_op(tbl, &key, 'd', 0, NULL)) {
+                        fprintf(stderr, "failed to delete: %d\n", i);
+                        goto end;
+                }
+        }
+        if (wide_key_op(tbl, &zero, 'd', 0, NULL) || !wide_key_op(tbl, &zero, 'd', 0, NULL))
+                goto end;
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                wide_key(req, i, &key);
+                if (!wide_key_op(tbl, &key, 'f', 0, &val) != !(i & 1)) {
+                        fprintf(stderr, "failed after delete: %d\n", i);
+                        goto end;
+                }
+        }
+        if (tbl->current_entries != (unsigned) (nb + 1) / 2 || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify table after delete\n");
+                goto end;
+        }
+
+        fprintf(stderr, "%s: %u bit keys size:%zu find:%"PRIu64" tsc/key\n",
+                __func__, (flags & DCHT_FLAG_KEY64) ? 64 : 128, tbl->size, tsc / nb);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Wide Key Test\n\n");
+        free(tbl);
+        return ret;
+}
+
+/*
+ * String Key Test
+ * hostname like keys of 16 ~ 60 bytes sharing their suffix
+ */
+#define STR_TEST_PAD	"abcdefghijklmnopqrstuvwxyzabcdefghijklmn"
+
+static inline int
+str_key(struct req_s * req,
+        int i,
+        char * buf,
+        size_t size)
+{
+        return snprintf(buf, size, "%08x.%.*s.example.com",
+                        req[i].key, i % (int) (sizeof(STR_TEST_PAD) - 1), STR_TEST_PAD);
+}
+
+static inline int
+str_test(struct req_s * req,
+         int nb)
+{
+        struct dcht_hash_str_s * st;
+        char (* keys)[64] = calloc(nb, sizeof(*keys));
+        int * lens = calloc(nb, sizeof(int));
+        char buf[128];
+        unsigned found = 0;
+        size_t used;
+        uint64_t tsc;
+        int len, ret = -1;
+
+        fprintf(stderr, "Start String Key Test nb:%d >>>\n", nb);
+
+        st = dcht_hash_str_create(nb, (size_t) nb * 96);
+        if (!st || !keys || !lens)
+                goto end;
+
+        for (int i = 0; i < nb; i++) {
+                len = str_key(req, i, buf, sizeof(buf));
+                if (dcht_hash_str_add(st, buf, len, i, false)) {
+                        fprintf(stderr, "failed to add: %d %s\n", i, buf);
+                        goto end;
+                }
+        }
+        len = str_key(req, 0, buf, sizeof(buf));
+        if (dcht_hash_str_add(st, buf, len, 0, false) != -EEXIST ||
+            dcht_hash_str_add(st, buf, len, nb, true) ||
+            dcht_hash_str_add(st, buf, 0, 0, false) != -EINVAL ||
+            dcht_hash_str_verify(st)) {
+                fprintf(stderr, "failed to verify string table\n");
+                goto end;
+        }
+
+        for (int i = 0; i < nb; i++)
+                lens[i] = str_key(req, i, keys[i], sizeof(keys[i]));
+
+        tsc = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (!dcht_hash_str_find(st, keys[i], lens[i], &val) &&
+                    val == (i ? (uint32_t) i : (uint32_t) nb))
+                        found += 1;
+        }
+        tsc = rdtsc() - tsc;
+        if (found != (unsigned) nb) {
+                fprintf(stderr, "failed to find: %u\n", found);
+                goto end;
+        }
+
+        /* a prefix of a key is another key */
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                len = str_key(req, i, buf, sizeof(buf));
+                if (!dcht_hash_str_find(st, buf, len - 1, &val)) {
+                        fprintf(stderr, "found prefix: %d %s\n", i, buf);
+                        goto end;
+                }
+        }
+
+        /* delete the odd ones, adding them again recycles their records */
+        for (int i = 1; i < nb; i += 2) {
+                len = str_key(req, i, buf, sizeof(buf));
+                if (dcht_hash_str_del(st, buf, len)) {
+                        fprintf(stderr, "failed to delete: %d %s\n", i, buf);
+                        goto end;
+                }
+        }
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                len = str_key(req, i, buf, sizeof(buf));
+                if (!dcht_hash_str_find(st, buf, len, &val) != !(i & 1)) {
+                        fprintf(stderr, "failed after delete: %d %s\n", i, buf);
+                        goto end;
+                }
+        }
+        if (st->current_entries != (unsigned) (nb + 1) / 2 || dcht_hash_str_verify(st)) {
+                fprintf(stderr, "failed to verify string table after delete\n");
+                goto end;
+        }
+
+        used = st->arena_used;
+        for (int i = 1; i < nb; i += 2) {
+                len = str_key(req, i, buf, sizeof(buf));
+                if (dcht_hash_str_add(st, buf, len, i, false)) {
+                        fprintf(stderr, "failed to add again: %d %s\n", i, buf);
+                        goto end;
+                }
+        }
+        if (st->arena_used != used || dcht_hash_str_verify(st)) {
+                fprintf(stderr, "records not recycled: %zu %zu\n", used, st->arena_used);
+                goto end;
+        }
+
+        fprintf(stderr, "%s: arena:%.1f bytes/key find:%"PRIu64" tsc/key\n",
+                __func__, (double) used / nb, tsc / nb);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End String Key Test\n\n");
+        free(keys);
+        free(lens);
+        dcht_hash_str_destroy(st);
+        return ret;
+}
+
+/*
+ * Value Store Test
+ * records in the table compared to an index into an array of records
+ */
+struct rec_test_s {
+        uint32_t key;
+        uint32_t gen;
+        uint64_t sum;
+        uint64_t pad;
+};
+
+static inline int
+rec_test(struct req_s * req,
+         int nb)
+{
+        struct dcht_hash_table_s * tbl, * idx_tbl;
+        struct rec_test_s * array = calloc(nb, sizeof(*array));
+        uint32_t * keys = calloc(nb, sizeof(uint32_t));
+        const void ** recs = calloc(nb, sizeof(*recs));
+        uint32_t * seqs = calloc(nb, sizeof(uint32_t));
+        const struct rec_test_s * r;
+        struct rec_test_s rec;
+        uint64_t tsc[3], sum[3] = { 0, 0, 0 };
+        uint32_t seq;
+        int ret = -1;
+
+        fprintf(stderr, "Start Value Store Test nb:%d >>>\n", nb);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_VALS(sizeof(rec)));
+        idx_tbl = dcht_hash_table_create(nb);
+        if (!tbl || !idx_tbl || !array || !keys || !recs || !seqs)
+                goto end;
+        if (tbl->rec_size != sizeof(rec) ||
+            dcht_hash_table_create_flags(nb, DCHT_FLAG_VALS(8) | DCHT_FLAG_TTL) ||
+            dcht_hash_table_create_flags(nb, DCHT_FLAG_VALS_MASK)) {
+                fprintf(stderr, "invalid value store flags\n");
+                goto end;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        for (int i = 0; i < nb; i++) {
+                keys[i] = req[i].key;
+                rec.key = keys[i];
+                rec.sum = (uint64_t) keys[i] * 3;
+                array[i] = rec;
+                if (dcht_hash_add_rec(tbl, keys[i], &rec, sizeof(rec), false) ||
+                    dcht_hash_add(idx_tbl, keys[i], i, false)) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+
+        /* an update writes a new record, the old one is not stable anymore */
+        r = dcht_hash_find_rec(tbl, keys[0], &seq);
+        rec = array[0];
+        rec.gen = 1;
+        if (!r || dcht_hash_add_rec(tbl, keys[0], &rec, sizeof(rec), false) != -EEXIST ||
+            dcht_hash_add_rec(tbl, keys[0], &rec, sizeof(rec), true) ||
+            dcht_hash_rec_stable(tbl, r, seq) ||
+            ((const struct rec_test_s *) dcht_hash_find_rec(tbl, keys[0], &seq))->gen != 1 ||
+            dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to update record\n");
+                goto end;
+        }
+
+        /* the 32 bit value APIs would store raw values as record indexes */
+        {
+                struct dcht_amac_req_s amac = { .key = keys[0], .val = 1, .op = DCHT_AMAC_OP_ADD_UPDATE };
+                uint32_t val = 0x7fffffff;
+                int r32 = 0;
+
+                if (dcht_hash_add(tbl, keys[0], val, true) != -EINVAL ||
+                    dcht_hash_add(tbl, ~keys[0], val, false) != -EINVAL ||
+                    dcht_hash_find_or_add(tbl, ~keys[0], val, &val) != -EINVAL ||
+                    dcht_hash_add_bulk(tbl, keys, &val, 1, true, &r32) || r32 != -EINVAL ||
+                    dcht_hash_amac_run(tbl, &amac, 1, 1) || amac.ret != -EINVAL ||
+                    dcht_hash_val_op(tbl, keys[0], DCHT_VAL_OP_FETCH_ADD, 1, NULL) != -EINVAL ||
+                    dcht_hash_verify(tbl)) {
+                        fprintf(stderr, "32 bit value API not rejected\n");
+                        goto end;
+                }
+        }
+
+        /* one dependent miss more, the record after the value */
+        tsc[0] = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (!dcht_hash_find(idx_tbl, keys[i], &val))
+                        sum[0] += array[val].sum;
+        }
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                r = dcht_hash_find_rec(tbl, keys[i], &seq);
+                if (r && r->key == keys[i] && dcht_hash_rec_stable(tbl, r, seq))
+                        sum[1] += r->sum;
+        }
+        tsc[1] = rdtsc() - tsc[1];
+
+        tsc[2] = rdtsc();
+        dcht_hash_find_rec_bulk(tbl, keys, nb, recs, seqs);
+        for (int i = 0; i < nb; i++) {
+                r = recs[i];
+                if (r && r->key == keys[i] && dcht_hash_rec_stable(tbl, r, seqs[i]))
+                        sum[2] += r->sum;
+        }
+        tsc[2] = rdtsc() - tsc[2];
+
+        if (sum[0] != sum[1] || sum[0] != sum[2]) {
+                fprintf(stderr, "failed to find: %"PRIu64" %"PRIu64" %"PRIu64"\n",
+                        sum[0], sum[1], sum[2]);
+                goto end;
+        }
+
+        /* delete the odd ones, their records are retired */
+        for (int i = 1; i < nb; i += 2) {
+                if (dcht_hash_del(tbl, keys[i])) {
+                        fprintf(stderr, "failed to delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        for (int i = 0; i < nb; i++) {
+                if ((dcht_hash_find_rec(tbl, keys[i], &seq) == NULL) != (i & 1)) {
+                        fprintf(stderr, "failed after delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        if (dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify after delete\n");
+                goto end;
+        }
+        for (int i = 1; i < nb; i += 2) {
+                if (dcht_hash_add_rec(tbl, keys[i], &array[i], sizeof(array[i]), false)) {
+                        fprintf(stderr, "failed to add again: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        if (dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify after add\n");
+                goto end;
+        }
+
+        /* the ring of free records wraps around, twice */
+        for (unsigned i = 0; i < tbl->nb_recs * 2; i++) {
+                rec = array[0];
+                rec.gen = i;
+                if (dcht_hash_add_rec(tbl, keys[0], &rec, sizeof(rec), true)) {
+                        fprintf(stderr, "failed to update: %u\n", i);
+                        goto end;
+                }
+        }
+        if (dcht_hash_verify(tbl) ||
+            ((const struct rec_test_s *) dcht_hash_find_rec(tbl, keys[0], &seq))->gen != tbl->nb_recs * 2 - 1) {
+                fprintf(stderr, "failed to verify after wrap\n");
+                goto end;
+        }
+
+        fprintf(stderr, "%s: %u byte records size:%zu find+array:%"PRIu64" find_rec:%"PRIu64
+                " bulk:%"PRIu64" tsc/key\n",
+                __func__, tbl->rec_size, tbl->size, tsc[0] / nb, tsc[1] / nb, tsc[2] / nb);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Value Store Test\n\n");
+        free(tbl);
+        free(idx_tbl);
+        free(array);
+        free(keys);
+        free(recs);
+        free(seqs);
+        return ret;
+}
+
+/*
+ * Cuckoo Filter Test
+ * req[0, nb) are added, req[nb, nb * 3 / 2) are never added
+ */
+static inline int
+cuckoo_filter_test(struct req_s * req,
+                   int nb,
+                   unsigned fp_bits)
+{
+        struct dcht_cuckoo_filter_s * cf;
+        uint32_t * keys = calloc(nb, sizeof(uint32_t));
+        unsigned nb_neg = nb / 2, found, fp = 0;
+        double expected;
+        uint64_t tsc[2];
+        int ret = -1;
+
+        fprintf(stderr, "Start Cuckoo Filter Test nb:%d fp_bits:%u >>>\n", nb, fp_bits);
+
+        cf = dcht_cuckoo_filter_create(nb, fp_bits);
+        if (!cf || !keys)
+                goto end;
+
+        for (int i = 0; i < nb; i++) {
+                keys[i] = req[i].key;
+                if (dcht_cuckoo_filter_add(cf, keys[i])) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+
+        /* no false negative */
+        tsc[0] = rdtsc();
+        found = 0;
+        for (int i = 0; i < nb; i++)
+                found += dcht_cuckoo_filter_contains(cf, keys[i]);
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        found += dcht_cuckoo_filter_contains_bulk(cf, keys, nb, NULL);
+        tsc[1] = rdtsc() - tsc[1];
+        if (found != (unsigned) nb * 2) {
+                fprintf(stderr, "false negative: %u\n", nb * 2 - found);
+                goto end;
+        }
+
+        for (unsigned i = 0; i < nb_neg; i++)
+                fp += dcht_cuckoo_filter_contains(cf, req[nb + i].key);
+        expected = dcht_cuckoo_filter_fpr(cf);
+
+        /* delete the odd ones, the even ones stay */
+        for (int i = 1; i < nb; i += 2) {
+                if (dcht_cuckoo_filter_del(cf, keys[i])) {
+                        fprintf(stderr, "failed to delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+        for (int i = 0; i < nb; i += 2) {
+                if (!dcht_cuckoo_filter_contains(cf, keys[i])) {
+                        fprintf(stderr, "false negative after delete: %d %u\n", i, keys[i]);
+                        goto end;
+                }
+        }
+
+        fprintf(stderr, "%s: size:%zu (%0.2f bytes/key) fpr:%0.4f%% expected:%0.4f%%"
+                " contains:%"PRIu64" bulk:%"PRIu64" tsc/key\n",
+                __func__, cf->size, (double) cf->size / nb,
+                (double) 100 * fp / nb_neg,
+                100 * expected,
+                tsc[0] / nb, tsc[1] / nb);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Cuckoo Filter Test\n\n");
+        free(keys);
+        free(cf);
+        return ret;
+}
+
+/*
+ * Zipf Test
+ * zipf skewed lookups through the front cache compared to plain find
+ */
+#define ZIPF_NB_LOOKUPS	(1024 * 1024)
+#define ZIPF_ROUNDS	5	/* find and front alternate, the best round of each counts */
+
+static uint32_t *
+zipf_keys(struct req_s * req,
+          int nb,
+          unsigned nb_lookups,
+          double skew)
+{
+        uint32_t * keys = calloc(nb_lookups, sizeof(uint32_t));
+        double * cdf = calloc(nb, sizeof(double));
+        uint64_t x = 88172645463325252ull;
+        double sum = 0;
+
+        if (!keys || !cdf) {
+                free(keys);
+                keys = NULL;
+                goto end;
+        }
+
+        for (int i = 0; i < nb; i++) {
+                sum += 1.0 / pow(i + 1, skew);
+                cdf[i] = sum;
+        }
+
+        for (unsigned i = 0; i < nb_lookups; i++) {
+                double u;
+                int lo = 0, hi = nb - 1;
+
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                u = (double) (x >> 11) / (1ull << 53) * sum;
+
+                while (lo < hi) {
+                        int mid = (lo + hi) / 2;
+
+                        if (cdf[mid] < u)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                keys[i] = req[lo].key;
+        }
+ end:
+        free(cdf);
+        return keys;
+}
+
+static inline int
+zipf_test(struct req_s * req,
+          int nb,
+          double skew)
+{
+        static struct dcht_front_s front;
+        struct dcht_hash_table_s * tbl;
+        uint32_t * keys = NULL;
+        uint64_t tsc[2] = { UINT64_MAX, UINT64_MAX };
+        uint64_t hits;
+        unsigned miss = 0;
+        uint32_t val;
+        int ret = -1;
+
+        fprintf(stderr, "Start Zipf Test nb:%d lookups:%d skew:%.2f >>>\n",
+                nb, ZIPF_NB_LOOKUPS, skew);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_FRONT_GEN);
+        keys = zipf_keys(req, nb, ZIPF_NB_LOOKUPS, skew);
+        if (!tbl || !keys)
+                goto end;
+
+        /* a front cache hit would not refresh, reference or heat its entry */
+        if (dcht_hash_table_create_flags(nb, DCHT_FLAG_FRONT_GEN | DCHT_FLAG_TTL | DCHT_FLAG_TTL_REFRESH) ||
+            dcht_hash_table_create_flags(nb, DCHT_FLAG_FRONT_GEN | DCHT_FLAG_CACHE) ||
+            dcht_hash_table_create_flags(nb, DCHT_FLAG_FRONT_GEN | DCHT_FLAG_HOTNESS)) {
+                fprintf(stderr, "front cache created with hit updates\n");
+                goto end;
+        }
+
+        for (int i = 0; i < nb; i++)
+                dcht_hash_add(tbl, req[i].key, req[i].val, false);
+
+        /* the next lookup depends on the last value, as a caller acting on it would */
+        for (int round = 0; round < ZIPF_ROUNDS; round++) {
+                uint64_t t;
+
+                val = 0;
+                perf_start();
+                t = rdtsc();
+                for (unsigned i = 0; i < ZIPF_NB_LOOKUPS; i++)
+                        miss += dcht_hash_find(tbl, keys[i] ^ (val & 0x80000000), &val) != 0;
+                t = rdtsc() - t;
+                perf_stop();
+                if (t < tsc[0])
+                        tsc[0] = t;
+                if (round == ZIPF_ROUNDS - 1)
+                        perf_dump(__func__, "find", ZIPF_NB_LOOKUPS);
+
+                /* each round starts from a cold front cache */
+                dcht_front_init(&front, tbl);
+                val = 0;
+                perf_start();
+                t = rdtsc();
+                for (unsigned i = 0; i < ZIPF_NB_LOOKUPS; i++)
+                        miss += dcht_hash_find_front(tbl, &front, keys[i] ^ (val & 0x80000000), &val) != 0;
+                t = rdtsc() - t;
+                perf_stop();
+                if (t < tsc[1])
+                        tsc[1] = t;
+                if (round == ZIPF_ROUNDS - 1)
+                        perf_dump(__func__, "front", ZIPF_NB_LOOKUPS);
+        }
+        hits = front.hits;
+
+        if (miss) {
+                fprintf(stderr, "failed to find:%u\n", miss);
+                goto end;
+        }
+
+        /* updates and deletes must not be hidden by the front cache */
+        for (int i = 0; i < 64 && i < nb; i++) {
+                dcht_hash_find_front(tbl, &front, req[i].key, &val);
+                dcht_hash_add(tbl, req[i].key, ~req[i].val, true);
+                if (dcht_hash_find_front(tbl, &front, req[i].key, &val) || val != ~req[i].val) {
+                        fprintf(stderr, "stale value after update key:%u\n", req[i].key);
+                        goto end;
+                }
+                dcht_hash_del(tbl, req[i].key);
+                if (!dcht_hash_find_front(tbl, &front, req[i].key, &val)) {
+                        fprintf(stderr, "stale value after delete key:%u\n", req[i].key);
+                        goto end;
+                }
+        }
+
+        fprintf(stderr, "%s: find:%0.2f front:%0.2f tsc/op front hit:%0.2f%%\n",
+                __func__,
+                (double) tsc[0] / ZIPF_NB_LOOKUPS,
+                (double) tsc[1] / ZIPF_NB_LOOKUPS,
+                (double) 100 * hits / ZIPF_NB_LOOKUPS);
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Zipf Test\n\n");
+        free(keys);
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Cascade Test
+ * table#0 overrides a quarter of keys, table#1 and #2 split the rest but the last quarter
+ */
+#define CASCADE_NB_TBLS	3
+
+static inline int
+cascade_test(struct req_s * req,
+             int nb)
+{
+        struct dcht_hash_table_s * tbls[CASCADE_NB_TBLS] = { NULL };
+        uint32_t * keys = calloc(nb, sizeof(uint32_t));
+        uint32_t * vals = calloc(nb, sizeof(uint32_t));
+        int * idx = calloc(nb, sizeof(int));
+        uint64_t tsc[2];
+        int found, ret = -1;
+
+        fprintf(stderr, "Start Cascade Test nb:%d tables:%d >>>\n", nb, CASCADE_NB_TBLS);
+        if (!keys || !vals || !idx)
+                goto end;
+
+        for (int t = 0; t < CASCADE_NB_TBLS; t++) {
+                tbls[t] = dcht_hash_table_create(nb);
+                if (!tbls[t])
+                        goto end;
+        }
+
+        for (int i = 0; i < nb; i++) {
+                keys[i] = req[i].key;
+                if (i < nb / 4)
+                        dcht_hash_add(tbls[0], keys[i], i, false);
+                if (i < nb / 2)
+                        dcht_hash_add(tbls[1], keys[i], req[i].val, false);
+                else if (i < nb * 3 / 4)
+                        dcht_hash_add(tbls[2], keys[i], req[i].val, false);
+        }
+
+        /* serial lookups */
+        tsc[0] = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                idx[i] = -ENOENT;
+                for (int t = 0; t < CASCADE_NB_TBLS; t++) {
+                        if (!dcht_hash_find(tbls[t], keys[i], &vals[i])) {
+                                idx[i] = t;
+                                break;
+                        }
+                }
+        }
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        found = dcht_hash_find_cascade(tbls, CASCADE_NB_TBLS, keys, nb, vals, idx);
+        tsc[1] = rdtsc() - tsc[1];
+
+        for (int i = 0; i < nb; i++) {
+                int t = i < nb / 4 ? 0 : i < nb / 2 ? 1 : i < nb * 3 / 4 ? 2 : -ENOENT;
+                uint32_t val = t == 0 ? (uint32_t) i : req[i].val;
+
+                if (idx[i] != t || (t >= 0 && vals[i] != val)) {
+                        fprintf(stderr, "failed at cascade: %d key:%u idx:%d\n",
+                                i, keys[i], idx[i]);
+                        goto end;
+                }
+        }
+        if (found != nb * 3 / 4) {
+                fprintf(stderr, "failed at cascade: found:%d\n", found);
+                goto end;
+        }
+        fprintf(stderr, "%s: serial %"PRIu64"tsc/key cascade %"PRIu64"tsc/key\n",
+                __func__, tsc[0] / nb, tsc[1] / nb);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Cascade Test\n\n");
+        for (int t = 0; t < CASCADE_NB_TBLS; t++)
+                free(tbls[t]);
+        free(keys);
+        free(vals);
+        free(idx);
+        return ret;
+}
+
+/*
+ * AMAC Test
+ * a mixed operation stream must give the same results as the sequential run
+ */
+static inline int
+amac_test(struct dcht_hash_table_s * tbl,
+          struct req_s * req,
+          int nb,
+          unsigned width)
+{
+        struct dcht_amac_req_s * ops = calloc(nb, sizeof(*ops));
+        int * ref = calloc(nb, sizeof(int));
+        uint32_t * ref_val = calloc(nb, sizeof(uint32_t));
+        int nb_keys = tbl->nb_entries * 0.85;
+        uint64_t tsc[2];
+        int ret = -1;
+
+        fprintf(stderr, "Start AMAC Test nb:%d width:%u >>>\n", nb, width);
+        if (!ops || !ref || !ref_val)
+                goto end;
+
+        /* prefill, then the stream works on a key pool around 85% load */
+        for (int i = 0; i < nb_keys / 2; i++)
+                dcht_hash_add(tbl, req[i].key, req[i].val, false);
+
+        for (int i = 0; i < nb; i++) {
+                int k = random() % nb_keys;
+
+                ops[i].key = req[k].key;
+                ops[i].val = req[k].val + i;
+                /* plain add of an existing key would duplicate it */
+                ops[i].op = random() % DCHT_AMAC_OP_NB;
+                if (ops[i].op == DCHT_AMAC_OP_ADD)
+                        ops[i].op = DCHT_AMAC_OP_ADD_UPDATE;
+        }
+
+        /* sequential reference */
+        perf_start();
+        tsc[0] = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                switch (ops[i].op) {
+                case DCHT_AMAC_OP_FIND:
+                        ref[i] = dcht_hash_find(tbl, ops[i].key, &ref_val[i]);
+                        break;
+                case DCHT_AMAC_OP_ADD:
+                case DCHT_AMAC_OP_ADD_UPDATE:
+                        ref[i] = dcht_hash_add(tbl, ops[i].key, ops[i].val,
+                                               ops[i].op == DCHT_AMAC_OP_ADD_UPDATE);
+                        break;
+                default:
+                        ref[i] = dcht_hash_del(tbl, ops[i].key);
+                        break;
+                }
+        }
+        tsc[0] = rdtsc() - tsc[0];
+        perf_stop();
+        perf_dump(__func__, "sequential", nb);
+
+        dcht_hash_clean(tbl);
+        for (int i = 0; i < nb_keys / 2; i++)
+                dcht_hash_add(tbl, req[i].key, req[i].val, false);
+
+        perf_start();
+        tsc[1] = rdtsc();
+        dcht_hash_amac_run(tbl, ops, nb, width);
+        tsc[1] = rdtsc() - tsc[1];
+        perf_stop();
+        perf_dump(__func__, "amac", nb);
+
+        table_dump("After AMAC", tbl);
+        for (int i = 0; i < nb; i++) {
+                if (ops[i].ret != ref[i] ||
+                    (ops[i].op == DCHT_AMAC_OP_FIND && !ref[i] && ops[i].val != ref_val[i])) {
+                        fprintf(stderr, "failed at AMAC: %d op:%d key:%u ret:%d ref:%d\n",
+                                i, ops[i].op, ops[i].key, ops[i].ret, ref[i]);
+                        goto end;
+                }
+        }
+        if (dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After AMAC.\n");
+                goto end;
+        }
+        fprintf(stderr, "%s: sequential %"PRIu64"tsc/op amac %"PRIu64"tsc/op\n",
+                __func__, tsc[0] / nb, tsc[1] / nb);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End AMAC Test\n\n");
+        dcht_hash_clean(tbl);
+        free(ops);
+        free(ref);
+        free(ref_val);
+        return ret;
+}
+
+/*
+ * Find or Add Test
+ */
+static inline int
+find_or_add_test(struct dcht_hash_table_s * tbl,
+                 struct req_s * req,
+                 int nb)
+{
+        uint64_t tsc[2];
+        int ret = -1;
+
+        fprintf(stderr, "Start Find or Add Test nb:%d >>>\n", nb);
+
+        /* first pass adds, second pass finds */
+        for (int pass = 0; pass < 2; pass++) {
+                tsc[pass] = rdtsc();
+                for (int i = 0; i < nb; i++) {
+                        uint32_t val;
+
+                        if (dcht_hash_find_or_add(tbl, req[i].key, req[i].val, &val) != !pass ||
+                            val != req[i].val) {
+                                fprintf(stderr, "failed to find or add: pass:%d %d %u\n",
+                                        pass, i, req[i].key);
+                                goto end;
+                        }
+                }
+                tsc[pass] = rdtsc() - tsc[pass];
+        }
+
+        table_dump("After Find or Add", tbl);
+        if (tbl->current_entries != (unsigned) nb || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After Find or Add.\n");
+                goto end;
+        }
+        fprintf(stderr, "%s: add %"PRIu64"tsc/op find %"PRIu64"tsc/op\n",
+                __func__, tsc[0] / nb, tsc[1] / nb);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Find or Add Test\n\n");
+        dcht_hash_clean(tbl);
+        return ret;
+}
+
 static inline int
 add_del_test(struct dcht_hash_table_s * tbl,
              struct req_s * req,
@@ -770,20 +2331,631 @@ add_del_test(struct dcht_hash_table_s * tbl,
         return ret;
 }
 
+/*
+ * number of records of op in a capture file, negative on error
+ */
+static long
+capture_count(const char * path,
+              enum dcht_capture_op_e op)
+{
+        struct dcht_capture_hdr_s hdr;
+        struct dcht_capture_rec_s rec;
+        FILE * fp = fopen(path, "r");
+        long nb = 0;
+
+        if (!fp)
+                return -1;
+        if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.version != DCHT_CAPTURE_VERSION) {
+                fclose(fp);
+                return -1;
+        }
+        while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+                if (rec.op == op)
+                        nb += 1;
+        }
+        fclose(fp);
+        return nb;
+}
+
+/*
+ * TTL Test
+ */
+static void
+expire_cb(struct dcht_hash_table_s * tbl,
+          uint32_t key,
+          uint32_t val,
+          void * arg)
+{
+        unsigned * nb_p = arg;
+        (void) tbl;
+        (void) key;
+
+        /* odd entries are not refreshed */
+        if (!(val & 1))
+                fprintf(stderr, "expired refreshed entry key:%u val:%u\n", key, val);
+        *nb_p += 1;
+}
+
+static inline int
+ttl_test(struct req_s * req,
+         int nb)
+{
+        char path[] = "/tmp/dcht_ttl_XXXXXX";
+        struct dcht_hash_table_s * tbl;
+        unsigned nb_expired = 0;
+        uint64_t tsc;
+        uint32_t val;
+        int ret = -1;
+        int fd;
+
+        fprintf(stderr, "Start TTL Test nb:%d >>>\n", nb);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_TTL | DCHT_FLAG_TTL_REFRESH);
+        fd = mkstemp(path);
+        if (!tbl || fd < 0)
+                goto end;
+        close(fd);
+
+        dcht_hash_set_time(tbl, 10);
+        for (int i = 0; i < nb; i++) {
+                if (dcht_hash_add(tbl, req[i].key, i, true) < 0) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+        }
+
+        /* refresh even entries */
+        dcht_hash_set_time(tbl, 20);
+        for (int i = 0; i < nb; i += 2) {
+                uint32_t val;
+
+                if (dcht_hash_find(tbl, req[i].key, &val) || val != (uint32_t) i) {
+                        fprintf(stderr, "failed to find: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+        }
+
+        /* incremental aging */
+        tsc = rdtsc();
+        for (unsigned n = 0; n < tbl->nb_buckets; n += 256) {
+                if (dcht_hash_expire(tbl, 256, 15, expire_cb, &nb_expired) < 0)
+                        goto end;
+        }
+        tsc = rdtsc() - tsc;
+
+        table_dump("After Expire", tbl);
+        if (nb_expired != (unsigned) nb / 2 || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After Expire. expired:%u\n", nb_expired);
+                goto end;
+        }
+        for (int i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (!dcht_hash_find(tbl, req[i].key, &val) != !(i & 1)) {
+                        fprintf(stderr, "bad entry after expire: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+        }
+        fprintf(stderr, "%s: expire speed %"PRIu64"tsc/bucket\n",
+                __func__, tsc / tbl->nb_buckets);
+
+        /* the expired keys are captured as deletes, the replay does not age */
+        dcht_hash_clean(tbl);
+        if (dcht_hash_capture_start(tbl, path))
+                goto end;
+        dcht_hash_set_time(tbl, 1);
+        dcht_hash_add(tbl, req[0].key, 0, false);
+        dcht_hash_set_time(tbl, 200);
+        if (dcht_hash_expire(tbl, tbl->nb_buckets, 150, NULL, NULL) != 1 ||
+            !dcht_hash_find(tbl, req[0].key, &val) ||
+            dcht_hash_capture_stop(tbl) != 3 ||
+            capture_count(path, DCHT_CAPTURE_OP_DEL) != 1) {
+                fprintf(stderr, "failed to capture the expired keys\n");
+                goto end;
+        }
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End TTL Test\n\n");
+        if (tbl && tbl->capture)
+                dcht_hash_capture_stop(tbl);
+        unlink(path);
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Cache mode Test
+ */
+static inline int
+cache_test(struct req_s * req,
+           int nb,
+           unsigned flags)
+{
+        struct dcht_hash_table_s * tbl;
+        unsigned nb_hot = nb / 16;
+        unsigned nb_evicted = 0, hot_hit = 0;
+        uint64_t tsc;
+        int ret = -1;
+
+        fprintf(stderr, "Start Cache Test nb:%d flags:%x >>>\n", nb, flags);
+
+        /* a quarter of the keys fit */
+        tbl = dcht_hash_table_create_flags(nb / 8, flags);
+        if (!tbl)
+                goto end;
+        /* a full cache tries cuckoo replace on every add, keep it shallow */
+        tbl->follow_depth = 1;
+
+        tsc = rdtsc();
+        for (int i = 0; i < nb; i++) {
+                uint32_t ev_key, ev_val, val;
+
+                if (dcht_hash_add_evict(tbl, req[i].key, req[i].val, &ev_key, &ev_val)) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+                if (ev_key != DCHT_SENTINEL_KEY)
+                        nb_evicted += 1;
+
+                /* keep the hot keys referenced */
+                dcht_hash_find(tbl, req[i % nb_hot].key, &val);
+        }
+        tsc = rdtsc() - tsc;
+
+        table_dump("After Cache Add", tbl);
+        if (nb_evicted != nb - tbl->current_entries || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After Cache Add. evicted:%u\n",
+                        nb_evicted);
+                goto end;
+        }
+
+        for (unsigned i = 0; i < nb_hot; i++) {
+                uint32_t val;
+
+                if (!dcht_hash_find(tbl, req[i].key, &val))
+                        hot_hit += 1;
+        }
+        fprintf(stderr, "%s: add+find speed %"PRIu64"tsc evicted:%u hot hit:%.02f%%\n",
+                __func__, tsc / nb, nb_evicted, (double) 100 * hot_hit / nb_hot);
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Cache Test\n\n");
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Atomic value operation Test
+ */
+#define VAL_OP_NB_THREADS	3
+#define VAL_OP_NB_COUNTERS	64
+#define VAL_OP_NB_LOOP		(256 * 1024)
+
+struct val_op_arg_s {
+        struct dcht_hash_table_s * tbl;
+        struct req_s * req;
+        unsigned lost;
+};
+
+static void *
+val_op_thread(void * p)
+{
+        struct val_op_arg_s * arg = p;
+
+        for (unsigned i = 0; i < VAL_OP_NB_LOOP; i++) {
+                uint32_t key = arg->req[i % VAL_OP_NB_COUNTERS].key;
+
+                if (dcht_hash_val_op(arg->tbl, key, DCHT_VAL_OP_FETCH_ADD, 1, NULL))
+                        arg->lost += 1;
+        }
+        return NULL;
+}
+
+static inline int
+val_op_test(struct req_s * req,
+            int nb)
+{
+        struct val_op_arg_s arg[VAL_OP_NB_THREADS];
+        pthread_t th[VAL_OP_NB_THREADS];
+        char path[] = "/tmp/dcht_val_XXXXXX";
+        struct dcht_hash_table_s * tbl;
+        uint64_t sum = 0;
+        uint32_t val, old;
+        unsigned nb_churn = 0;
+        int ret = -1;
+        int fd;
+
+        fprintf(stderr, "Start Atomic Value Test nb:%d >>>\n", nb);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_ATOMIC_VAL);
+        fd = mkstemp(path);
+        if (!tbl || fd < 0)
+                goto end;
+        close(fd);
+
+        /* counters are never deleted, the rest churns at high load to move them */
+        nb = tbl->nb_entries * 0.9;
+        for (int i = 0; i < nb; i++) {
+                uint32_t init = i < VAL_OP_NB_COUNTERS ? 0 : req[i].val;
+
+                if (dcht_hash_add(tbl, req[i].key, init, false)) {
+                        fprintf(stderr, "failed to add: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+        }
+
+        /* single thread semantics, captured as updates and finds */
+        if (dcht_hash_capture_start(tbl, path))
+                goto end;
+        val = 0;
+        if (dcht_hash_val_cas(tbl, req[0].key, &val, 10) ||
+            dcht_hash_val_cas(tbl, req[0].key, &val, 20) != -EAGAIN || val != 10 ||
+            dcht_hash_val_op(tbl, req[0].key, DCHT_VAL_OP_MAX, 5, &old) || old != 10 ||
+            dcht_hash_val_op(tbl, req[0].key, DCHT_VAL_OP_MAX, 15, &old) || old != 10 ||
+            dcht_hash_val_op(tbl, req[0].key, DCHT_VAL_OP_MIN, 3, &old) || old != 15 ||
+            dcht_hash_val_op(tbl, req[0].key, DCHT_VAL_OP_SWAP, 0, &old) || old != 3 ||
+            dcht_hash_val_op(tbl, req[nb].key, DCHT_VAL_OP_SWAP, 0, NULL) != -ENOENT) {
+                fprintf(stderr, "failed to value operation\n");
+                goto end;
+        }
+        if (dcht_hash_capture_stop(tbl) != 7 ||
+            capture_count(path, DCHT_CAPTURE_OP_ADD_UPDATE) != 5 ||
+            capture_count(path, DCHT_CAPTURE_OP_FIND) != 2) {
+                fprintf(stderr, "failed to capture value operations\n");
+                goto end;
+        }
+
+        for (int i = 0; i < VAL_OP_NB_THREADS; i++) {
+                arg[i].tbl = tbl;
+                arg[i].req = req;
+                arg[i].lost = 0;
+                if (pthread_create(&th[i], NULL, val_op_thread, &arg[i])) {
+                        fprintf(stderr, "failed to create thread\n");
+                        goto end;
+                }
+        }
+
+        /* writer: delete and add back non counter keys */
+        for (int i = 0; i < VAL_OP_NB_THREADS; i++) {
+                void * r;
+
+                while (pthread_tryjoin_np(th[i], &r)) {
+                        int idx = VAL_OP_NB_COUNTERS + (random() % (nb - VAL_OP_NB_COUNTERS));
+
+                        dcht_hash_del(tbl, req[idx].key);
+                        dcht_hash_add(tbl, req[nb + (nb_churn % (nb / 4))].key, 0, true);
+                        dcht_hash_del(tbl, req[nb + (nb_churn % (nb / 4))].key);
+                        dcht_hash_add(tbl, req[idx].key, req[idx].val, false);
+                        nb_churn += 1;
+                }
+        }
+
+        for (int i = 0; i < VAL_OP_NB_COUNTERS; i++) {
+                if (dcht_hash_find(tbl, req[i].key, &val)) {
+                        fprintf(stderr, "lost counter: %d %u\n", i, req[i].key);
+                        goto end;
+                }
+                sum += val;
+        }
+        for (int i = 0; i < VAL_OP_NB_THREADS; i++) {
+                if (arg[i].lost) {
+                        fprintf(stderr, "lost counter: thread:%d nb:%u\n", i, arg[i].lost);
+                        goto end;
+                }
+        }
+
+        fprintf(stderr, "%s: threads:%d sum:%"PRIu64" expected:%u churn:%u\n",
+                __func__, VAL_OP_NB_THREADS, sum,
+                VAL_OP_NB_THREADS * VAL_OP_NB_LOOP, nb_churn);
+        if (sum != VAL_OP_NB_THREADS * VAL_OP_NB_LOOP || dcht_hash_verify(tbl)) {
+                fprintf(stderr, "failed to verify at After Atomic Value\n");
+                goto end;
+        }
+
+        ret = 0;
+ end:
+        fprintf(stderr, "<<< End Atomic Value Test\n\n");
+        if (tbl && tbl->capture)
+                dcht_hash_capture_stop(tbl);
+        unlink(path);
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Capture Test
+ * the file keeps the table flags and driver, readers may be inside a
+ * capture while it stops
+ */
+#define CAPTURE_NB_READERS	2
+#define CAPTURE_NB_CYCLES	100
+
+struct capture_arg_s {
+        struct dcht_hash_table_s * tbl;
+        struct req_s * req;
+        int nb;
+        atomic_bool stop;
+};
+
+static void *
+capture_reader(void * p)
+{
+        struct capture_arg_s * arg = p;
+
+        while (!atomic_load(&arg->stop)) {
+                for (int i = 0; i < arg->nb; i++) {
+                        uint32_t val;
+
+                        dcht_hash_find(arg->tbl, arg->req[i].key, &val);
+                }
+        }
+        return NULL;
+}
+
+static inline int
+capture_test(struct req_s * req,
+             int nb)
+{
+        char path[] = "/tmp/dcht_capture_XXXXXX";
+        struct dcht_hash_table_s * tbl, * multi;
+        struct capture_arg_s arg;
+        struct dcht_capture_hdr_s hdr;
+        struct dcht_capture_rec_s rec;
+        pthread_t th[CAPTURE_NB_READERS];
+        FILE * fp = NULL;
+        int nb_th = 0, ret = -1;
+        long nb_rec;
+        uint32_t val;
+        int fd;
+
+        fprintf(stderr, "Start Capture Test nb:%d >>>\n", nb);
+        atomic_init(&arg.stop, false);
+
+        tbl = dcht_hash_table_create_flags(nb, DCHT_FLAG_OVERFLOW_HINT);
+        multi = dcht_hash_table_create_flags(nb, DCHT_FLAG_MULTI);
+        fd = mkstemp(path);
+        if (!tbl || !multi || fd < 0)
+                goto end;
+        close(fd);
+
+        if (dcht_hash_capture_start(multi, path) != -ENOTSUP) {
+                fprintf(stderr, "captured a multimap\n");
+                goto end;
+        }
+
+        if (dcht_hash_capture_start(tbl, path))
+                goto end;
+        dcht_hash_add(tbl, req[0].key, req[0].val, false);
+        dcht_hash_find(tbl, req[0].key, &val);
+        dcht_hash_del(tbl, req[0].key);
+        nb_rec = dcht_hash_capture_stop(tbl);
+
+        fp = fopen(path, "r");
+        if (nb_rec != 3 || !fp ||
+            fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            hdr.version != DCHT_CAPTURE_VERSION || hdr.flags != tbl->flags ||
+            hdr.driver != tbl->driver ||
+            fread(&rec, sizeof(rec), 1, fp) != 1 ||
+            rec.op != DCHT_CAPTURE_OP_ADD || rec.key != req[0].key) {
+                fprintf(stderr, "failed to read back the capture nb:%ld\n", nb_rec);
+                goto end;
+        }
+
+        /* the readers hold the capture while it stops */
+        for (int i = 0; i < nb; i++)
+                dcht_hash_add(tbl, req[i].key, req[i].val, false);
+        arg.tbl = tbl;
+        arg.req = req;
+        arg.nb = nb;
+        for (; nb_th < CAPTURE_NB_READERS; nb_th++) {
+                if (pthread_create(&th[nb_th], NULL, capture_reader, &arg)) {
+                        fprintf(stderr, "failed to create thread\n");
+                        goto end;
+                }
+        }
+        for (int i = 0; i < CAPTURE_NB_CYCLES; i++) {
+                if (dcht_hash_capture_start(tbl, "/dev/null") ||
+                    dcht_hash_capture_stop(tbl) < 0) {
+                        fprintf(stderr, "failed to capture cycle:%d\n", i);
+                        goto end;
+                }
+        }
+        fprintf(stderr, "%s: readers:%d cycles:%d\n",
+                __func__, CAPTURE_NB_READERS, CAPTURE_NB_CYCLES);
+        ret = 0;
+ end:
+        atomic_store(&arg.stop, true);
+        for (int i = 0; i < nb_th; i++)
+                pthread_join(th[i], NULL);
+        if (tbl && tbl->capture)
+                dcht_hash_capture_stop(tbl);
+        fprintf(stderr, "<<< End Capture Test\n\n");
+        if (fp)
+                fclose(fp);
+        unlink(path);
+        free(multi);
+        free(tbl);
+        return ret;
+}
+
+/*
+ * Load-factor frontier benchmark
+ */
+#define FRONTIER_BAND_PCT	5
+#define FRONTIER_BAND_NB	(100 / FRONTIER_BAND_PCT)
+#define FRONTIER_DEPTH_MAX	5
+
+struct frontier_s {
+        unsigned moves;		/* moved entries in the current insert */
+        unsigned replaced;	/* cuckoo replaced in the current insert */
+};
+
+static void
+frontier_cb(void * arg,
+            enum dcht_event_e event,
+            struct dcht_bucket_s * bk,
+            int pos)
+{
+        struct frontier_s * fr = arg;
+        (void) bk;
+        (void) pos;
+
+        if (event == DCHT_EVENT_MOVED_ENTRY)
+                fr->moves += 1;
+        else if (event == DCHT_EVENT_CUCKOO_REPLACED)
+                fr->replaced += 1;
+}
+
+static int
+cmp_u32(const void * a,
+        const void * b)
+{
+        uint32_t x = *(const uint32_t *) a;
+        uint32_t y = *(const uint32_t *) b;
+
+        return (x > y) - (x < y);
+}
+
+/*
+ * fill a table key by key up to the first -ENOSPC, report against load factor
+ */
+static inline int
+frontier_test(unsigned max_entries,
+              int depth)
+{
+        struct dcht_hash_table_s * tbl = dcht_hash_table_create(max_entries);
+        struct frontier_s fr;
+        uint32_t * tsc;
+        uint8_t * moves;
+        uint32_t seed = random();
+        unsigned nb;
+
+        if (!tbl)
+                return -1;
+        tsc = calloc(tbl->nb_entries, sizeof(*tsc));
+        moves = calloc(tbl->nb_entries, sizeof(*moves));
+        if (!tsc || !moves) {
+                free(tsc);
+                free(moves);
+                free(tbl);
+                return -1;
+        }
+
+        tbl->follow_depth = depth;
+        tbl->event_notify_cb = frontier_cb;
+        tbl->arg = &fr;
+
+        perf_start();
+        for (nb = 0; nb < tbl->nb_entries; nb++) {
+                /* multiplying by an odd constant is a bijection: keys are unique */
+                uint32_t key = (nb + seed) * 0x9e3779b1u;
+                uint64_t t;
+                int ret;
+
+                if (key == DCHT_SENTINEL_KEY)
+                        key = seed | 1;	/* never hit again by the sequence */
+
+                fr.moves = 0;
+                fr.replaced = 0;
+                t = rdtsc();
+                ret = dcht_hash_add(tbl, key, nb, false);
+                t = rdtsc() - t;
+                if (ret < 0)
+                        break;
+
+                tsc[nb] = t > UINT32_MAX ? UINT32_MAX : t;
+                moves[nb] = fr.moves > UINT8_MAX ? UINT8_MAX : fr.moves;
+        }
+        perf_stop();
+
+        fprintf(stderr,
+                "frontier: slots/bucket:%u bucket:%zuB depth:%d nb_ent:%u max:%u\n"
+                "  first ENOSPC at %u entries: %.2f%% of slots, %.3f x max_entries\n",
+                (unsigned) DCHT_BUCKET_ENTRY_SZ, sizeof(struct dcht_bucket_s),
+                depth, tbl->nb_entries, tbl->max_entries,
+                nb, (double) 100 * nb / tbl->nb_entries,
+                (double) nb / tbl->max_entries);
+        fprintf(stderr, "  %-8s %8s %10s %10s %10s %10s %9s\n",
+                "load", "inserts", "mean(tsc)", "p99(tsc)", "max(tsc)",
+                "moves/ins", "max-depth");
+
+        for (unsigned band = 0; band < FRONTIER_BAND_NB; band++) {
+                unsigned lo = (uint64_t) tbl->nb_entries * band / FRONTIER_BAND_NB;
+                unsigned hi = (uint64_t) tbl->nb_entries * (band + 1) / FRONTIER_BAND_NB;
+                uint64_t sum = 0, sum_moves = 0;
+                unsigned max_moves = 0;
+
+                if (hi > nb)
+                        hi = nb;
+                if (lo >= hi)
+                        break;
+
+                for (unsigned i = lo; i < hi; i++) {
+                        sum += tsc[i];
+                        sum_moves += moves[i];
+                        if (moves[i] > max_moves)
+                                max_moves = moves[i];
+                }
+                qsort(&tsc[lo], hi - lo, sizeof(tsc[0]), cmp_u32);
+
+                /* moves in a successful cuckoo replace = recursion depth + 1 */
+                fprintf(stderr, "  %3u-%3u%% %8u %10.1f %10u %10u %10.3f %9d\n",
+                        band * FRONTIER_BAND_PCT, (band + 1) * FRONTIER_BAND_PCT,
+                        hi - lo, (double) sum / (hi - lo),
+                        tsc[lo + (uint64_t) (hi - lo) * 99 / 100], tsc[hi - 1],
+                        (double) sum_moves / (hi - lo),
+                        max_moves ? (int) max_moves - 1 : -1);
+        }
+        perf_dump("frontier", "fill", nb);
+        fprintf(stderr, "\n");
+
+        free(moves);
+        free(tsc);
+        free(tbl);
+        return 0;
+}
+
 int
 main(int ac,
      char **av)
 {
-        (void) ac;
-        (void) av;
         char rand_state[256];
+        const char * capture = NULL;
+        bool frontier = false;
+        int opt;
+
+        while ((opt = getopt(ac, av, "c:f")) != -1) {
+                switch (opt) {
+                case 'c':
+                        capture = optarg;
+                        break;
+                case 'f':
+                        frontier = true;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-c capture_file] [-f]\n", av[0]);
+                        return -1;
+                }
+        }
 
         initstate(rdtsc(), rand_state, sizeof(rand_state));
+        perf_init();
 
 #ifndef HASH_TARGET_NB
 #define HASH_TARGET_NB	1024 * 1024 * 1
 #endif
         int nb = HASH_TARGET_NB;
+
+        if (frontier) {
+                for (int depth = 0; depth <= FRONTIER_DEPTH_MAX; depth++) {
+                        if (frontier_test(nb, depth))
+                                return -1;
+                }
+                return 0;
+        }
+
         struct dcht_hash_table_s * tbl = dcht_hash_table_create(nb);
 
         fprintf(stderr, "created table:%p\n", tbl);
@@ -791,6 +2963,11 @@ main(int ac,
         if (dcht_hash_utest(tbl))
                 return -1;
 
+        if (capture && dcht_hash_capture_start(tbl, capture)) {
+                fprintf(stderr, "failed to start capture:%s\n", capture);
+                return -1;
+        }
+
         struct req_s * req = pre_register(tbl, &nb);
 
         fprintf(stderr, "retry:%u / %d bucket:%zu\n",
@@ -800,7 +2977,34 @@ main(int ac,
                 single_speed_test(tbl, req, nb);
                 vector_speed_test(tbl, req, nb);
                 vector_speed_test(tbl, req, tbl->nb_entries * 0.8);
+                bulk_speed_test(tbl, req, tbl->nb_entries * 0.8);
+                find_or_add_test(tbl, req, tbl->nb_entries * 0.8);
+                amac_test(tbl, req, tbl->nb_entries, 1);
+                amac_test(tbl, req, tbl->nb_entries, 16);
                 add_del_test(tbl, req, tbl->nb_entries * 0.8);
+                hint_test(req, tbl->max_entries);
+                hotness_test(req, tbl->max_entries);
+                multimap_test(req, tbl->max_entries);
+                set_test(req, tbl->max_entries * 0.8);
+                wide_key_test(req, tbl->max_entries * 0.8, DCHT_FLAG_KEY64);
+                wide_key_test(req, tbl->max_entries * 0.8, DCHT_FLAG_KEY128);
+                str_test(req, tbl->max_entries * 0.8);
+                rec_test(req, tbl->max_entries * 0.8);
+                cuckoo_filter_test(req, tbl->max_entries, 16);
+                cuckoo_filter_test(req, tbl->max_entries, 8);
+                zipf_test(req, tbl->max_entries, 1.0);
+                zipf_test(req, tbl->max_entries, 1.5);
+                cascade_test(req, tbl->max_entries);
+                shm_test(req, tbl->max_entries);
+                rcu_test(req);
+                ttl_test(req, tbl->max_entries);
+                cache_test(req, tbl->max_entries, DCHT_FLAG_CACHE);
+                cache_test(req, tbl->max_entries, DCHT_FLAG_CACHE | DCHT_FLAG_CACHE_EVICT_ALWAYS);
+                val_op_test(req, tbl->max_entries / 4);
+                capture_test(req, tbl->max_entries / 4);
         }
+
+        if (capture)
+                fprintf(stderr, "captured:%ld\n", dcht_hash_capture_stop(tbl));
         return 0;
 }
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2023 deadcafe.beef@gmail.com
+ *
+ * unit test of the C++ template table
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#include "dc_hash_tbl.h"
+#include "dc_hash_tbl.hpp"
+
+/* 80% of 64K entries */
+#define TMPL_TEST_NB		52428
+#define TMPL_TEST_BUCKETS	8192
+
+#define GEOMETRY_SLOTS		(1u << 16)	/* in cache */
+#define GEOMETRY_SLOTS_DRAM	(1u << 24)	/* -g, past the last level cache */
+#define GEOMETRY_ROUNDS		3		/* the best of */
+
+static inline uint64_t
+rdtsc(void)
+{
+        uint32_t lo, hi;
+
+        asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+        return ((uint64_t) hi << 32) | lo;
+}
+
+static inline uint64_t
+xorshift(uint64_t * x)
+{
+        *x ^= *x << 13;
+        *x ^= *x >> 7;
+        *x ^= *x << 17;
+        return *x;
+}
+
+/*
+ * unique non zero keys
+ */
+template <typename Key>
+static std::vector<Key>
+make_keys(std::size_t nb)
+{
+        dcht::table<Key, uint32_t, 8, dcht::hash_mul, dcht::simd_generic> uniq(nb * 2);
+        std::vector<Key> keys;
+        uint64_t x = 88172645463325252ull;
+
+        while (keys.size() < nb) {
+                Key key = static_cast<Key>(xorshift(&x));
+
+                if (!uniq.add(key, 0, false))
+                        keys.push_back(key);
+        }
+        return keys;
+}
+
+template <typename T>
+static int
+tmpl_test(const char * name,
+          T & tbl,
+          const std::vector<typename T::key_type> & keys)
+{
+        std::vector<uint32_t> vals(keys.size());
+        std::size_t nb = keys.size(), found = 0;
+        uint64_t tsc[2];
+
+        for (std::size_t i = 0; i < nb; i++) {
+                if (tbl.add(keys[i], i, false)) {
+                        fprintf(stderr, "%s: failed to add: %zu\n", name, i);
+                        return -1;
+                }
+        }
+        if (tbl.add(keys[0], 0, false) != -EEXIST || tbl.add(0, 0) != -EINVAL || tbl.verify()) {
+                fprintf(stderr, "%s: failed to verify\n", name);
+                return -1;
+        }
+
+        tsc[0] = rdtsc();
+        for (std::size_t i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (tbl.find(keys[i], val) && val == i)
+                        found += 1;
+        }
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        found += tbl.find_bulk(keys.data(), nb, vals.data());
+        tsc[1] = rdtsc() - tsc[1];
+
+        if (found != nb * 2) {
+                fprintf(stderr, "%s: failed to find: %zu\n", name, found);
+                return -1;
+        }
+
+        /* delete the odd ones */
+        for (std::size_t i = 1; i < nb; i += 2) {
+                if (tbl.del(keys[i])) {
+                        fprintf(stderr, "%s: failed to delete: %zu\n", name, i);
+                        return -1;
+                }
+        }
+        for (std::size_t i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (tbl.find(keys[i], val) == (i & 1)) {
+                        fprintf(stderr, "%s: failed after delete: %zu\n", name, i);
+                        return -1;
+                }
+        }
+
+        /* the owner moves, the buckets stay */
+        T moved(std::move(tbl));
+
+        if (tbl.size() || moved.size() != (nb + 1) / 2 || moved.verify()) {
+                fprintf(stderr, "%s: failed to verify after move\n", name);
+                return -1;
+        }
+        tbl = std::move(moved);
+
+        fprintf(stderr, "%s: slots:%u bytes:%zu find:%" PRIu64 " bulk:%" PRIu64 " tsc/key\n",
+                name, T::slots, tbl.bytes(), tsc[0] / nb, tsc[1] / nb);
+        return 0;
+}
+
+/*
+ * the C library for reference
+ */
+static int
+c_test(const std::vector<uint32_t> & keys)
+{
+        struct dcht_hash_table_s * tbl = dcht_hash_table_create(keys.size());
+        std::vector<uint32_t> vals(keys.size());
+        std::size_t nb = keys.size(), found = 0;
+        uint64_t tsc[2];
+
+        if (!tbl)
+                return -1;
+        for (std::size_t i = 0; i < nb; i++)
+                dcht_hash_add(tbl, keys[i], i, false);
+
+        tsc[0] = rdtsc();
+        for (std::size_t i = 0; i < nb; i++) {
+                uint32_t val;
+
+                if (!dcht_hash_find(tbl, keys[i], &val) && val == i)
+                        found += 1;
+        }
+        tsc[0] = rdtsc() - tsc[0];
+
+        tsc[1] = rdtsc();
+        found += dcht_hash_find_bulk(tbl, keys.data(), nb, vals.data(), NULL);
+        tsc[1] = rdtsc() - tsc[1];
+
+        fprintf(stderr, "C library: slots:%u bytes:%zu find:%" PRIu64 " bulk:%" PRIu64 " tsc/key\n",
+                (unsigned) DCHT_BUCKET_ENTRY_SZ, tbl->size, tsc[0] / nb, tsc[1] / nb);
+        free(tbl);
+        return found == nb * 2 ? 0 : -1;
+}
+
+/*
+ * bucket geometry benchmark
+ */
+template <typename Key>
+static inline Key
+seq_key(std::size_t i)
+{
+        /* multiplying by an odd constant is a bijection: keys are unique and not zero */
+        return static_cast<Key>((i + 1) * 0x9e3779b97f4a7c15ull);
+}
+
+/*
+ * fill up to the first -ENOSPC, then add, find hits, find misses and
+ * find_bulk hits at 80% load, in tsc per key
+ */
+template <typename T>
+static int
+geometry_test(const char * name,
+              const char * simd,
+              std::size_t nb_slots)
+{
+        using Key = typename T::key_type;
+        T tbl(nb_slots * 4 / 5);
+        std::size_t nb = tbl.capacity() * 4 / 5;
+        std::vector<Key> keys(nb * 2);	/* inserted, then never inserted */
+        std::vector<uint32_t> vals(nb);
+        std::size_t full, found = 0, missed = 0;
+        uint64_t tsc[4];
+
+        for (std::size_t i = 0; i < keys.size(); i++)
+                keys[i] = seq_key<Key>(i);
+
+        for (full = 0; !tbl.add(seq_key<Key>(full), full, false); full++)
+                ;
+        if (tbl.verify()) {
+                fprintf(stderr, "%s: failed to verify when full\n", name);
+                return -1;
+        }
+        for (int round = 0; round < GEOMETRY_ROUNDS; round++) {
+                uint64_t t[4];
+
+                tbl.clear();
+                found = 0;
+                missed = 0;
+
+                t[0] = rdtsc();
+                for (std::size_t i = 0; i < nb; i++) {
+                        if (tbl.add(keys[i], i, false)) {
+                                fprintf(stderr, "%s: failed to add: %zu\n", name, i);
+                                return -1;
+                        }
+                }
+                t[0] = rdtsc() - t[0];
+
+                t[1] = rdtsc();
+                for (std::size_t i = 0; i < nb; i++) {
+                        uint32_t val;
+
+                        if (tbl.find(keys[i], val) && val == i)
+                                found += 1;
+                }
+                t[1] = rdtsc() - t[1];
+
+                t[2] = rdtsc();
+                for (std::size_t i = nb; i < nb * 2; i++) {
+                        uint32_t val;
+
+                        missed += !tbl.find(keys[i], val);
+                }
+                t[2] = rdtsc() - t[2];
+
+                t[3] = rdtsc();
+                found += tbl.find_bulk(keys.data(), nb, vals.data());
+                t[3] = rdtsc() - t[3];
+
+                for (int j = 0; j < 4; j++) {
+                        if (!round || t[j] < tsc[j])
+                                tsc[j] = t[j];
+                }
+        }
+
+        if (found != nb * 2 || missed != nb) {
+                fprintf(stderr, "%s: failed to find: %zu %zu\n", name, found, missed);
+                return -1;
+        }
+
+        fprintf(stderr, "  %-7s %-7s %5u %6zu %7.2f%% %6" PRIu64 " %6" PRIu64 " %6" PRIu64 " %6" PRIu64 "\n",
+                name, simd, T::slots, T::bucket_size, 100.0 * full / tbl.capacity(),
+                tsc[0] / nb, tsc[1] / nb, tsc[2] / nb, tsc[3] / nb);
+        return 0;
+}
+
+static int
+geometry_run(std::size_t nb_slots)
+{
+        int ret = 0;
+
+        fprintf(stderr, "geometry: %zu slots, follow depth %d, at 80%% load in tsc/key\n",
+                nb_slots, dcht::follow_depth_default);
+        fprintf(stderr, "  %-7s %-7s %5s %6s %8s %6s %6s %6s %6s\n",
+                "key", "simd", "slots", "bucket", "full", "add", "hit", "miss", "bulk");
+
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 4>>("32 bit", "default", nb_slots);
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 8>>("32 bit", "default", nb_slots);
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 16>>("32 bit", "default", nb_slots);
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 16, dcht::hash_default, dcht::simd_generic>>
+                ("32 bit", "generic", nb_slots);
+#if defined(__SSE2__)
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 16, dcht::hash_default, dcht::simd_sse2>>
+                ("32 bit", "sse2", nb_slots);
+#endif	/* __SSE2__ */
+#if defined(__AVX2__)
+        ret |= geometry_test<dcht::table<uint32_t, uint32_t, 16, dcht::hash_default, dcht::simd_avx2>>
+                ("32 bit", "avx2", nb_slots);
+#endif	/* __AVX2__ */
+        ret |= geometry_test<dcht::table<uint64_t, uint32_t, 4>>("64 bit", "default", nb_slots);
+        ret |= geometry_test<dcht::table<uint64_t, uint32_t, 8>>("64 bit", "default", nb_slots);
+        ret |= geometry_test<dcht::table<uint64_t, uint32_t, 16>>("64 bit", "default", nb_slots);
+        fprintf(stderr, "\n");
+        return ret;
+}
+
+int
+main(int ac,
+     char ** av)
+{
+        std::vector<uint32_t> keys32 = make_keys<uint32_t>(TMPL_TEST_NB);
+        std::vector<uint64_t> keys64 = make_keys<uint64_t>(TMPL_TEST_NB);
+        std::vector<uint16_t> keys16 = make_keys<uint16_t>(TMPL_TEST_NB / 4);
+        std::size_t geometry_slots = GEOMETRY_SLOTS;
+        int ret = 0;
+        int opt;
+
+        while ((opt = getopt(ac, av, "g")) != -1) {
+                switch (opt) {
+                case 'g':
+                        geometry_slots = GEOMETRY_SLOTS_DRAM;
+                        break;
+                default:
+                        fprintf(stderr, "usage: %s [-g]\n", av[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        fprintf(stderr, "Start Template Test nb:%d >>>\n", TMPL_TEST_NB);
+
+        ret |= c_test(keys32);
+        {
+                dcht::table<> tbl(TMPL_TEST_NB);
+
+                ret |= tmpl_test("default", tbl, keys32);
+        }
+        {
+                dcht::table<uint32_t, uint32_t, 8, dcht::hash_default, dcht::simd_default,
+                            TMPL_TEST_BUCKETS> tbl;
+
+                ret |= tmpl_test("fixed mask", tbl, keys32);
+        }
+        {
+                dcht::table<uint32_t, uint32_t, 16> tbl(TMPL_TEST_NB);
+
+                ret |= tmpl_test("16 slots", tbl, keys32);
+        }
+        {
+                dcht::table<uint32_t, uint32_t, 4> tbl(TMPL_TEST_NB);
+
+                ret |= tmpl_test("4 slots", tbl, keys32);
+        }
+        {
+                dcht::table<uint32_t, uint32_t, 8, dcht::hash_mul, dcht::simd_generic> tbl(TMPL_TEST_NB);
+
+                ret |= tmpl_test("generic", tbl, keys32);
+        }
+        {
+                dcht::table<uint64_t, uint32_t, 8> tbl(TMPL_TEST_NB);
+
+                ret |= tmpl_test("64 bit keys", tbl, keys64);
+        }
+        {
+                dcht::table<uint16_t, uint32_t, 8> tbl(TMPL_TEST_NB / 4);
+
+                ret |= tmpl_test("16 bit keys", tbl, keys16);
+        }
+        ret |= geometry_run(geometry_slots);
+
+        fprintf(stderr, "<<< End Template Test ret:%d\n\n", ret);
+        return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}